@@ -0,0 +1,122 @@
+#pragma once
+#include "LogHistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 自适应 TTL 的配置
+struct AdaptiveTtlOptions{
+    int min_ttl_ms = 100;           // TTL 下限（毫秒）
+    int max_ttl_ms = 30000;         // TTL 上限（毫秒）：更长的持锁依靠续锁
+    int initial_ttl_ms = 10000;     // 样本不足时使用的 TTL
+    double quantile = 0.99;         // 按持锁时间的哪个分位数估计
+    double margin = 2.0;            // TTL = 分位数 × margin；为 2 时续锁点（TTL 的一半）正好落在分位数上
+    int min_samples = 20;           // 资源自身样本少于该值时改用全局分布
+    size_t max_resources = 4096;    // 单独学习的资源数上限（超出的资源只使用全局分布）
+};
+
+// 自适应 TTL：按资源学习持锁时间分布（从获取成功到释放），据此选择 TTL
+// - 每个资源一个毫秒级的 LogHistogram（相对误差 ≤ 25%，上限约 4.6 小时），约 200 字节，分布会跟随最近的持锁行为变化
+// - 资源自身样本不足时使用全局分布，全局也不足时使用 initial_ttl_ms
+// TTL 过长时持有者崩溃后其他客户端要等很久；过短时租约频繁丢失或续锁流量大。
+// 默认 margin=2：续锁在 TTL 过半时进行（RedLock::run_locked），约 99% 的持锁在第一次续锁之前就已结束。
+// 可以被多个 RedLock 实例/线程共享（内部加锁）
+class AdaptiveTtl{
+public:
+    explicit AdaptiveTtl(const AdaptiveTtlOptions &options = AdaptiveTtlOptions()) : options_(options) {}
+
+    AdaptiveTtl(const AdaptiveTtl &) = delete;
+    AdaptiveTtl &operator=(const AdaptiveTtl &) = delete;
+
+    // 为资源选择 TTL（毫秒，位于 [min_ttl_ms, max_ttl_ms] 内）
+    int ttl_for(const char *resource, size_t len) const{
+        std::lock_guard<std::mutex> guard(mu_);
+        int64_t q = -1;
+        auto it = resources_.find(std::string(resource, len));
+        if (it != resources_.end() && it->second.hist.total() >= static_cast<uint32_t>(options_.min_samples)) {
+            q = it->second.hist.quantile(options_.quantile);
+        } else if (global_.total() >= static_cast<uint32_t>(options_.min_samples)) {
+            q = global_.quantile(options_.quantile);
+        }
+        if (q < 0) {
+            return options_.initial_ttl_ms;
+        }
+        double ttl = std::ceil(static_cast<double>(q) * options_.margin);
+        return static_cast<int>(std::max<double>(options_.min_ttl_ms, std::min<double>(options_.max_ttl_ms, ttl)));
+    }
+
+    // 续锁间隔：TTL 的一半（与 run_locked 一致）
+    static int renew_interval_ms(int ttl_ms) { return ttl_ms / 2; }
+
+    // 记录获取成功的时刻（同一资源同一时刻只有一个持有者）
+    void on_acquired(const char *resource, size_t len, int64_t now_ms){
+        std::lock_guard<std::mutex> guard(mu_);
+        Resource *r = entry(resource, len);
+        if (r) {
+            r->acquired_at_ms = now_ms;
+        }
+    }
+
+    // 记录释放，持锁时间计入该资源与全局的分布
+    void on_released(const char *resource, size_t len, int64_t now_ms){
+        std::lock_guard<std::mutex> guard(mu_);
+        auto it = resources_.find(std::string(resource, len));
+        if (it == resources_.end() || it->second.acquired_at_ms < 0) {
+            return;
+        }
+        int64_t hold = std::max<int64_t>(0, now_ms - it->second.acquired_at_ms);
+        it->second.acquired_at_ms = -1;
+        it->second.hist.add(hold);
+        global_.add(hold);
+    }
+
+    // 直接添加一个持锁时间样本（调用方自行计时的场景）
+    void record_hold(const char *resource, size_t len, int64_t hold_ms){
+        std::lock_guard<std::mutex> guard(mu_);
+        Resource *r = entry(resource, len);
+        if (r) {
+            r->hist.add(hold_ms);
+        }
+        global_.add(hold_ms);
+    }
+
+    // 资源持锁时间的分位数估计（毫秒），样本不足时返回 -1
+    int64_t hold_quantile_ms(const std::string &resource, double q) const{
+        std::lock_guard<std::mutex> guard(mu_);
+        auto it = resources_.find(resource);
+        if (it == resources_.end() || it->second.hist.total() < static_cast<uint32_t>(options_.min_samples)) {
+            return -1;
+        }
+        return it->second.hist.quantile(q);
+    }
+
+    const AdaptiveTtlOptions &options() const { return options_; }
+
+private:
+    struct Resource{
+        LogHistogram hist;
+        int64_t acquired_at_ms = -1;  // 当前持有者获取成功的时刻（-1 表示未持有）
+    };
+
+    // 查找或创建资源的记录，达到上限时返回 nullptr
+    Resource *entry(const char *resource, size_t len){
+        std::string key(resource, len);
+        auto it = resources_.find(key);
+        if (it != resources_.end()) {
+            return &it->second;
+        }
+        if (resources_.size() >= options_.max_resources) {
+            return nullptr;
+        }
+        return &resources_[key];
+    }
+
+    AdaptiveTtlOptions options_;
+    mutable std::mutex mu_;
+    std::unordered_map<std::string, Resource> resources_;
+    LogHistogram global_;  // 所有资源的持锁时间
+};
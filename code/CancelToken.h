@@ -0,0 +1,70 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// 取消令牌：RedLock::run_locked 把它交给业务函数，告诉业务函数锁是否仍然可靠
+// - 续锁失败时由续锁线程立即取消
+// - 即使续锁线程被卡住（节点无响应），到了 deadline() 也视为已取消，不依赖续锁线程按时唤醒
+// 业务函数应在较长的步骤之间检查 cancelled()，或用 wait_for 代替 sleep，被取消后尽快停止写共享资源
+class CancelToken{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit CancelToken(Clock::time_point deadline) : deadline_ns_(deadline.time_since_epoch().count()) {}
+
+    CancelToken(const CancelToken &) = delete;
+    CancelToken &operator=(const CancelToken &) = delete;
+
+    // 是否已取消（续锁失败，或已到达最迟停止时间）
+    bool cancelled() const{
+        return cancelled_.load(std::memory_order_acquire) || Clock::now() >= deadline();
+    }
+
+    // 最迟停止时间：锁的有效期结束前留出安全余量，续锁成功后后移
+    Clock::time_point deadline() const{
+        return Clock::time_point(Clock::duration(deadline_ns_.load(std::memory_order_acquire)));
+    }
+
+    // 等待至多 timeout（不会越过 deadline），返回 true 表示在等待期间或之前已被取消
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout) const{
+        auto until = Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout);
+        std::unique_lock<std::mutex> guard(mu_);
+        while (!cancelled()) {
+            auto wake = std::min(until, deadline());
+            if (Clock::now() >= wake) {
+                break;
+            }
+            cv_.wait_until(guard, wake);
+        }
+        return cancelled();
+    }
+
+    // 以下由续锁线程调用
+    // 取消并唤醒所有等待者
+    void cancel(){
+        {
+            std::lock_guard<std::mutex> guard(mu_);
+            cancelled_.store(true, std::memory_order_release);
+        }
+        cv_.notify_all();
+    }
+
+    // 续锁成功后后移最迟停止时间
+    void extend(Clock::time_point deadline){
+        {
+            std::lock_guard<std::mutex> guard(mu_);
+            deadline_ns_.store(deadline.time_since_epoch().count(), std::memory_order_release);
+        }
+        cv_.notify_all();
+    }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    std::atomic<Clock::rep> deadline_ns_;  // steady_clock 时间点（时钟计数，便于原子读写）
+    mutable std::mutex mu_;
+    mutable std::condition_variable cv_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 资源名 → 节点组 的一致性哈希
+// - 先用 64 位 FNV-1a 把资源名散列为整数，再用 Jump Consistent Hash（Lamping & Veach, 2014）映射到组下标
+// - 组数从 G 增加到 G+1 时，只有约 1/(G+1) 的资源会迁移到新组，其余资源的归属不变
+// - 不需要哈希环/虚拟节点表，无内存开销，各组分到的资源数量均匀
+// 组只能在末尾追加（组下标即组的身份），这与 RedLock::add_server_group 的用法一致
+
+// 64 位 FNV-1a
+inline uint64_t resource_hash(const char *data, size_t len){
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Jump Consistent Hash：返回 [0, buckets) 内的组下标（buckets ≤ 0 时返回 0）
+inline int32_t jump_consistent_hash(uint64_t key, int32_t buckets){
+    int64_t b = -1;
+    int64_t j = 0;
+    while (j < buckets) {
+        b = j;
+        key = key * 2862933555777941757ull + 1;
+        j = static_cast<int64_t>((b + 1) * (static_cast<double>(1ll << 31) / static_cast<double>((key >> 33) + 1)));
+    }
+    return b < 0 ? 0 : static_cast<int32_t>(b);
+}
+
+// 资源名所属的组
+inline size_t shard_of(const char *resource, size_t len, size_t groups){
+    if (groups <= 1) {
+        return 0;
+    }
+    return static_cast<size_t>(jump_consistent_hash(resource_hash(resource, len), static_cast<int32_t>(groups)));
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include "ConsistentHash.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 按资源统计锁竞争：找出最热的锁（加锁轮次最多、失败最多、等待最久）
+// - Count-Min Sketch（depth 行 × width 列）记录每个资源的加锁轮次、失败轮次、等待时间，
+//   内存固定，与资源名的数量无关；估计值只会偏大（哈希冲突），不会偏小
+// - 另用 Space-Saving 表跟踪最多 capacity 个热点资源：新资源的轮次估计值超过表中最小值时替换之，
+//   表中的资源额外记录成功次数、释放次数与持锁时间（同一资源同一时刻只有一个持有者，因此只需记一个加锁时刻）
+// 可以被多个 RedLock 实例/线程共享（内部加锁；每次 lock() 只更新一次）
+class ContentionProfiler{
+public:
+    // 一个热点资源的统计
+    struct Entry{
+        std::string resource;
+        uint64_t attempts = 0;  // 加锁轮次（进入热点表之前的部分来自 sketch 估计）
+        uint64_t error = 0;     // attempts 可能的高估量（进入热点表时 sketch 估计值的误差上界）
+        uint64_t failures = 0;  // 失败的轮次（进入热点表之后）
+        uint64_t acquired = 0;  // 成功获取次数
+        uint64_t gave_up = 0;   // 放弃获取的次数
+        uint64_t wait_ms = 0;   // lock() 的总耗时（成功与放弃都计入）
+        uint64_t released = 0;  // 释放次数
+        uint64_t hold_ms = 0;   // 总持锁时间（获取成功到释放）
+    };
+
+    // 任意资源的 sketch 估计值（上界）
+    struct Estimate{
+        uint64_t attempts = 0;
+        uint64_t failures = 0;
+        uint64_t wait_ms = 0;
+    };
+
+    explicit ContentionProfiler(size_t capacity = 64, size_t width = 2048, size_t depth = 4)
+        : capacity_(std::max<size_t>(capacity, 1)), width_(std::max<size_t>(width, 1)), depth_(std::max<size_t>(depth, 1)),
+          cells_(width_ * depth_) {
+        tracked_.reserve(capacity_);
+    }
+
+    ContentionProfiler(const ContentionProfiler &) = delete;
+    ContentionProfiler &operator=(const ContentionProfiler &) = delete;
+
+    // 记录一次 lock()：rounds 轮中 failures 轮未拿到多数派，wait_ms 为总耗时，acquired 为最终是否成功，now_ms 为当前时间
+    void record_acquire(const char *resource, size_t len, uint64_t rounds, uint64_t failures, int64_t wait_ms, bool acquired, int64_t now_ms){
+        uint64_t h = resource_hash(resource, len);
+        uint64_t wait = wait_ms > 0 ? static_cast<uint64_t>(wait_ms) : 0;
+        std::lock_guard<std::mutex> guard(mu_);
+        uint64_t estimate = UINT64_MAX;
+        for (size_t row = 0; row < depth_; row++) {
+            Cell &c = cells_[cell_index(h, row)];
+            c.attempts += rounds;
+            c.failures += failures;
+            c.wait_ms += wait;
+            estimate = std::min(estimate, c.attempts);
+        }
+
+        Tracked *t = track(h, resource, len, rounds, estimate);
+        if (!t) {
+            return;
+        }
+        t->entry.failures += failures;
+        t->entry.wait_ms += wait;
+        if (acquired) {
+            t->entry.acquired++;
+            t->acquired_at_ms = now_ms;
+        } else {
+            t->entry.gave_up++;
+        }
+    }
+
+    // 记录一次释放（只对热点表中的资源计算持锁时间）
+    void record_release(const char *resource, size_t len, int64_t now_ms){
+        uint64_t h = resource_hash(resource, len);
+        std::lock_guard<std::mutex> guard(mu_);
+        Tracked *t = find(h, resource, len);
+        if (!t) {
+            return;
+        }
+        t->entry.released++;
+        if (t->acquired_at_ms >= 0) {
+            t->entry.hold_ms += static_cast<uint64_t>(std::max<int64_t>(0, now_ms - t->acquired_at_ms));
+            t->acquired_at_ms = -1;
+        }
+    }
+
+    // 按加锁轮次从多到少返回最热的 k 个资源
+    std::vector<Entry> top(size_t k) const{
+        std::vector<Entry> out;
+        {
+            std::lock_guard<std::mutex> guard(mu_);
+            out.reserve(tracked_.size());
+            for (const auto &t : tracked_) {
+                out.push_back(t.entry);
+            }
+        }
+        std::sort(out.begin(), out.end(), [](const Entry &a, const Entry &b) { return a.attempts > b.attempts; });
+        if (out.size() > k) {
+            out.resize(k);
+        }
+        return out;
+    }
+
+    // 任意资源（包括不在热点表中的）的 sketch 估计值
+    Estimate estimate(const std::string &resource) const{
+        uint64_t h = resource_hash(resource.data(), resource.size());
+        Estimate e;
+        e.attempts = e.failures = e.wait_ms = UINT64_MAX;
+        std::lock_guard<std::mutex> guard(mu_);
+        for (size_t row = 0; row < depth_; row++) {
+            const Cell &c = cells_[cell_index(h, row)];
+            e.attempts = std::min(e.attempts, c.attempts);
+            e.failures = std::min(e.failures, c.failures);
+            e.wait_ms = std::min(e.wait_ms, c.wait_ms);
+        }
+        return e;
+    }
+
+    // 清空所有统计
+    void reset(){
+        std::lock_guard<std::mutex> guard(mu_);
+        std::fill(cells_.begin(), cells_.end(), Cell());
+        tracked_.clear();
+    }
+
+private:
+    struct Cell{
+        uint64_t attempts = 0;
+        uint64_t failures = 0;
+        uint64_t wait_ms = 0;
+    };
+
+    struct Tracked{
+        uint64_t hash;
+        int64_t acquired_at_ms = -1;  // 最近一次获取成功的时刻（-1 表示未持有）
+        Entry entry;
+    };
+
+    // 第 row 行的列下标：由同一个 64 位哈希派生（double hashing），不需要 depth 个独立哈希函数
+    size_t cell_index(uint64_t h, size_t row) const{
+        uint64_t h1 = h;
+        uint64_t h2 = (h >> 32) | 1;
+        return row * width_ + static_cast<size_t>((h1 + row * h2) % width_);
+    }
+
+    static bool matches(const Tracked &t, uint64_t h, const char *resource, size_t len){
+        return t.hash == h && t.entry.resource.size() == len && memcmp(t.entry.resource.data(), resource, len) == 0;
+    }
+
+    Tracked *find(uint64_t h, const char *resource, size_t len){
+        for (auto &t : tracked_) {
+            if (matches(t, h, resource, len)) {
+                return &t;
+            }
+        }
+        return nullptr;
+    }
+
+    // 在热点表中查找资源；不在表中时按 Space-Saving 规则决定是否加入（表满时替换轮次最少的资源）
+    // 热点表很小（默认 64），线性扫描比哈希表更快，也不需要为查找构造 std::string
+    Tracked *track(uint64_t h, const char *resource, size_t len, uint64_t rounds, uint64_t estimate){
+        Tracked *min = nullptr;
+        for (auto &t : tracked_) {
+            if (matches(t, h, resource, len)) {
+                t.entry.attempts += rounds;
+                return &t;
+            }
+            if (!min || t.entry.attempts < min->entry.attempts) {
+                min = &t;
+            }
+        }
+        if (tracked_.size() < capacity_) {
+            tracked_.push_back(Tracked());
+            min = &tracked_.back();
+        } else if (estimate <= min->entry.attempts) {
+            return nullptr;
+        }
+        *min = Tracked();
+        min->hash = h;
+        min->entry.resource.assign(resource, len);
+        min->entry.attempts = estimate;
+        min->entry.error = estimate - rounds;
+        return min;
+    }
+
+    size_t capacity_;
+    size_t width_;
+    size_t depth_;
+    mutable std::mutex mu_;
+    std::vector<Cell> cells_;        // depth_ 行 × width_ 列
+    std::vector<Tracked> tracked_;   // 热点表（最多 capacity_ 个）
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include "RedLock.h"
+#include <chrono>
+#include <string>
+#include <system_error>
+
+// 单个资源的分布式互斥量，满足标准库 TimedLockable 要求，可以直接配合
+// std::unique_lock / std::lock_guard / std::timed_mutex 风格的代码使用：
+//   DistributedMutex mtx(redlock, "order_42", 5000);
+//   std::unique_lock<DistributedMutex> guard(mtx, std::chrono::milliseconds(50));
+//   if (guard.owns_lock()) { ... }
+// - try_lock()：只尝试一轮，不睡眠
+// - try_lock_for()/try_lock_until()：等待间隔由 RedLock 的重试策略决定，不会为了再试一轮而越过截止时间；
+//   每个节点的命令超时也以截止时间为上限，一个卡住的节点不会让调用越过截止时间
+// - lock()：一直重试直到拿到锁（RedLock 没有可用节点时抛出 std::system_error）
+// 锁的有效期为 ttl_ms，不会自动续期，临界区需要在 held().valid_time_ 内完成（长任务请用 RedLock::run_locked）。
+// 与 RedLock 一样不是线程安全的：每个线程使用自己的 RedLock 与 DistributedMutex。
+class DistributedMutex{
+public:
+    DistributedMutex(RedLock &redlock, const std::string &resource, int ttl_ms)
+        : redlock_(redlock), resource_(resource), ttl_ms_(ttl_ms) {}
+
+    DistributedMutex(const DistributedMutex &) = delete;
+    DistributedMutex &operator=(const DistributedMutex &) = delete;
+
+    void lock(){
+        if (!redlock_.lock(resource_, ttl_ms_, lock_, std::chrono::steady_clock::time_point::max())) {
+            throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "RedLock: no server available");
+        }
+        owns_ = true;
+    }
+
+    bool try_lock(){
+        owns_ = redlock_.try_lock(resource_, ttl_ms_, lock_);
+        return owns_;
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period> &timeout){
+        return try_lock_until(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+    }
+
+    // 其他时钟的截止时间按当前时刻换算为 steady_clock（之后调整系统时间不影响等待）
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration> &deadline){
+        auto remaining = std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline - Clock::now());
+        return try_lock_until(std::chrono::steady_clock::now() + remaining);
+    }
+
+    bool try_lock_until(std::chrono::steady_clock::time_point deadline){
+        owns_ = redlock_.lock(resource_, ttl_ms_, lock_, deadline);
+        return owns_;
+    }
+
+    void unlock(){
+        if (owns_) {
+            redlock_.unlock(lock_);
+            owns_ = false;
+        }
+    }
+
+    // 最近一次加锁得到的锁（持有者标识与剩余有效时间）
+    const Lock &held() const { return lock_; }
+    bool owns_lock() const { return owns_; }
+
+private:
+    RedLock &redlock_;
+    std::string resource_;
+    int ttl_ms_;
+    Lock lock_;
+    bool owns_ = false;
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include "Lock.h"
+#include "LockScripts.h"
+#include "RespEncoder.h"
+#include "ServerOptions.h"
+#include <hiredis/hiredis.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// RedLockCore 的 hiredis 传输层：一个对象对应一个节点的连接（只能移动，不能拷贝）
+// 使用与 RedLock 相同的加锁/解锁/续锁脚本，命令编码到复用的 RespEncoder 缓冲区中
+class HiredisTransport{
+public:
+    HiredisTransport() {}
+    // 接管一个已建立的连接
+    explicit HiredisTransport(redisContext *ctx) : ctx_(ctx) {}
+    ~HiredisTransport(){
+        if (ctx_) {
+            redisFree(ctx_);
+        }
+    }
+
+    HiredisTransport(HiredisTransport &&other)
+        : ctx_(other.ctx_), cmd_(std::move(other.cmd_)), failed_(other.failed_), max_timeout_us_(other.max_timeout_us_), timeout_us_(other.timeout_us_) {
+        other.ctx_ = nullptr;
+    }
+    HiredisTransport &operator=(HiredisTransport &&other){
+        if (this != &other) {
+            if (ctx_) {
+                redisFree(ctx_);
+            }
+            ctx_ = other.ctx_;
+            cmd_ = std::move(other.cmd_);
+            failed_ = other.failed_;
+            max_timeout_us_ = other.max_timeout_us_;
+            timeout_us_ = other.timeout_us_;
+            other.ctx_ = nullptr;
+        }
+        return *this;
+    }
+    HiredisTransport(const HiredisTransport &) = delete;
+    HiredisTransport &operator=(const HiredisTransport &) = delete;
+
+    // 按选项连接节点，失败时返回的对象 ok() 为 false，err 为错误信息；options.command_timeout_ms 是命令超时的上限
+    static HiredisTransport connect(const std::string &host, int port, const ServerOptions &options, std::string &err){
+        redisContext *c = connect_redis(host, port, options);
+        if (c == nullptr || c->err) {
+            err = c ? c->errstr : "can't allocate redis context";
+            if (c) {
+                redisFree(c);
+            }
+            return HiredisTransport();
+        }
+        HiredisTransport t(c);
+        t.max_timeout_us_ = options.command_timeout_ms > 0 ? static_cast<int64_t>(options.command_timeout_ms) * 1000 : 0;
+        t.timeout_us_ = t.max_timeout_us_;  // connect_redis 按选项设置过
+        return t;
+    }
+
+    bool ok() const { return ctx_ && ctx_->err == 0; }
+    redisContext *context() const { return ctx_; }
+
+    // 之后的命令最多等待 us 微秒（0 表示只受连接选项的命令超时限制）；按毫秒向上取整，只有变化时才重新设置
+    void set_timeout_us(int64_t us){
+        if (max_timeout_us_ > 0 && (us <= 0 || us > max_timeout_us_)) {
+            us = max_timeout_us_;
+        }
+        us = (std::max<int64_t>(us, 0) + 999) / 1000 * 1000;
+        if (!ok() || us == timeout_us_) {
+            return;
+        }
+        struct timeval tv;
+        tv.tv_sec = static_cast<time_t>(us / 1000000);
+        tv.tv_usec = static_cast<suseconds_t>(us % 1000000);
+        if (redisSetTimeout(ctx_, tv) == REDIS_OK) {
+            timeout_us_ = us;
+        }
+    }
+
+    bool send_acquire(const Lock &lock, int ttl_ms){
+        return ok() && append(acquire_script(), lock, ttl_ms);
+    }
+    bool send_release(const Lock &lock){
+        if (!ok()) {
+            return false;
+        }
+        cmd_.eval(unlock_script(), lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size());
+        return redisAppendFormattedCommand(ctx_, cmd_.data(), cmd_.size()) == REDIS_OK;
+    }
+    bool send_extend(const Lock &lock, int ttl_ms){
+        return ok() && append(extend_script(), lock, ttl_ms);
+    }
+
+    void flush(){
+        int written = 0;
+        while (!written) {
+            if (redisBufferWrite(ctx_, &written) != REDIS_OK) {
+                failed_ = true;
+                return;
+            }
+        }
+    }
+
+    // 加锁成功时返回状态 "OK"，失败时返回持有者的 PTTL（-1 没有过期时间，视为未知）
+    bool recv_acquire(int64_t &lease_ms){
+        lease_ms = -1;
+        redisReply *r = recv();
+        if (!r) {
+            return false;
+        }
+        bool ok = r->type == REDIS_REPLY_STATUS && r->str && strcmp(r->str, "OK") == 0;
+        if (ok) {
+            lease_ms = 0;
+        } else if (r->type == REDIS_REPLY_INTEGER && r->integer >= 0) {
+            lease_ms = r->integer;
+        }
+        freeReplyObject(r);
+        return ok;
+    }
+    bool recv_release() { return recv_one(); }
+    bool recv_extend() { return recv_one(); }
+
+private:
+    bool append(const std::string &script, const Lock &lock, int ttl_ms){
+        cmd_.eval(script, lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size(), ttl_ms);
+        return redisAppendFormattedCommand(ctx_, cmd_.data(), cmd_.size()) == REDIS_OK;
+    }
+
+    // 读取一条回复；写出失败时不再读取（连接已带有错误）
+    redisReply *recv(){
+        if (failed_) {
+            failed_ = false;
+            return nullptr;
+        }
+        void *reply = nullptr;
+        if (redisGetReply(ctx_, &reply) != REDIS_OK) {
+            return nullptr;
+        }
+        return static_cast<redisReply *>(reply);
+    }
+
+    // 解锁/续锁脚本成功时返回整数 1
+    bool recv_one(){
+        redisReply *r = recv();
+        if (!r) {
+            return false;
+        }
+        bool ok = r->type == REDIS_REPLY_INTEGER && r->integer == 1;
+        freeReplyObject(r);
+        return ok;
+    }
+
+    redisContext *ctx_ = nullptr;
+    RespEncoder cmd_;
+    bool failed_ = false;  // 本轮写出失败
+    int64_t max_timeout_us_ = 0;  // 连接选项的命令超时（0 不限制）
+    int64_t timeout_us_ = -1;     // 当前设置在连接上的命令超时（-1 未知）
+};
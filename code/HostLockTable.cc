@@ -0,0 +1,366 @@
+#include "HostLockTable.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+constexpr size_t HostLockTable::DEFAULT_SLOTS;
+constexpr size_t HostLockTable::RESOURCE_MAX;
+
+// 共享内存中的一个槽位（一个资源）
+struct HostLockTable::Slot{
+    std::atomic<uint64_t> hash;     // 资源名哈希，0 表示空槽位
+    std::atomic<uint32_t> ready;    // 资源名已写入（占用槽位后才写入名字）
+    pthread_mutex_t mu;             // 进程间共享的健壮互斥量（只在读写以下字段时短暂持有）
+    pthread_cond_t cv;              // 槽位空闲时唤醒一个等待者（CLOCK_MONOTONIC）
+    uint32_t resource_len;
+    char resource[RESOURCE_MAX];
+    // 以下字段只在持有 mu 时读写
+    uint32_t waiters;               // 正在排队的线程数
+    uint32_t held;                  // 槽位是否被占有
+    pid_t owner_pid;                // 占有槽位的进程（用于发现崩溃的持有者）
+    uint32_t token_len;             // 0 表示槽位中没有可交接的租约
+    char token[LOCK_TOKEN_LEN];
+    int64_t expires_ns;             // 租约到期时间（steady_clock，即 CLOCK_MONOTONIC，同一主机上各进程一致）
+};
+
+// 共享内存头部
+struct HostLockTable::Header{
+    std::atomic<uint32_t> state;    // 0 未初始化，1 初始化中，2 可用
+    uint32_t slots;                 // 槽位数
+    Slot *slot_array() { return reinterpret_cast<Slot *>(this + 1); }
+};
+
+static int64_t monotonic_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 等待槽位时检查持有进程是否还在的间隔
+static constexpr int64_t OWNER_CHECK_NS = 200 * 1000000LL;
+
+// 进程是否已不存在（没有权限发信号的进程仍视为存在）
+static bool process_gone(pid_t pid){
+    return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+/*
+功能：打开（必要时创建）共享内存锁表。
+流程：shm_open + ftruncate + mmap；第一个把头部状态从 0 改为 1 的进程负责初始化所有槽位的互斥量
+（PTHREAD_PROCESS_SHARED + PTHREAD_MUTEX_ROBUST）与条件变量（PTHREAD_PROCESS_SHARED + CLOCK_MONOTONIC），
+其余进程等待状态变为 2。
+*/
+std::unique_ptr<HostLockTable> HostLockTable::open(const std::string &name, std::string &err, size_t slots){
+    if (slots == 0) {
+        err = "slots must be positive";
+        return nullptr;
+    }
+    size_t bytes = sizeof(Header) + slots * sizeof(Slot);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        err = std::string("shm_open: ") + strerror(errno);
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        err = std::string("fstat: ") + strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+    if (st.st_size == 0 && ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        err = std::string("ftruncate: ") + strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+    if (st.st_size != 0 && static_cast<size_t>(st.st_size) != bytes) {
+        err = "existing table has a different size (opened with different slots?)";
+        close(fd);
+        return nullptr;
+    }
+    void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        err = std::string("mmap: ") + strerror(errno);
+        return nullptr;
+    }
+
+    Header *header = static_cast<Header *>(mem);
+    uint32_t expected = 0;
+    if (header->state.compare_exchange_strong(expected, 1)) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_condattr_t cond_attr;
+        pthread_condattr_init(&cond_attr);
+        pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+        pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+        Slot *slot_array = header->slot_array();
+        for (size_t i = 0; i < slots; i++) {
+            pthread_mutex_init(&slot_array[i].mu, &attr);
+            pthread_cond_init(&slot_array[i].cv, &cond_attr);
+        }
+        pthread_condattr_destroy(&cond_attr);
+        pthread_mutexattr_destroy(&attr);
+        header->slots = static_cast<uint32_t>(slots);
+        header->state.store(2, std::memory_order_release);
+    } else {
+        // 等待创建者完成初始化（最多约 1 秒；创建者在初始化途中崩溃时需要删除共享内存后重建）
+        for (int i = 0; header->state.load(std::memory_order_acquire) != 2; i++) {
+            if (i >= 1000) {
+                err = "table initialization did not finish";
+                munmap(mem, bytes);
+                return nullptr;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return std::unique_ptr<HostLockTable>(new HostLockTable(header, bytes));
+}
+
+HostLockTable::~HostLockTable(){
+    munmap(header_, bytes_);
+}
+
+/*
+功能：按资源名哈希开放寻址查找槽位；create 为 true 时占用第一个空槽位（CAS 写入哈希后再写名字）。
+*/
+HostLockTable::Slot *HostLockTable::slot_for(const char *resource, size_t len, bool create){
+    if (len > RESOURCE_MAX) {
+        return nullptr;
+    }
+    uint64_t h = resource_hash(resource, len);
+    h = h ? h : 1;
+    size_t n = header_->slots;
+    Slot *slot_array = header_->slot_array();
+    for (size_t probe = 0; probe < n; probe++) {
+        Slot &slot = slot_array[(h + probe) % n];
+        uint64_t cur = slot.hash.load(std::memory_order_acquire);
+        if (cur == 0) {
+            if (!create) {
+                return nullptr;
+            }
+            if (slot.hash.compare_exchange_strong(cur, h)) {
+                slot.resource_len = static_cast<uint32_t>(len);
+                memcpy(slot.resource, resource, len);
+                slot.ready.store(1, std::memory_order_release);
+                return &slot;
+            }
+            // 被其他进程抢先占用：cur 为对方的哈希，继续比较
+        }
+        if (cur != h) {
+            continue;
+        }
+        while (slot.ready.load(std::memory_order_acquire) == 0) {
+            std::this_thread::yield();  // 占用者正在写名字（只有几条指令）
+        }
+        if (slot.resource_len == len && memcmp(slot.resource, resource, len) == 0) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+/*
+功能：加槽位互斥量。持有互斥量的进程崩溃时（EOWNERDEAD，只可能发生在读写槽位状态的几条指令之间）
+把互斥量恢复为一致状态后继续。
+*/
+void HostLockTable::lock_mutex(Slot &slot){
+    if (pthread_mutex_lock(&slot.mu) == EOWNERDEAD) {
+        pthread_mutex_consistent(&slot.mu);
+    }
+}
+
+void HostLockTable::unlock_mutex(Slot &slot){
+    pthread_mutex_unlock(&slot.mu);
+}
+
+/*
+功能：占有槽位。槽位被占有时在条件变量上睡眠（最长 OWNER_CHECK_NS 醒来一次），
+持有进程已不存在时接手槽位，槽位中的令牌仍然有效（若未过期），由当前进程使用。
+槽位空闲时总是占有它（即使已过截止时间），因此交给等待者的令牌不会因为等待者恰好超时而无人接手。
+*/
+bool HostLockTable::acquire_slot(Slot &slot, std::chrono::steady_clock::time_point deadline){
+    bool bounded = deadline != std::chrono::steady_clock::time_point::max();
+    int64_t deadline_ns = bounded ? std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count() : INT64_MAX;
+    lock_mutex(slot);
+    slot.waiters++;
+    while (slot.held) {
+        if (process_gone(slot.owner_pid)) {
+            slot.held = 0;  // 持有者崩溃：保留令牌，由当前进程接手
+            break;
+        }
+        int64_t now = monotonic_ns();
+        if (now >= deadline_ns) {
+            slot.waiters--;
+            unlock_mutex(slot);
+            return false;
+        }
+        int64_t wake_ns = std::min(deadline_ns, now + OWNER_CHECK_NS);
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(wake_ns / 1000000000);
+        ts.tv_nsec = static_cast<long>(wake_ns % 1000000000);
+        if (pthread_cond_timedwait(&slot.cv, &slot.mu, &ts) == EOWNERDEAD) {
+            pthread_mutex_consistent(&slot.mu);
+        }
+    }
+    slot.waiters--;
+    slot.held = 1;
+    slot.owner_pid = getpid();
+    unlock_mutex(slot);
+    return true;
+}
+
+void HostLockTable::release_slot(Slot &slot, bool clear_token){
+    lock_mutex(slot);
+    if (clear_token) {
+        slot.token_len = 0;
+    }
+    slot.held = 0;
+    slot.owner_pid = 0;
+    if (slot.waiters > 0) {
+        pthread_cond_signal(&slot.cv);
+    }
+    unlock_mutex(slot);
+}
+
+/*
+功能：获取锁。
+流程：
+1. 在本机排队占有资源的槽位（同一资源同一时刻只有一个进程继续）；
+2. 槽位中有上一个持有者留下的令牌：剩余租约充足时直接接手（不访问 Redis）；
+   不足但未过期时用该令牌续期，续期失败则按该令牌释放（可能仍留在部分节点上）后丢弃；已过期则丢弃；
+3. 否则通过 redlock 加锁，把令牌与到期时间写入槽位；失败时让出槽位。
+访问 Redis 时不持有槽位互斥量，其他进程的排队与截止时间不受影响。
+*/
+bool HostLockTable::lock(RedLock &redlock, const std::string &resource, int ttl_ms, Lock &lock,
+                         std::chrono::steady_clock::time_point deadline){
+    Slot *slot = slot_for(resource.data(), resource.size(), true);
+    if (!slot) {
+        bypassed_++;
+        return redlock.lock(resource, ttl_ms, lock);
+    }
+    if (!acquire_slot(*slot, deadline)) {
+        lock.valid_time_ = 0;
+        return false;
+    }
+
+    // 槽位已被当前线程占有：令牌只会被占有者修改
+    lock_mutex(*slot);
+    uint32_t token_len = slot->token_len;
+    char token[LOCK_TOKEN_LEN];
+    memcpy(token, slot->token, token_len);
+    int64_t expires_ns = slot->expires_ns;
+    unlock_mutex(*slot);
+
+    if (token_len > 0) {
+        lock.resource_.assign(resource.data(), resource.size());
+        lock.value_.assign(token, token_len);
+        int64_t remaining_ms = (expires_ns - monotonic_ns()) / 1000000;
+        if (remaining_ms >= min_handoff_ms_) {
+            lock.valid_time_ = static_cast<int>(remaining_ms);
+            redlock.adopt(lock);
+            local_handoffs_++;
+            return true;
+        }
+        if (remaining_ms > 0) {
+            if (redlock.continue_lock(resource, ttl_ms, lock)) {
+                lock_mutex(*slot);
+                slot->expires_ns = monotonic_ns() + static_cast<int64_t>(lock.valid_time_) * 1000000;
+                unlock_mutex(*slot);
+                redis_acquires_++;
+                return true;
+            }
+            redlock.unlock(lock);  // 租约已丢失：删除可能还留在部分节点上的旧令牌
+            redis_releases_++;
+        }
+        lock_mutex(*slot);
+        slot->token_len = 0;
+        unlock_mutex(*slot);
+    }
+
+    if (redlock.lock(resource, ttl_ms, lock)) {
+        lock_mutex(*slot);
+        slot->token_len = static_cast<uint32_t>(lock.value_.size());
+        memcpy(slot->token, lock.value_.data(), lock.value_.size());
+        slot->expires_ns = monotonic_ns() + static_cast<int64_t>(lock.valid_time_) * 1000000;
+        unlock_mutex(*slot);
+        redis_acquires_++;
+        return true;
+    }
+    release_slot(*slot, true);
+    return false;
+}
+
+// 槽位被占有且其中的令牌就是 lock 的令牌（调用方持有槽位互斥量）
+static bool owns_token(uint32_t held, uint32_t token_len, const char *token, const Lock &lock){
+    return held && token_len == lock.value_.size() && memcmp(token, lock.value_.data(), token_len) == 0;
+}
+
+/*
+功能：续期。通过槽位中的令牌确认锁是经由本表获取的，成功时更新槽位中的到期时间（交接时据此判断剩余租约）。
+*/
+bool HostLockTable::continue_lock(RedLock &redlock, int ttl_ms, Lock &lock){
+    std::string resource(lock.resource_.data(), lock.resource_.size());
+    if (!redlock.continue_lock(resource, ttl_ms, lock)) {
+        return false;
+    }
+    Slot *slot = slot_for(lock.resource_.data(), lock.resource_.size(), false);
+    if (slot) {
+        lock_mutex(*slot);
+        if (owns_token(slot->held, slot->token_len, slot->token, lock)) {
+            slot->expires_ns = monotonic_ns() + static_cast<int64_t>(lock.valid_time_) * 1000000;
+        }
+        unlock_mutex(*slot);
+    }
+    return true;
+}
+
+/*
+功能：释放锁（可以在与 lock 不同的线程中调用）。
+- 槽位中的令牌不是 lock 的令牌（加锁时绕过了锁表）：直接通过 redlock 释放；
+- 本机有等待者且剩余租约不少于 min_handoff_ms：保留 Redis 上的锁与槽位中的令牌，只让出槽位并唤醒一个等待者。
+  等待者数量与让出在同一次持有互斥量期间完成，被唤醒的等待者即使已过截止时间也会接手，令牌不会无人接手；
+- 否则先在 Redis 上释放，再让出槽位。
+*/
+bool HostLockTable::unlock(RedLock &redlock, const Lock &lock){
+    Slot *slot = slot_for(lock.resource_.data(), lock.resource_.size(), false);
+    if (!slot) {
+        return redlock.unlock(lock);
+    }
+    lock_mutex(*slot);
+    if (!owns_token(slot->held, slot->token_len, slot->token, lock)) {
+        unlock_mutex(*slot);
+        return redlock.unlock(lock);
+    }
+    int64_t remaining_ms = (slot->expires_ns - monotonic_ns()) / 1000000;
+    if (slot->waiters > 0 && remaining_ms >= min_handoff_ms_) {
+        slot->held = 0;
+        slot->owner_pid = 0;
+        pthread_cond_signal(&slot->cv);
+        unlock_mutex(*slot);
+        redlock.disown(lock);
+        return true;
+    }
+    slot->token_len = 0;
+    unlock_mutex(*slot);
+    bool ok = redlock.unlock(lock);
+    redis_releases_++;
+    release_slot(*slot, false);
+    return ok;
+}
+
+HostLockTable::Stats HostLockTable::stats() const{
+    Stats s;
+    s.local_handoffs = local_handoffs_.load();
+    s.redis_acquires = redis_acquires_.load();
+    s.redis_releases = redis_releases_.load();
+    s.bypassed = bypassed_.load();
+    return s;
+}
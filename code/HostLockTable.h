@@ -0,0 +1,81 @@
+#pragma once
+#include "RedLock.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <string>
+
+// 主机级锁表：同一台主机上的多个进程（或线程）通过共享内存合并对同一资源的加锁
+// - 每个资源一个槽位，槽位中是进程间共享的健壮互斥量与条件变量（Linux 上基于 futex，等待者在内核中睡眠，不轮询）；
+//   互斥量只在读写槽位状态时短暂持有，槽位的归属记录在槽位中，因此 lock 与 unlock 可以在不同线程中调用
+// - 同一时刻每个资源只有占有槽位的那个进程去 Redis 加锁，其余进程在本机排队
+// - 释放时若本机还有等待者且租约剩余时间充足，则不删除 Redis 上的锁，直接把令牌留在槽位中交给下一个进程，
+//   下一个进程接手时不访问 Redis；没有等待者时才在 Redis 上释放
+// - 持有者进程崩溃时，等待者发现持有进程已不存在后接手槽位，可以继续使用槽位中的令牌
+// 槽位按资源哈希开放寻址，一经占用不再回收；资源名过长或表已满时直接走 RedLock，不经过本机合并。
+// 所有进程必须以相同的 slots 打开同一个表，并且对同一资源使用同一组 Redis 节点。
+// 编译需要链接 -lpthread（旧版 glibc 还需要 -lrt）。
+class HostLockTable{
+public:
+    static constexpr size_t DEFAULT_SLOTS = 4096;
+    static constexpr size_t RESOURCE_MAX = 128;  // 可合并的资源名最大长度
+
+    // 累计统计（当前进程）
+    struct Stats{
+        uint64_t local_handoffs = 0;  // 从本机上一个持有者直接接手（不访问 Redis）
+        uint64_t redis_acquires = 0;  // 经 RedLock 加锁（含续期接手）
+        uint64_t redis_releases = 0;  // 在 Redis 上释放
+        uint64_t bypassed = 0;        // 不经过锁表（资源名过长或表已满）
+    };
+
+    // 打开（不存在时创建并初始化）名为 name 的共享内存锁表（name 形如 "/redlock-table"），失败时返回 nullptr 并填写 err
+    static std::unique_ptr<HostLockTable> open(const std::string &name, std::string &err, size_t slots = DEFAULT_SLOTS);
+
+    ~HostLockTable();
+
+    HostLockTable(const HostLockTable &) = delete;
+    HostLockTable &operator=(const HostLockTable &) = delete;
+
+    // 获取锁：先在本机排队拿到资源的槽位，再接手上一个持有者留下的令牌，或通过 redlock 加锁。
+    // deadline 只约束本机排队的时间；Redis 加锁按 redlock 自身的重试设置进行。
+    bool lock(RedLock &redlock, const std::string &resource, int ttl_ms, Lock &lock,
+              std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    // 续期（通过 redlock），成功时同步更新槽位中的租约到期时间
+    bool continue_lock(RedLock &redlock, int ttl_ms, Lock &lock);
+
+    // 释放：本机有等待者且租约剩余时间不少于 min_handoff_ms 时交给下一个进程，否则在 Redis 上释放
+    bool unlock(RedLock &redlock, const Lock &lock);
+
+    // 交接时要求的最小剩余租约（毫秒），不足时接手者先续期
+    void set_min_handoff_ms(int ms) { min_handoff_ms_ = ms; }
+
+    Stats stats() const;
+
+private:
+    struct Slot;
+    struct Header;
+
+    HostLockTable(Header *header, size_t bytes) : header_(header), bytes_(bytes) {}
+
+    // 查找（必要时占用）资源的槽位，表满或资源名过长时返回 nullptr
+    Slot *slot_for(const char *resource, size_t len, bool create);
+    // 加/解槽位互斥量（只在读写槽位状态时短暂持有；处理持有互斥量的进程崩溃）
+    static void lock_mutex(Slot &slot);
+    static void unlock_mutex(Slot &slot);
+    // 占有槽位：在本机排队直到槽位空闲（或持有进程已崩溃），超时返回 false
+    bool acquire_slot(Slot &slot, std::chrono::steady_clock::time_point deadline);
+    // 让出槽位并唤醒一个等待者；clear_token 为 true 时同时清除槽位中的令牌
+    void release_slot(Slot &slot, bool clear_token);
+
+    Header *header_;
+    size_t bytes_;
+    int min_handoff_ms_ = 50;
+    std::atomic<uint64_t> local_handoffs_{0};
+    std::atomic<uint64_t> redis_acquires_{0};
+    std::atomic<uint64_t> redis_releases_{0};
+    std::atomic<uint64_t> bypassed_{0};
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// 带内联存储的小字符串：长度不超过 N 时直接存放在对象内部，超过时才退化为堆内存。
+// 与 std::string 相比，锁对象中的资源名/持有者标识在常见长度下不产生任何堆分配；
+// 一旦分配过堆内存，后续 assign 会复用已有容量。
+template <size_t N>
+class InlineString{
+public:
+    InlineString() : data_(inline_), size_(0), cap_(N) { inline_[0] = '\0'; }
+    InlineString(const char *s, size_t len) : InlineString() { assign(s, len); }
+    InlineString(const std::string &s) : InlineString(s.data(), s.size()) {}
+    InlineString(const InlineString &other) : InlineString(other.data_, other.size_) {}
+    InlineString(InlineString &&other) noexcept : InlineString() { take(other); }
+    ~InlineString() { release(); }
+
+    InlineString &operator=(const InlineString &other){
+        if (this != &other) {
+            assign(other.data_, other.size_);
+        }
+        return *this;
+    }
+
+    InlineString &operator=(InlineString &&other) noexcept{
+        if (this != &other) {
+            take(other);
+        }
+        return *this;
+    }
+
+    InlineString &operator=(const std::string &s){
+        assign(s.data(), s.size());
+        return *this;
+    }
+
+    // 覆盖内容（容量足够时不分配内存）
+    void assign(const char *s, size_t len){
+        if (len > cap_) {
+            grow(len);
+        }
+        memmove(data_, s, len);
+        data_[len] = '\0';
+        size_ = len;
+    }
+
+    void clear(){
+        size_ = 0;
+        data_[0] = '\0';
+    }
+
+    const char *data() const { return data_; }
+    const char *c_str() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::string str() const { return std::string(data_, size_); }
+
+    bool operator==(const InlineString &other) const{
+        return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+    }
+    bool operator!=(const InlineString &other) const { return !(*this == other); }
+
+private:
+    bool on_heap() const { return data_ != inline_; }
+
+    void release(){
+        if (on_heap()) {
+            delete[] data_;
+        }
+        data_ = inline_;
+        cap_ = N;
+    }
+
+    // 扩容到至少 len 字节（按倍数增长，旧内容不保留）
+    void grow(size_t len){
+        size_t cap = cap_ * 2 > len ? cap_ * 2 : len;
+        char *buf = new char[cap + 1];
+        release();
+        data_ = buf;
+        cap_ = cap;
+    }
+
+    // 移动：对方在堆上时直接接管指针，否则按值拷贝（保留自己已有的容量）
+    void take(InlineString &other){
+        if (other.on_heap()) {
+            release();
+            data_ = other.data_;
+            size_ = other.size_;
+            cap_ = other.cap_;
+            other.data_ = other.inline_;
+            other.cap_ = N;
+        } else {
+            assign(other.data_, other.size_);
+        }
+        other.clear();
+    }
+
+    char *data_;         // 指向 inline_ 或堆内存
+    size_t size_;        // 当前长度
+    size_t cap_;         // 当前容量（不含结尾的'\0'）
+    char inline_[N + 1]; // 内联存储
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include "InlineString.h"
+#include "TokenGenerator.h"
+#include <string>
+
+static constexpr size_t LOCK_TOKEN_LEN = TOKEN_HEX_LEN;  // 持有者标识最大长度（160位随机数的十六进制）
+static constexpr size_t LOCK_RESOURCE_INLINE = 64;  // 资源名内联存储长度（更长的名字才使用堆内存）
+
+//表示一个分布式锁的状态的结构体（可拷贝、可移动；常见长度下不产生堆分配）
+struct Lock{
+    // 默认构造函数：初始化有效时间为0
+    Lock() : valid_time_(0) {};
+    //构造函数：通过资源名、持有者标识、有效时间初始化锁对象
+    Lock(const std::string &resource,const std::string &value,int valid_time)
+        : resource_(resource),value_(value),valid_time_(valid_time){}
+
+    InlineString<LOCK_RESOURCE_INLINE> resource_;  // 被加锁的资源名称（如"user_123_lock"）
+    InlineString<LOCK_TOKEN_LEN> value_;  // 锁的唯一持有者标识（防止误释放其他客户端的锁）
+    int valid_time_;  // 锁的剩余有效时间（单位：毫秒）
+};
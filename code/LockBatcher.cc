@@ -0,0 +1,332 @@
+#include "LockBatcher.h"
+#include "RetryPolicy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+constexpr int LockBatcher::RECONNECT_DELAY_MS;
+constexpr int LockBatcher::MAX_RECONNECT_DELAY_MS;
+
+static int64_t steady_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+LockBatcher::LockBatcher(int command_timeout_ms) : command_timeout_ms_(command_timeout_ms > 0 ? command_timeout_ms : 0) {
+    worker_ = std::thread(&LockBatcher::run, this);
+}
+
+LockBatcher::~LockBatcher() {
+    {
+        std::lock_guard<std::mutex> guard(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+    for (auto &node : nodes_) {
+        if (node.ctx) {
+            redisFree(node.ctx);
+        }
+    }
+}
+
+/*
+功能：注册一个节点。相同地址（host:port 或 Unix 域套接字路径）只建立一个连接，重复注册返回已有的编号。
+节点没有设置命令超时时使用构造函数的 command_timeout_ms。连接失败时填写 err 但仍登记节点（连接为空），
+由 prepare_node 按退避间隔重连。
+*/
+int LockBatcher::add_node(const std::string &host, int port, const ServerOptions &options, std::string &err) {
+    std::string endpoint = options.unix_path.empty() ? host + ":" + std::to_string(port) : options.unix_path;
+    {
+        std::lock_guard<std::mutex> guard(reg_mu_);
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (nodes_[i].endpoint == endpoint) {
+                return static_cast<int>(i);
+            }
+        }
+    }
+    ServerOptions opts = options;
+    if (opts.command_timeout_ms <= 0) {
+        opts.command_timeout_ms = command_timeout_ms_;
+    }
+    // 在锁外建立连接，避免阻塞 I/O 线程
+    redisContext *context = connect_redis(host, port, opts);
+    if (context == nullptr || context->err) {
+        if (context) {
+            err = std::string(context->errstr);
+            redisFree(context);
+        } else {
+            err = "Redis connection error: can't allocate redis context";
+        }
+        context = nullptr;
+    }
+    std::lock_guard<std::mutex> guard(reg_mu_);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].endpoint == endpoint) { // 并发注册了同一地址
+            if (context) {
+                redisFree(context);
+            }
+            return static_cast<int>(i);
+        }
+    }
+    nodes_.emplace_back();
+    Node &node = nodes_.back();
+    node.endpoint = endpoint;
+    node.host = host;
+    node.port = port;
+    node.options = opts;
+    node.ctx = context;
+    if (!context) {
+        node.reconnect_at_ms = steady_ms() + RECONNECT_DELAY_MS;
+        node.reconnect_delay_ms = RECONNECT_DELAY_MS * 2;
+    }
+    return static_cast<int>(nodes_.size() - 1);
+}
+
+int LockBatcher::add_group(const std::vector<int> &nodes) {
+    std::lock_guard<std::mutex> guard(reg_mu_);
+    groups_.push_back(nodes);
+    return static_cast<int>(groups_.size() - 1);
+}
+
+int LockBatcher::acquire(const std::string &script, int group, const Lock &lock, int ttl_ms, int64_t *lease_ms) {
+    Request req;
+    req.op = OP_ACQUIRE;
+    req.group = group;
+    req.script = &script;
+    req.lock = &lock;
+    req.ttl_ms = ttl_ms;
+    req.lease_ms = lease_ms;
+    return submit(req);
+}
+
+int LockBatcher::release(const std::string &script, int group, const Lock &lock, const int64_t *lease_ms) {
+    Request req;
+    req.op = OP_RELEASE;
+    req.group = group;
+    req.script = &script;
+    req.lock = &lock;
+    req.ttl_ms = 0;
+    req.lease_ms = const_cast<int64_t *>(lease_ms);  // 只读
+    return submit(req);
+}
+
+int LockBatcher::extend(const std::string &script, int group, const Lock &lock, int ttl_ms) {
+    Request req;
+    req.op = OP_EXTEND;
+    req.group = group;
+    req.script = &script;
+    req.lock = &lock;
+    req.ttl_ms = ttl_ms;
+    req.lease_ms = nullptr;
+    return submit(req);
+}
+
+LockBatcher::Stats LockBatcher::stats() const {
+    std::lock_guard<std::mutex> guard(mu_);
+    return stats_;
+}
+
+/*
+功能：把请求压入无锁栈并等待 I/O 线程完成。
+说明：只有栈由空变为非空的那个生产者需要唤醒 I/O 线程（之后的请求会被同一次交换取走）；
+     通知在 mu_ 下进行，I/O 线程在 mu_ 下检查栈是否为空后才睡眠，因此不会丢失唤醒。
+*/
+int LockBatcher::submit(Request &req) {
+    Request *head = head_.load(std::memory_order_relaxed);
+    do {
+        req.next = head;
+    } while (!head_.compare_exchange_weak(head, &req, std::memory_order_release, std::memory_order_relaxed));
+    if (head == nullptr) {
+        std::lock_guard<std::mutex> guard(mu_);
+        cv_.notify_one();
+    }
+    std::unique_lock<std::mutex> guard(req.mu);
+    req.cv.wait(guard, [&req]() { return req.done; });
+    return req.success;
+}
+
+/*
+功能：I/O 线程主循环。每次交换取走栈中的全部请求（反转为到达顺序）作为一批发送，
+发送期间新到的请求累积为下一批；退出时先处理完剩余的请求。
+*/
+void LockBatcher::run() {
+    std::vector<Request *> batch;
+    for (;;) {
+        Request *list = head_.exchange(nullptr, std::memory_order_acquire);
+        if (list == nullptr) {
+            std::unique_lock<std::mutex> guard(mu_);
+            cv_.wait(guard, [this]() { return stop_ || head_.load(std::memory_order_relaxed) != nullptr; });
+            if (stop_ && head_.load(std::memory_order_relaxed) == nullptr) {
+                return;
+            }
+            continue;
+        }
+        for (; list; list = list->next) {
+            batch.push_back(list);
+        }
+        std::reverse(batch.begin(), batch.end());
+
+        send_batch(batch);
+
+        for (Request *req : batch) {
+            // 在 req.mu 下通知：调用方被唤醒后会立即销毁栈上的请求
+            std::lock_guard<std::mutex> guard(req->mu);
+            req->done = true;
+            req->cv.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> guard(mu_);
+            stats_.requests += batch.size();
+            stats_.batches++;
+        }
+        batch.clear();
+    }
+}
+
+/*
+功能：发送一批请求。
+流程：
+1. 按节点归类：每个请求在其所在组的每个（需要执行的）节点上编码一条 EVAL，追加到该节点本轮的编码缓冲；
+2. 每个节点的全部命令一次写出（各节点并行执行）；
+3. 逐个节点按发送顺序读取回复，把结果写回对应请求的组内下标。节点出错后其余命令都视为失败。
+*/
+void LockBatcher::send_batch(std::vector<Request *> &batch) {
+    std::lock_guard<std::mutex> guard(reg_mu_);
+    for (auto &node : nodes_) {
+        node.cmd.clear();
+        node.slots.clear();
+    }
+    for (Request *req : batch) {
+        const std::vector<int> &members = groups_[req->group];
+        for (size_t i = 0; i < members.size(); i++) {
+            if (req->op == OP_ACQUIRE) {
+                req->lease_ms[i] = LEASE_NOT_SENT;
+            }
+            if (members[i] < 0 || (req->op == OP_RELEASE && req->lease_ms && !lease_needs_release(req->lease_ms[i]))) {
+                continue;
+            }
+            Node &node = nodes_[members[i]];
+            const Lock &lock = *req->lock;
+            node.cmd.begin(req->op == OP_RELEASE ? 5 : 6);
+            node.cmd.arg("EVAL", 4);
+            node.cmd.arg(*req->script);
+            node.cmd.arg(static_cast<int64_t>(1));
+            node.cmd.arg(lock.resource_.data(), lock.resource_.size());
+            node.cmd.arg(lock.value_.data(), lock.value_.size());
+            if (req->op != OP_RELEASE) {
+                node.cmd.arg(static_cast<int64_t>(req->ttl_ms));
+            }
+            node.slots.push_back(Slot{req, i});
+        }
+    }
+
+    uint64_t commands = 0;
+    for (auto &node : nodes_) {
+        if (node.slots.empty()) {
+            continue;
+        }
+        if (!prepare_node(node)) {
+            node.slots.clear();
+            continue;
+        }
+        if (redisAppendFormattedCommand(node.ctx, node.cmd.data(), node.cmd.size()) != REDIS_OK) {
+            node_failed(node);
+            node.slots.clear();
+            continue;
+        }
+        int written = 0;
+        while (!written) {
+            if (redisBufferWrite(node.ctx, &written) != REDIS_OK) {
+                node_failed(node);
+                node.slots.clear();
+                break;
+            }
+        }
+        commands += node.slots.size();
+        for (const Slot &slot : node.slots) {
+            if (slot.req->op == OP_ACQUIRE) {
+                slot.req->lease_ms[slot.index] = LEASE_UNKNOWN;  // 已发出，回复到达前结果未知
+            }
+        }
+    }
+
+    for (auto &node : nodes_) {
+        for (const Slot &slot : node.slots) {
+            void *reply = nullptr;
+            if (redisGetReply(node.ctx, &reply) != REDIS_OK) {
+                node_failed(node);  // 超时或连接出错：后续回复都读不到了，连接上可能还有迟到的回复
+                break;
+            }
+            redisReply *r = static_cast<redisReply *>(reply);
+            Request *req = slot.req;
+            if (!r) {
+                // 没有回复对象（不会发生）：按失败处理
+            } else if (req->op == OP_ACQUIRE) {
+                if (r->type == REDIS_REPLY_STATUS && r->str && strcmp(r->str, "OK") == 0) {
+                    req->lease_ms[slot.index] = 0;
+                    req->success++;
+                } else if (r->type == REDIS_REPLY_INTEGER) {
+                    req->lease_ms[slot.index] = r->integer >= 0 ? r->integer : -1;
+                }
+            } else if (r->type == REDIS_REPLY_INTEGER && r->integer == 1) {
+                req->success++;
+            }
+            freeReplyObject(reply);
+        }
+        if (node.ctx && node.ctx->err == 0) {
+            node.reconnect_delay_ms = 0;
+        }
+    }
+
+    std::lock_guard<std::mutex> stats_guard(mu_);
+    stats_.commands += commands;
+}
+
+/*
+功能：发送前准备节点：连接失效时到了重连时间才重连（连接超时不超过命令超时）。
+返回值：false 表示节点暂不可用，本轮发往该节点的命令都视为失败。
+*/
+bool LockBatcher::prepare_node(Node &node) {
+    if (node.ctx && node.ctx->err == 0) {
+        return true;
+    }
+    if (steady_ms() < node.reconnect_at_ms) {
+        return false;
+    }
+    ServerOptions options = node.options;
+    if (options.command_timeout_ms > 0) {
+        options.connect_timeout_ms = std::min(options.connect_timeout_ms, options.command_timeout_ms);
+    }
+    redisContext *context = connect_redis(node.host, node.port, options);
+    if (!context || context->err) {
+        if (context) {
+            redisFree(context);
+        }
+        node_failed(node);
+        return false;
+    }
+    if (node.ctx) {
+        redisFree(node.ctx);
+    }
+    node.ctx = context;
+    std::lock_guard<std::mutex> guard(mu_);
+    stats_.reconnects++;
+    return true;
+}
+
+/*
+功能：命令超时或连接出错后调用：把连接标记为失效，在退避间隔之后由 prepare_node 重连，连续失败时间隔加倍。
+*/
+void LockBatcher::node_failed(Node &node) {
+    if (node.ctx && node.ctx->err == 0) {
+        node.ctx->err = REDIS_ERR_OTHER;
+        snprintf(node.ctx->errstr, sizeof(node.ctx->errstr), "command failed");
+    }
+    int delay = node.reconnect_delay_ms > 0 ? node.reconnect_delay_ms : RECONNECT_DELAY_MS;
+    node.reconnect_at_ms = steady_ms() + delay;
+    node.reconnect_delay_ms = std::min(delay * 2, MAX_RECONNECT_DELAY_MS);
+    std::lock_guard<std::mutex> guard(mu_);
+    stats_.node_errors++;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "Lock.h"
+#include "RespEncoder.h"
+#include "ServerOptions.h"
+#include <hiredis/hiredis.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 自动攒批的加锁 I/O 线程：多个线程（各自的 RedLock 实例）的加锁/续锁/解锁请求放进无锁队列，
+// 由一个 I/O 线程取走当前所有请求，按节点把命令合并成一次流水线写出，再按顺序把回复分发给等待的调用方。
+// - 并发调用越多，每个节点每轮往返承载的命令越多；只有一个调用方时等价于直接发送（不设攒批定时器）
+// - 队列为多生产者单消费者的无锁栈：入队是一次 CAS，I/O 线程一次交换取走全部请求
+// - 请求对象在调用方的栈上，入队与完成都不分配内存
+// - I/O 线程持有自己的连接（相同地址只连接一次），连接出错后按退避间隔重连
+// 通过 RedLock::set_batcher 启用，调用方代码（lock / try_lock / continue_lock / unlock）不需要修改。
+class LockBatcher{
+public:
+    // 累计统计
+    struct Stats{
+        uint64_t requests = 0;     // 处理的请求数（每个请求是组内所有节点上的一次操作）
+        uint64_t batches = 0;      // I/O 线程的发送轮次
+        uint64_t commands = 0;     // 发往Redis的命令条数
+        uint64_t node_errors = 0;  // 命令超时或连接出错的次数
+        uint64_t reconnects = 0;   // 重连成功的次数
+    };
+
+    // command_timeout_ms：节点没有设置 command_timeout_ms 时使用的命令超时（一个卡住的节点会拖住整轮，不能不限制）
+    explicit LockBatcher(int command_timeout_ms = 1000);
+    // 处理完队列中剩余的请求后退出 I/O 线程并关闭连接
+    ~LockBatcher();
+
+    LockBatcher(const LockBatcher &) = delete;
+    LockBatcher &operator=(const LockBatcher &) = delete;
+
+    // 注册一个节点（相同地址只连接一次），返回节点编号。连接失败时填写 err，节点仍然登记，
+    // 由 I/O 线程按退避间隔重连（在此之前该节点上的操作视为失败）
+    int add_node(const std::string &host, int port, const ServerOptions &options, std::string &err);
+
+    // 注册一个节点组（组内节点编号，-1 表示不可用的节点，按组内下标对应各操作的结果），返回组编号
+    int add_group(const std::vector<int> &nodes);
+
+    // 在组内每个节点上执行一次加锁脚本（EVAL script 1 resource token ttl），阻塞到所有回复到达或失败。
+    // lease_ms[i] 为组内第 i 个节点的结果：0 加锁成功，>0 持有者租约的剩余时间，LEASE_UNKNOWN 已发出但结果未知，LEASE_NOT_SENT 未发出。返回加锁成功的节点数
+    int acquire(const std::string &script, int group, const Lock &lock, int ttl_ms, int64_t *lease_ms);
+
+    // 在组内节点上执行解锁脚本（EVAL script 1 resource token），lease_ms 非空时只在 lease_needs_release(lease_ms[i]) 的节点上执行。
+    // 返回确认删除的节点数
+    int release(const std::string &script, int group, const Lock &lock, const int64_t *lease_ms);
+
+    // 在组内每个节点上执行续锁脚本（EVAL script 1 resource token ttl），返回续期成功的节点数
+    int extend(const std::string &script, int group, const Lock &lock, int ttl_ms);
+
+    Stats stats() const;
+
+private:
+    enum Op : uint8_t{
+        OP_ACQUIRE,
+        OP_RELEASE,
+        OP_EXTEND,
+    };
+
+    // 一次调用（在调用方的栈上，完成前调用方一直等待）
+    struct Request{
+        Request *next = nullptr;          // 无锁栈的链接
+        Op op;
+        int group;
+        const std::string *script;
+        const Lock *lock;
+        int ttl_ms;
+        int64_t *lease_ms;                // OP_ACQUIRE 的输出 / OP_RELEASE 的筛选（可为空）
+        int success = 0;                  // 成功的节点数
+        bool done = false;
+        std::mutex mu;
+        std::condition_variable cv;
+    };
+
+    // 节点上本轮一条命令对应的请求与组内下标
+    struct Slot{
+        Request *req;
+        size_t index;
+    };
+
+    struct Node{
+        std::string endpoint;          // host:port 或 Unix 域套接字路径（用于去重）
+        std::string host;
+        int port = 0;
+        ServerOptions options;
+        redisContext *ctx = nullptr;
+        RespEncoder cmd;               // 本轮所有命令的编码（一次写出）
+        std::vector<Slot> slots;       // 本轮命令按发送顺序对应的请求
+        int64_t reconnect_at_ms = 0;   // 连接失效后最早的重连时间（steady_clock 毫秒）
+        int reconnect_delay_ms = 0;    // 下一次重连失败后的退避间隔（毫秒）
+    };
+
+    int submit(Request &req);
+    void run();
+    void send_batch(std::vector<Request *> &batch);
+    bool prepare_node(Node &node);
+    void node_failed(Node &node);
+
+    static constexpr int RECONNECT_DELAY_MS = 200;       // 首次重连间隔
+    static constexpr int MAX_RECONNECT_DELAY_MS = 5000;  // 重连间隔上限
+
+    int command_timeout_ms_;
+    std::atomic<Request *> head_{nullptr};  // 待处理的请求（后进先出，I/O 线程取走后反转为到达顺序）
+    mutable std::mutex mu_;                 // 保护 stop_、统计；与 cv_ 配合让空闲的 I/O 线程睡眠
+    std::condition_variable cv_;            // 队列由空变为非空 / 需要退出
+    bool stop_ = false;
+    std::mutex reg_mu_;                     // 保护 nodes_ / groups_（注册时追加，I/O 线程发送期间持有）
+    std::vector<Node> nodes_;               // 已注册的节点
+    std::vector<std::vector<int>> groups_;  // 已注册的节点组
+    Stats stats_;
+    std::thread worker_;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// redlockd 与 RedLockClient 之间的 Unix 域套接字协议（纯头文件）
+// 每条消息是一个定长头部加变长数据，整数按主机字节序（只在同一台主机上使用）：
+//   请求：LockRequestHeader + resource + token（加锁请求没有 token）
+//   回复：LockResponseHeader + token（只有加锁成功时携带）
+// 同一连接上的请求按顺序处理、按顺序回复；id 由客户端填写，回复原样带回，用于校验。
+
+static constexpr size_t LOCKPROTO_MAX_RESOURCE = 1024;  // 资源名最大长度
+static constexpr size_t LOCKPROTO_MAX_TOKEN = 255;      // 令牌最大长度
+
+enum LockOp : uint8_t{
+    LOCK_OP_LOCK = 1,      // 按守护进程的重试设置加锁；wait_ms >= 0 时改为在 wait_ms 内反复尝试
+    LOCK_OP_TRY_LOCK = 2,  // 只尝试一轮
+    LOCK_OP_UNLOCK = 3,    // 释放（等待多数派确认）
+    LOCK_OP_CONTINUE = 4,  // 续期
+};
+
+enum LockStatus : uint8_t{
+    LOCK_STATUS_OK = 0,
+    LOCK_STATUS_FAILED = 1,  // 没有拿到锁 / 续期失败 / 未在多数派节点上确认删除
+    LOCK_STATUS_ERROR = 2,   // 请求格式错误或守护进程没有可用节点
+};
+
+struct LockRequestHeader{
+    uint32_t id;
+    uint8_t op;
+    uint8_t token_len;
+    uint16_t resource_len;
+    int32_t ttl_ms;
+    int32_t wait_ms;  // 仅 LOCK_OP_LOCK：-1 表示按守护进程的重试次数
+};
+
+struct LockResponseHeader{
+    uint32_t id;
+    uint8_t status;
+    uint8_t token_len;
+    uint16_t reserved;
+    int32_t valid_ms;  // 锁的剩余有效时间（守护进程返回时刻起算）
+};
+
+// 读满 len 字节，对端关闭或出错时返回 false
+inline bool lockproto_read(int fd, void *buf, size_t len){
+    char *p = static_cast<char *>(buf);
+    while (len > 0) {
+        ssize_t n = ::read(fd, p, len);
+        if (n > 0) {
+            p += n;
+            len -= static_cast<size_t>(n);
+        } else if (n == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 一次 sendmsg 写出头部与两段数据（通常一次系统调用完成），不产生 SIGPIPE
+inline bool lockproto_write(int fd, const void *head, size_t head_len, const void *a, size_t a_len, const void *b, size_t b_len){
+    struct iovec iov[3] = {{const_cast<void *>(head), head_len}, {const_cast<void *>(a), a_len}, {const_cast<void *>(b), b_len}};
+    struct iovec *cur = iov;
+    int count = 3;
+    while (count > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = cur;
+        msg.msg_iovlen = count;
+        ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size_t left = static_cast<size_t>(n);
+        while (count > 0 && left >= cur->iov_len) {
+            left -= cur->iov_len;
+            cur++;
+            count--;
+        }
+        if (count > 0) {
+            cur->iov_base = static_cast<char *>(cur->iov_base) + left;
+            cur->iov_len -= left;
+        }
+    }
+    return true;
+}
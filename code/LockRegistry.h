@@ -0,0 +1,151 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Lock;
+
+// 客户端当前持有的锁的登记表（按资源名分片，每个分片一把互斥锁，降低多线程竞争）
+// 模板参数 LockT 为锁对象类型（需要有 resource_ / value_ / valid_time_ 成员），避免与 RedLock.h 循环依赖
+// - key 直接使用锁对象的资源名类型（InlineString），常见长度下查找与更新都不分配内存
+// - 每条记录带有效期截止时间（登记时刻 + valid_time_）；过期的记录查不到，
+//   分片中的记录数达到上次清理后的两倍时顺带清理，未解锁就过期的锁不会无限累积
+template <typename LockT>
+class BasicLockRegistry{
+public:
+    static constexpr size_t SHARD_COUNT = 16;  // 分片数
+    static constexpr size_t MIN_SWEEP = 64;    // 分片记录数达到该值（及上次清理后的两倍）时清理过期记录
+
+    // 登记（或更新）一把锁，有效期为 lock.valid_time_
+    void put(const LockT &lock){
+        int64_t now = now_ms();
+        Shard &shard = shard_for(lock.resource_.data(), lock.resource_.size());
+        std::lock_guard<std::mutex> guard(shard.mu);
+        auto it = shard.locks.find(lock.resource_);
+        if (it != shard.locks.end()) {
+            it->second.lock = lock;
+            it->second.expire_ms = now + lock.valid_time_;
+            return;
+        }
+        if (shard.locks.size() >= shard.sweep_at) {
+            sweep(shard, now);
+        }
+        shard.locks.emplace(lock.resource_, Entry{lock, now + lock.valid_time_});
+    }
+
+    // 注销一把锁（仅当登记的持有者标识与 lock 相同时），返回是否注销
+    bool erase(const LockT &lock){
+        Shard &shard = shard_for(lock.resource_.data(), lock.resource_.size());
+        std::lock_guard<std::mutex> guard(shard.mu);
+        auto it = shard.locks.find(lock.resource_);
+        if (it == shard.locks.end() || it->second.lock.value_ != lock.value_) {
+            return false;
+        }
+        shard.locks.erase(it);
+        return true;
+    }
+
+    // 按资源名查找当前持有（且未过期）的锁
+    bool find(const std::string &resource, LockT &out) const{
+        const Shard &shard = shard_for(resource.data(), resource.size());
+        Key key(resource.data(), resource.size());
+        std::lock_guard<std::mutex> guard(shard.mu);
+        auto it = shard.locks.find(key);
+        if (it == shard.locks.end() || it->second.expire_ms <= now_ms()) {
+            return false;
+        }
+        out = it->second.lock;
+        return true;
+    }
+
+    // 当前登记且未过期的锁数量
+    size_t size() const{
+        int64_t now = now_ms();
+        size_t n = 0;
+        for (const auto &shard : shards_) {
+            std::lock_guard<std::mutex> guard(shard.mu);
+            for (const auto &kv : shard.locks) {
+                n += kv.second.expire_ms > now;
+            }
+        }
+        return n;
+    }
+
+    // 拷贝出所有已登记且未过期的锁（逐个分片加锁，不会长时间阻塞其他线程）
+    std::vector<LockT> snapshot() const{
+        int64_t now = now_ms();
+        std::vector<LockT> out;
+        for (const auto &shard : shards_) {
+            std::lock_guard<std::mutex> guard(shard.mu);
+            for (const auto &kv : shard.locks) {
+                if (kv.second.expire_ms > now) {
+                    out.push_back(kv.second.lock);
+                }
+            }
+        }
+        return out;
+    }
+
+private:
+    typedef typename std::decay<decltype(std::declval<LockT>().resource_)>::type Key;
+
+    struct Entry{
+        LockT lock;
+        int64_t expire_ms;  // 有效期截止时间（steady_clock 毫秒）
+    };
+
+    // FNV-1a（同时用于选择分片与分片内的哈希表）
+    static uint32_t fnv1a(const char *data, size_t len){
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++) {
+            h ^= static_cast<uint8_t>(data[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    struct KeyHash{
+        size_t operator()(const Key &key) const { return fnv1a(key.data(), key.size()); }
+    };
+
+    struct Shard{
+        mutable std::mutex mu;
+        std::unordered_map<Key, Entry, KeyHash> locks;
+        size_t sweep_at = MIN_SWEEP;  // 记录数达到该值时清理过期记录
+    };
+
+    static int64_t now_ms(){
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 删除分片中已过期的记录（调用方持有分片锁），下次在剩余记录数的两倍时再清理
+    static void sweep(Shard &shard, int64_t now){
+        for (auto it = shard.locks.begin(); it != shard.locks.end();) {
+            if (it->second.expire_ms <= now) {
+                it = shard.locks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        shard.sweep_at = shard.locks.size() * 2 > MIN_SWEEP ? shard.locks.size() * 2 : MIN_SWEEP;
+    }
+
+    static size_t shard_index(const char *data, size_t len) { return (fnv1a(data, len) >> 16) % SHARD_COUNT; }
+
+    Shard &shard_for(const char *data, size_t len) { return shards_[shard_index(data, len)]; }
+    const Shard &shard_for(const char *data, size_t len) const { return shards_[shard_index(data, len)]; }
+
+    Shard shards_[SHARD_COUNT];
+};
+
+template <typename LockT> constexpr size_t BasicLockRegistry<LockT>::SHARD_COUNT;
+template <typename LockT> constexpr size_t BasicLockRegistry<LockT>::MIN_SWEEP;
+
+typedef BasicLockRegistry<Lock> LockRegistry;
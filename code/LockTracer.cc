@@ -0,0 +1,202 @@
+#include "LockTracer.h"
+#include "TokenGenerator.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <utility>
+
+static std::atomic<uint64_t> g_next_tracer_id{1};
+
+// 当前线程的采样随机数（xorshift64*，种子来自令牌生成器；只用于采样，不需要不可预测）
+static uint32_t sample_random(){
+    static thread_local uint64_t state = TokenGenerator::local().next_u64() | 1;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return static_cast<uint32_t>((state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// s[i] 开始的一个合法 UTF-8 多字节序列的长度（拒绝过长编码、代理区与超出 U+10FFFF 的码点），不合法时返回 0
+static size_t utf8_sequence_len(const unsigned char *s, size_t i, size_t len){
+    unsigned char c = s[i];
+    size_t n;
+    unsigned char lo = 0x80, hi = 0xbf;  // 第二个字节的范围
+    if (c >= 0xc2 && c <= 0xdf) {
+        n = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        n = 3;
+        lo = c == 0xe0 ? 0xa0 : 0x80;
+        hi = c == 0xed ? 0x9f : 0xbf;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        n = 4;
+        lo = c == 0xf0 ? 0x90 : 0x80;
+        hi = c == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+    if (len - i < n || s[i + 1] < lo || s[i + 1] > hi) {
+        return 0;
+    }
+    for (size_t k = 2; k < n; k++) {
+        if ((s[i + k] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+// 把字符串写成 JSON 字符串字面量（资源名可能含任意字节）：合法的 UTF-8 原样输出，
+// 只转义引号、反斜杠与控制字符；不是合法 UTF-8 的字节写成 U+FFFD，保证输出仍是合法的 JSON
+static void write_json_string(std::ostream &out, const char *s, size_t len){
+    const unsigned char *u = reinterpret_cast<const unsigned char *>(s);
+    out << '"';
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = u[i];
+        if (c == '"' || c == '\\') {
+            out << '\\' << static_cast<char>(c);
+        } else if (c < 0x20 || c == 0x7f) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out << buf;
+        } else if (c < 0x80) {
+            out << static_cast<char>(c);
+        } else if (size_t n = utf8_sequence_len(u, i, len)) {
+            out.write(s + i, n);
+            i += n - 1;
+        } else {
+            out << "\\ufffd";
+        }
+    }
+    out << '"';
+}
+
+LockTracer::LockTracer(const TraceOptions &options) : options_(options), id_(g_next_tracer_id.fetch_add(1)) {
+    if (options_.per_thread == 0) {
+        options_.per_thread = 1;
+    }
+    double rate = options_.sample_rate < 0 ? 0 : (options_.sample_rate > 1 ? 1 : options_.sample_rate);
+    sample_threshold_ = rate >= 1 ? UINT32_MAX : static_cast<uint32_t>(rate * 4294967296.0);
+}
+
+int64_t LockTracer::now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool LockTracer::begin(bool &sampled) {
+    sampled = sample_threshold_ == UINT32_MAX || sample_random() < sample_threshold_;
+    return sampled || options_.slow_ms > 0;
+}
+
+/*
+功能：调用结束时保留或丢弃本次调用的事件。保留时整体写入当前线程的环形缓冲（覆盖最旧的事件）。
+*/
+void LockTracer::commit(std::vector<Event> &events, bool sampled, int64_t dur_us) {
+    if (!events.empty() && (sampled || (options_.slow_ms > 0 && dur_us >= options_.slow_ms * 1000LL))) {
+        ThreadBuffer &buf = local_buffer();
+        std::lock_guard<std::mutex> guard(buf.mu);
+        for (auto &e : events) {
+            buf.ring[buf.next] = std::move(e);
+            if (++buf.next == buf.ring.size()) {
+                buf.next = 0;
+                buf.wrapped = true;
+            }
+        }
+    }
+    events.clear();
+}
+
+/*
+功能：当前线程在本追踪器中的缓冲。线程本地缓存按追踪器编号查找（编号不复用，追踪器销毁后旧的缓存项不会再被命中），
+首次使用时创建并登记到 buffers_。
+*/
+LockTracer::ThreadBuffer &LockTracer::local_buffer() {
+    static thread_local std::vector<std::pair<uint64_t, ThreadBuffer *>> cache;
+    for (const auto &entry : cache) {
+        if (entry.first == id_) {
+            return *entry.second;
+        }
+    }
+    std::shared_ptr<ThreadBuffer> buf = std::make_shared<ThreadBuffer>();
+    buf->ring.resize(options_.per_thread);
+    {
+        std::lock_guard<std::mutex> guard(mu_);
+        buffers_.push_back(buf);
+        buf->tid = static_cast<int>(buffers_.size());
+    }
+    cache.emplace_back(id_, buf.get());
+    return *buf;
+}
+
+size_t LockTracer::event_count() const {
+    std::lock_guard<std::mutex> guard(mu_);
+    size_t n = 0;
+    for (const auto &buf : buffers_) {
+        std::lock_guard<std::mutex> buf_guard(buf->mu);
+        n += buf->wrapped ? buf->ring.size() : buf->next;
+    }
+    return n;
+}
+
+/*
+功能：按 Chrome trace-event 格式写出所有线程缓冲中的事件（每个事件一个 "X"，另为每个线程写一个线程名）。
+同一线程内时间上包含的事件在 Perfetto 中显示为嵌套：lock ⊃ attempt ⊃ node / release，sleep 与 attempt 并列。
+*/
+void LockTracer::write_json(std::ostream &out) const {
+    int pid = static_cast<int>(getpid());
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> guard(mu_);
+        buffers = buffers_;
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &buf : buffers) {
+        std::lock_guard<std::mutex> guard(buf->mu);
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buf->tid
+            << ",\"args\":{\"name\":\"redlock client " << buf->tid << "\"}}";
+        first = false;
+        size_t count = buf->wrapped ? buf->ring.size() : buf->next;
+        size_t start = buf->wrapped ? buf->next : 0;
+        for (size_t k = 0; k < count; k++) {
+            const Event &e = buf->ring[(start + k) % buf->ring.size()];
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"redlock\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << buf->tid
+                << ",\"ts\":" << e.ts_us << ",\"dur\":" << e.dur_us << ",\"args\":{";
+            bool first_arg = true;
+            if (e.resource.size() > 0) {
+                out << "\"resource\":";
+                write_json_string(out, e.resource.data(), e.resource.size());
+                first_arg = false;
+            }
+            if (e.outcome) {
+                out << (first_arg ? "" : ",") << "\"outcome\":\"" << e.outcome << "\"";
+                first_arg = false;
+            }
+            if (e.node >= 0) {
+                out << (first_arg ? "" : ",") << "\"node\":" << e.node;
+                first_arg = false;
+            }
+            if (e.value_name) {
+                out << (first_arg ? "" : ",") << "\"" << e.value_name << "\":" << e.value;
+            }
+            out << "}}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool LockTracer::dump(const std::string &path, std::string &err) const {
+    std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!out) {
+        err = "cannot open " + path;
+        return false;
+    }
+    write_json(out);
+    out.flush();
+    if (!out) {
+        err = "write failed: " + path;
+        return false;
+    }
+    return true;
+}
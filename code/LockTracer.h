@@ -0,0 +1,77 @@
+#pragma once
+#include "InlineString.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 追踪选项
+struct TraceOptions{
+    double sample_rate = 0.01;  // 记录的 lock / continue_lock / unlock 调用比例（0 只按 slow_ms 保留，1 全部记录）
+    int slow_ms = 0;            // 大于0时，耗时达到该值的调用总会保留（每次调用都先记录在实例的暂存区，结束时决定是否保留）
+    size_t per_thread = 8192;   // 每个线程保留的最近事件数（环形缓冲，写满后覆盖最旧的事件）
+};
+
+// 锁操作追踪：按调用记录嵌套的时间段（一次 lock 调用 → 每一轮尝试 → 每个节点的命令 / 重试前的睡眠），
+// 导出为 Chrome trace-event JSON，可直接用 Perfetto（ui.perfetto.dev）或 chrome://tracing 打开。
+// - 采样在调用开始时决定，未命中且未设置 slow_ms 的调用只多一次分支与一次随机数
+// - 事件先记在 RedLock 实例的暂存区（实例不跨线程并发使用），调用结束时整体存入当前线程的环形缓冲，
+//   各线程的缓冲互不竞争；dump 时逐个加锁读取
+// 通过 RedLock::set_tracer 启用，可在多个实例之间共享。
+class LockTracer{
+public:
+    // 一个时间段（Chrome 的 "X" 事件）；name / outcome / value_name 必须是静态字符串
+    struct Event{
+        const char *name = nullptr;     // 事件名：lock / attempt / node / sleep / release / extend / unlock ...
+        const char *outcome = nullptr;  // 结果：acquired / held / error / unavailable / skipped ...，可为空
+        int64_t ts_us = 0;              // 开始时间（steady_clock 微秒）
+        int64_t dur_us = 0;             // 持续时间（微秒）
+        int node = -1;                  // 节点下标（按添加顺序，-1 表示不是节点命令）
+        const char *value_name = nullptr;  // 附加数值的名称（attempt / pttl_ms / delay_ms / nodes_ok / valid_ms ...），为空表示没有
+        int64_t value = 0;
+        InlineString<64> resource;      // 资源名（只有最外层的调用事件填写）
+    };
+
+    explicit LockTracer(const TraceOptions &options = TraceOptions());
+
+    LockTracer(const LockTracer &) = delete;
+    LockTracer &operator=(const LockTracer &) = delete;
+
+    // 调用开始时调用：返回是否需要记录本次调用；sampled 表示采样命中（未命中时只在耗时达到 slow_ms 时保留）
+    bool begin(bool &sampled);
+
+    // 调用结束时调用：采样命中或总耗时达到 slow_ms 时，把 events 存入当前线程的缓冲。events 随后被清空
+    void commit(std::vector<Event> &events, bool sampled, int64_t dur_us);
+
+    // 写出 Chrome trace-event JSON
+    void write_json(std::ostream &out) const;
+
+    // 写到文件，失败时填写 err
+    bool dump(const std::string &path, std::string &err) const;
+
+    // 当前保留的事件总数
+    size_t event_count() const;
+
+    // 与事件时间戳同源的时钟（steady_clock 微秒）
+    static int64_t now_us();
+
+private:
+    struct ThreadBuffer{
+        std::mutex mu;             // 所属线程写入与 dump 读取之间的互斥（平时无竞争）
+        int tid = 0;               // 线程编号（从1开始，按首次写入的顺序）
+        std::vector<Event> ring;   // 环形缓冲
+        size_t next = 0;           // 下一个写入位置
+        bool wrapped = false;      // 是否已写满过一圈
+    };
+
+    ThreadBuffer &local_buffer();
+
+    TraceOptions options_;
+    uint64_t id_;                                        // 实例编号（线程本地缓存按它查找本实例的缓冲）
+    uint32_t sample_threshold_;                          // 随机数小于该值时采样命中
+    mutable std::mutex mu_;                              // 保护 buffers_
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_; // 各线程的缓冲
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// 对数分桶直方图（AdaptiveTtl 的持锁时间、RedLock 的节点命令延迟共用）
+// - 0..7 每个值一个桶，之后每个 2 的幂区间 4 个桶，相对误差 ≤ 25%，上限 2^24 - 1（单位由使用者决定）
+// - 92 个 16 位计数，约 200 字节
+// - 样本数达到 DECAY_AT 时所有桶减半，分布会跟随最近的数据变化
+class LogHistogram{
+public:
+    static constexpr uint32_t DECAY_AT = 512;  // 样本数达到该值时衰减
+    static constexpr int EXACT = 8;            // 0..7 每个值一个桶
+    static constexpr int MAX_EXP = 23;         // 最大 2^24 - 1
+    static constexpr int BUCKETS = EXACT + (MAX_EXP - 2) * 4;
+
+    void add(int64_t v){
+        counts_[bucket_of(v)]++;
+        if (++total_ >= DECAY_AT) {
+            total_ = 0;
+            for (auto &c : counts_) {
+                c = static_cast<uint16_t>(c / 2);
+                total_ += c;
+            }
+        }
+    }
+
+    // 分位数估计（取桶内最大值，估计偏大）；没有样本时返回桶上限
+    int64_t quantile(double q) const{
+        uint64_t target = static_cast<uint64_t>(std::ceil(q * total_));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts_[i];
+            if (seen >= target && seen > 0) {
+                return upper_of(i);
+            }
+        }
+        return upper_of(BUCKETS - 1);
+    }
+
+    // 当前（衰减后）的样本数
+    uint32_t total() const { return total_; }
+
+    static int bucket_of(int64_t v){
+        if (v < EXACT) {
+            return v < 0 ? 0 : static_cast<int>(v);
+        }
+        v = std::min<int64_t>(v, (int64_t(1) << (MAX_EXP + 1)) - 1);
+        int e = 63 - __builtin_clzll(static_cast<uint64_t>(v));  // v 的最高位（≥3）
+        int sub = static_cast<int>((v >> (e - 2)) & 3);           // 最高位之后两位
+        return EXACT + (e - 3) * 4 + sub;
+    }
+
+    // 桶内最大值
+    static int64_t upper_of(int idx){
+        if (idx < EXACT) {
+            return idx;
+        }
+        int e = 3 + (idx - EXACT) / 4;
+        int sub = (idx - EXACT) % 4;
+        return ((int64_t(4 + sub + 1)) << (e - 2)) - 1;
+    }
+
+private:
+    uint16_t counts_[BUCKETS] = {};
+    uint32_t total_ = 0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include "Lock.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// RedLockCore 的内存传输层：每个对象模拟一个 Redis 节点（不做任何 I/O），用于压测与测试
+// 按 Clock 判断 key 是否过期；down 为 true 时模拟节点不可达（所有命令写入失败）
+template <typename Clock = std::chrono::steady_clock>
+class MockTransport{
+public:
+    bool down = false;
+
+    void set_timeout_us(int64_t) {}  // 内存中立即执行，没有超时
+
+    bool send_acquire(const Lock &lock, int ttl_ms){
+        if (down) {
+            return false;
+        }
+        int64_t now = now_ms();
+        Entry *e = find(key_of(lock), now);
+        if (e) {
+            replies_.push_back(e->expire_ms - now);
+        } else {
+            kv_[key_of(lock)] = Entry{std::string(lock.value_.data(), lock.value_.size()), now + ttl_ms};
+            replies_.push_back(0);
+        }
+        return true;
+    }
+
+    bool send_release(const Lock &lock){
+        if (down) {
+            return false;
+        }
+        Entry *e = find(key_of(lock), now_ms());
+        bool match = e && owned(*e, lock);
+        if (match) {
+            kv_.erase(key_of(lock));
+        }
+        replies_.push_back(match ? 1 : 0);
+        return true;
+    }
+
+    bool send_extend(const Lock &lock, int ttl_ms){
+        if (down) {
+            return false;
+        }
+        int64_t now = now_ms();
+        Entry *e = find(key_of(lock), now);
+        bool match = e && owned(*e, lock);
+        if (match) {
+            e->expire_ms = now + ttl_ms;
+        }
+        replies_.push_back(match ? 1 : 0);
+        return true;
+    }
+
+    void flush() {}
+
+    bool recv_acquire(int64_t &lease_ms){
+        lease_ms = pop();
+        return lease_ms == 0;
+    }
+    bool recv_release() { return pop() == 1; }
+    bool recv_extend() { return pop() == 1; }
+
+    // 当前保存的（未过期的和尚未清理的）key 数量
+    size_t size() const { return kv_.size(); }
+
+private:
+    struct Entry{
+        std::string token;
+        int64_t expire_ms;
+    };
+
+    static int64_t now_ms(){
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    // 资源名作为 key（复用一个字符串，稳定状态下不分配）
+    const std::string &key_of(const Lock &lock){
+        key_.assign(lock.resource_.data(), lock.resource_.size());
+        return key_;
+    }
+
+    static bool owned(const Entry &e, const Lock &lock){
+        return e.token.size() == lock.value_.size() && e.token.compare(0, e.token.size(), lock.value_.data(), lock.value_.size()) == 0;
+    }
+
+    Entry *find(const std::string &key, int64_t now){
+        auto it = kv_.find(key);
+        if (it == kv_.end()) {
+            return nullptr;
+        }
+        if (it->second.expire_ms <= now) {
+            kv_.erase(it);
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    int64_t pop(){
+        int64_t v = replies_[head_++];
+        if (head_ == replies_.size()) {
+            replies_.clear();
+            head_ = 0;
+        }
+        return v;
+    }
+
+    std::unordered_map<std::string, Entry> kv_;
+    std::string key_;
+    std::vector<int64_t> replies_;  // 已执行、尚未读取的回复（按发送顺序）
+    size_t head_ = 0;
+};
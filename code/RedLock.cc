@@ -1,10 +1,18 @@
 #include "RedLock.h"
+#include "LockScripts.h"
 #include <bits/types/struct_timeval.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <random>
 #include <thread>
 #include <cstring>
-#include<iostream>
+#include <limits>
+
+// C++11 下 ODR 使用（如传给 std::min）的静态常量需要类外定义
+constexpr size_t RedLock::RELEASE_BATCH;
+constexpr int RedLock::AUTO_TTL;
 
 //功能：获取当前系统时间的毫秒级时间戳，用于计算操作耗时和锁的有效时间。
 static int64_t get_current_time_ms(){
@@ -19,20 +27,23 @@ static int64_t get_current_time_ms(){
     return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
 }
 
-//功能：生成一个 40 位的唯一字符串，作为锁的持有者标识，避免不同客户端误释放对方的锁
-//原理：通过硬件随机数生成器rd获取种子，生成 5 个 32 位随机数，格式化为十六进制字符串，确保唯一性。
-static std::random_device rd;
+//功能：单调时钟的微秒/毫秒读数，用于测量命令往返延迟与安排重连（不受系统时间调整影响）
+static int64_t get_steady_time_us(){
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
 
-static std::string generate_unique_id(){
-    std::uniform_int_distribution<int>dist;  //生成[0, INT_MAX]的均匀分布随机数
-    uint32_t buffer[5]; // 存储5个32位随机数（共160位，降低碰撞概率）
-    for(auto &num : buffer) num = dist(rd);  // 填充随机数
+static int64_t get_steady_time_ms(){
+    return get_steady_time_us() / 1000;
+}
 
-    char buf[41] = {0};  // 存储40位十六进制字符串（+1位终止符）
-    // 格式化为8位十六进制数 ×5，共40位（例如："a1b2c3d4e5f6..."）
-    ::snprintf(buf,sizeof(buf),"%08x%08x%08x%08x%08x",
-              buffer[0], buffer[1], buffer[2], buffer[3], buffer[4]);
-    return std::string(buf, 40); // 截取前40位（忽略终止符）
+//功能：生成一个 160 位的唯一令牌，作为锁的持有者标识，避免不同客户端误释放对方的锁
+//原理：使用当前线程的 ChaCha20 生成器（TokenGenerator，种子来自 getrandom），按批取用，无系统调用、无线程竞争。
+//      Hex 格式为 40 位十六进制字符串，Binary 格式为 20 个原始字节。
+static void generate_unique_id(TokenFormat format, InlineString<LOCK_TOKEN_LEN> &out){
+    char buf[LOCK_TOKEN_LEN];
+    size_t len = TokenGenerator::local().next(format, buf);
+    out.assign(buf, len); // 直接写入锁对象的内联缓冲区
 } 
 
 
@@ -44,20 +55,110 @@ port：Redis 服务器的端口（如6379）。
 err：输出参数，存储错误信息（如连接失败原因）。
 */
 bool RedLock::add_server(const std::string &host,int port,std::string &err){
-    // 检查服务器是否已存在（通过连接状态、主机名、端口号）
-    for (const auto &ctx : servers_) {
+    return add_server(host, port, ServerOptions(), err);
+}
+
+/*
+功能：按连接选项添加一个 Redis 服务器节点（属于第0组）。
+参数：
+options：连接选项。unix_path 非空时通过 Unix 域套接字连接（此时忽略 host/port），
+         另可设置连接/命令超时、TCP_NODELAY、keepalive、SO_RCVBUF/SO_SNDBUF。
+*/
+bool RedLock::add_server(const std::string &host, int port, const ServerOptions &options, std::string &err){
+    redisContext *context = connect_node(host, port, options, err);
+    if (!context) {
+        return false;
+    }
+    // 不分组时所有节点都属于第0组（整个实例只有一个多数派）
+    if (groups_.empty()) {
+        groups_.emplace_back();
+    }
+    attach_node(context, 0, host, port, options);
+    return true;
+}
+
+/*
+功能：添加一组相互独立的 Redis 节点（一个新的多数派组）。资源按一致性哈希路由到某一组，
+每组独立执行 RedLock 的多数派逻辑，总吞吐随节点数线性增长；追加一组只会迁移约 1/G 的资源。
+参数：
+servers：该组的节点列表（host, port），通常为3或5个。
+err：输出参数，任一节点连接失败时为错误信息，此时整组都不会加入。
+注意：组下标即组的身份，只能在末尾追加；add_server 添加的节点属于第0组。
+*/
+bool RedLock::add_server_group(const std::vector<std::pair<std::string, int>> &servers, std::string &err){
+    return add_server_group(servers, ServerOptions(), err);
+}
+
+/*
+功能：按连接选项添加一组节点，组内每个节点使用相同的选项（unix_path 只能用于单个节点，这里不允许设置）。
+*/
+bool RedLock::add_server_group(const std::vector<std::pair<std::string, int>> &servers, const ServerOptions &options, std::string &err){
+    if (servers.empty()) {
+        err = "Empty server group";
+        return false;
+    }
+    if (!options.unix_path.empty()) {
+        err = "unix_path cannot be shared by a server group";
+        return false;
+    }
+    for (size_t i = 0; i < servers.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (servers[i] == servers[j]) {
+                err = "Redis server already exists";
+                return false;
+            }
+        }
+    }
+    std::vector<redisContext *> contexts;
+    for (const auto &server : servers) {
+        redisContext *context = connect_node(server.first, server.second, options, err);
+        if (!context) { // 整组要么全部加入，要么都不加入
+            for (redisContext *c : contexts) {
+                redisFree(c);
+            }
+            return false;
+        }
+        contexts.push_back(context);
+    }
+    groups_.emplace_back();
+    for (size_t i = 0; i < contexts.size(); i++) {
+        attach_node(contexts[i], groups_.size() - 1, servers[i].first, servers[i].second, options);
+    }
+    return true;
+}
+
+/*
+功能：资源名所属的组下标（一致性哈希）。
+*/
+size_t RedLock::group_of(const std::string &resource) const {
+    return shard_of(resource.data(), resource.size(), groups_.size());
+}
+
+/*
+功能：连接一个 Redis 节点（检查重复后建立连接），失败时返回 nullptr 并填写 err。
+*/
+redisContext *RedLock::connect_node(const std::string &host, int port, const ServerOptions &options, std::string &err){
+    // 检查服务器是否已存在（TCP 比较主机名和端口号，Unix 域套接字比较路径）
+    for (const auto &node : servers_) {
+        const redisContext *ctx = node.ctx;
         // 确保 ctx 有效且连接成功
         if (ctx && ctx->err == 0) {
-            // 直接使用 ctx->tcp.host 和 ctx->tcp.port（hiredis 已正确设置）
-            if (host == ctx->tcp.host && port == ctx->tcp.port) { 
+            bool same = false;
+            if (ctx->connection_type == REDIS_CONN_UNIX) {
+                same = !options.unix_path.empty() && ctx->unix_sock.path && options.unix_path == ctx->unix_sock.path;
+            } else {
+                // 直接使用 ctx->tcp.host 和 ctx->tcp.port（hiredis 已正确设置）
+                same = options.unix_path.empty() && ctx->tcp.host && host == ctx->tcp.host && port == ctx->tcp.port;
+            }
+            if (same) {
                 err = "Redis server already exists";
-                return false;
+                return nullptr;
             }
         }
     }
 
-    struct timeval timeout = {1, 500000};  // 1.5 秒超时
-    redisContext *context = redisConnectWithTimeout(host.c_str(), port, timeout);
+    // 按选项连接（Unix 域套接字 / 超时 / TCP_NODELAY / keepalive / 收发缓冲区）
+    redisContext *context = connect_redis(host, port, options);
 
     //处理连接失败
     if (context == nullptr || context->err) {
@@ -67,212 +168,978 @@ bool RedLock::add_server(const std::string &host,int port,std::string &err){
         } else { // 连接对象分配失败（内存不足等）
             err = "Redis connection error: can't allocate redis context";
         }
-        return false;
+        return nullptr;
     }
+    return context;
+}
 
-    servers_.push_back(context);  //将有效连接加入服务器列表
-    // 计算多数派节点数（总节点数的一半向上取整，如3节点需要2个成功）
-    quorum_ = (servers_.size() / 2) + 1;  
-
-    return true;
+/*
+功能：把已建立的连接加入服务器列表，并归入第 group 组。
+*/
+void RedLock::attach_node(redisContext *context, size_t group, const std::string &host, int port, const ServerOptions &options){
+    servers_.emplace_back();  //将有效连接加入服务器列表
+    RedisNode &node = servers_.back();
+    node.ctx = context;
+    node.group = group;
+    node.host = host;
+    node.port = port;
+    node.options = options;
+    node.timeout_us = static_cast<int64_t>(options.command_timeout_ms) * 1000;  // connect_redis 按选项设置过
+    NodeGroup &g = groups_[group];
+    g.nodes.push_back(servers_.size() - 1);
+    // 计算该组的多数派节点数（组内节点数的一半向上取整，如3节点需要2个成功）
+    g.quorum = static_cast<int>(g.nodes.size() / 2) + 1;
+    g.sender_group = -1;  // 组成员变化，异步解锁发送器中的组需要重新注册
+    g.batcher_group = -1;
 }
 
 /*
 功能：基于 RedLock 算法，在多个 Redis 节点上获取分布式锁，要求多数派节点成功且锁有效时间充足。
 参数：
 resource：被加锁的资源名称（如"stock_lock"）。
-ttl_ms：锁的最大有效时间（毫秒，如5000表示 5 秒后自动失效）。
-lock：输出参数，存储获取到的锁信息（资源名、持有者 ID、剩余有效时间）。
+ttl_ms：锁的最大有效时间（毫秒，如5000表示 5 秒后自动失效）；为 AUTO_TTL 时由 set_adaptive_ttl 设置的模型选择。
+lock：输出参数，存储获取到的锁信息（资源名、持有者 ID、剩余有效时间）；失败时 valid_time_ 为 0。
 */
 bool RedLock::lock(const std::string &resource,int ttl_ms,Lock &lock){
+    if (acquire_timeout_ms_ > 0) { // 设置了总等待时间：以截止时间为界，不再限制次数
+        return this->lock(resource, ttl_ms, lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(acquire_timeout_ms_));
+    }
+    // 总尝试次数（包括首次尝试，如默认重试3次则总4次）
+    return acquire(resource, ttl_ms, lock, retry_count_ + 1, std::chrono::steady_clock::time_point::max());
+}
+
+/*
+功能：在截止时间之前反复尝试获取锁（不限次数），等待间隔由重试策略决定；
+若等待之后再进行一轮（耗时按上一轮估计）会越过截止时间则直接放弃，不会为了最后一次尝试而越过截止时间。
+每个节点的命令超时也不超过距截止时间的剩余时间，截止时间到达后其余节点不再发送（释放已拿到的节点后返回 false），
+所以一个卡住的节点不会让调用越过截止时间；截止时间已过时不发送任何命令。
+设置了截止时间的加锁不经过 LockBatcher（I/O 线程的一轮无法为单个调用提前结束），使用实例自己的连接。
+*/
+bool RedLock::lock(const std::string &resource, int ttl_ms, Lock &lock, std::chrono::steady_clock::time_point deadline){
+    return acquire(resource, ttl_ms, lock, std::numeric_limits<int>::max(), deadline);
+}
+
+/*
+功能：只尝试一轮加锁：各节点各一次 SET NX，未达到多数派时释放本轮拿到的节点后立即返回，不睡眠。
+*/
+bool RedLock::try_lock(const std::string &resource, int ttl_ms, Lock &lock){
+    return acquire(resource, ttl_ms, lock, 1, std::chrono::steady_clock::time_point::max());
+}
+
+/*
+功能：lock 的实际实现，最多尝试 max_attempts 轮，且不会在 deadline 之后开始新的一轮。
+*/
+bool RedLock::acquire(const std::string &resource, int ttl_ms, Lock &lock, int max_attempts, std::chrono::steady_clock::time_point deadline){
     if(servers_.empty()){
         return false;
     }
-    std::string value = generate_unique_id();  //生成唯一ID标识当前客户端的锁
+    // 直接在输出对象中填写资源名和唯一ID（内联存储，不产生临时字符串）
+    lock.resource_.assign(resource.data(), resource.size());
+    generate_unique_id(token_format_, lock.value_);  //生成唯一ID标识当前客户端的锁
+    lock.valid_time_ = 0;
+    stats_.lock_calls++;
+    ttl_ms = resolve_ttl(lock.resource_.data(), lock.resource_.size(), ttl_ms);
+    if (ttl_ms <= 0) {
+        return false;
+    }
+    const NodeGroup &group = groups_[group_of(lock.resource_.data(), lock.resource_.size())];  // 资源所属的组
+    int64_t trace_start = trace_begin();
+    int64_t call_start_us = get_steady_time_us();
+    FlightRecorder::Entry flight;  // 飞行记录（各节点为最后一轮的结果）
 
-    int attempt = retry_count_ + 1;  // 总尝试次数（包括首次尝试，如默认重试3次则总4次）
-    while(attempt-- > 0){ // 循环尝试获取锁，直到次数耗尽
+    RetryContext retry;  // 重试上下文（交给重试策略计算等待时间）
+    int64_t begin_time = get_current_time_ms();
+    bool bounded = deadline != std::chrono::steady_clock::time_point::max();
+    int64_t deadline_us = bounded ? std::chrono::duration_cast<std::chrono::microseconds>(deadline.time_since_epoch()).count() : INT64_MAX;
+    LockBatcher *batcher = bounded ? nullptr : batcher_.get();  // 有截止时间时逐个节点限制超时
+    int attempt = max_attempts;
+    while(attempt-- > 0){ // 循环尝试获取锁，直到次数耗尽或超过截止时间
+        stats_.lock_attempts++;
         int64_t start_time = get_current_time_ms();  //记录本次尝试的开始时间
         int success_count = 0;  //记录成功获取锁的节点数
 
-        // 步骤1：在所有Redis节点上尝试获取锁
-        for(auto &ctx : servers_){
-            if(lock_instance(ctx,resource,value,ttl_ms)){
+        // drift = TTL的1% + 2ms（经验值，补偿不同服务器的时钟差异）
+        int64_t drift = static_cast<int64_t>(ttl_ms * DEFAULT_LOCK_DRIFT_FACTOR) + 2;
+
+        // 步骤1：在组内所有Redis节点上尝试获取锁（失败的节点同时带回持有者租约的剩余时间）
+        // 每个节点的命令超时不超过本轮剩余的有效期预算与距截止时间的剩余时间；两者之一耗尽或剩余节点已不可能凑够多数派时，其余节点不再发送
+        int64_t round_start_us = get_steady_time_us();
+        int64_t budget_us = (ttl_ms - drift) * 1000;
+        lease_ms_.assign(group.nodes.size(), LEASE_NOT_SENT);
+        flight.node_results = 0;
+        if (batcher) { // 交给加锁 I/O 线程，与其他线程的请求合并发送
+            if (group.batcher_group == -1) {
+                bind_batcher();
+            }
+            success_count = batcher->acquire(acquire_script(), group.batcher_group, lock, ttl_ms, lease_ms_.data());
+            stats_.redis_ops += group.nodes.size();
+            for (size_t i = 0; i < group.nodes.size(); i++) {
+                flight.set_node(i, lease_ms_[i] == 0 ? FlightRecorder::NODE_OK : (lease_ms_[i] > 0 ? FlightRecorder::NODE_HELD
+                                   : (lease_ms_[i] == LEASE_NOT_SENT ? FlightRecorder::NODE_UNAVAILABLE : FlightRecorder::NODE_ERROR)));
+            }
+            trace_span("batched", round_start_us, -1, nullptr, "nodes_ok", success_count);
+        }
+        for(size_t i = 0; i < group.nodes.size() && !batcher; i++){
+            int64_t node_start_us = get_steady_time_us();
+            int64_t left_us = budget_us - (node_start_us - round_start_us);
+            int64_t until_deadline_us = deadline_us - node_start_us;
+            if (left_us <= 0 || until_deadline_us <= 0 || success_count + static_cast<int>(group.nodes.size() - i) < group.quorum) {
+                stats_.skipped_nodes += group.nodes.size() - i;
+                trace_span("skipped", node_start_us, -1, left_us <= 0 ? "budget spent" : (until_deadline_us <= 0 ? "deadline passed" : "quorum unreachable"),
+                           "nodes", group.nodes.size() - i);
+                break;
+            }
+            left_us = std::min(left_us, until_deadline_us);
+            RedisNode &node = servers_[group.nodes[i]];
+            bool ready = prepare_node(node, left_us);
+            if(ready && lock_instance(node,lock,ttl_ms,lease_ms_[i])){
                 //单个节点加锁
                 success_count++;
             }
+            flight.set_node(i, !ready ? FlightRecorder::NODE_UNAVAILABLE
+                                      : (lease_ms_[i] == 0 ? FlightRecorder::NODE_OK : (lease_ms_[i] > 0 ? FlightRecorder::NODE_HELD : FlightRecorder::NODE_ERROR)));
+            if (tracing_) {
+                const char *outcome = !ready ? "unavailable" : (lease_ms_[i] == 0 ? "acquired" : (lease_ms_[i] > 0 ? "held" : "error"));
+                trace_span("node", node_start_us, static_cast<int>(group.nodes[i]), outcome, lease_ms_[i] > 0 ? "pttl_ms" : nullptr, lease_ms_[i]);
+            }
         }
 
-        // 步骤2：计算时间漂移和有效时间（防止时钟不一致导致锁提前失效）
-        // drift = TTL的1% + 2ms（经验值，补偿不同服务器的时钟差异）
-        int64_t drift = static_cast<int64_t>(ttl_ms * DEFAULT_LOCK_DRIFT_FACTOR) + 2;
+        // 步骤2：计算有效时间（扣除本轮耗时与时钟漂移，防止时钟不一致导致锁提前失效）
         int64_t elapsed_time = get_current_time_ms() - start_time; // 本次尝试耗时（毫秒）
         int64_t valid_time = ttl_ms - elapsed_time - drift; // 锁的剩余有效时间（需>0才安全）
 
         // 步骤3：验证是否满足多数派且有效时间充足
-        if(success_count >= quorum_ && valid_time > 0){
-            // 构造Lock对象，包含资源名、持有者ID、剩余有效时间
-            lock = Lock(resource, value, valid_time); 
+        if(success_count >= group.quorum && valid_time > 0){
+            // 资源名、持有者ID已写入lock，这里只需填写剩余有效时间
+            lock.valid_time_ = static_cast<int>(valid_time);
+            if (tracing_) {
+                trace_span("attempt", round_start_us, -1, "acquired", "attempt", retry.attempt + 1);
+                trace_end("lock", lock, trace_start, "acquired", "valid_ms", valid_time);
+            }
+            flight_record(flight, FlightRecorder::OP_LOCK, lock, group.nodes.size(), group.quorum, true, retry.attempt + 1, ttl_ms, valid_time, call_start_us);
+            stats_.lock_success++;
+            if (track_held_) {
+                held_.put(lock);  // 登记到持有表
+            }
+            if (ttl_model_) {
+                ttl_model_->on_acquired(lock.resource_.data(), lock.resource_.size(), get_current_time_ms());
+            }
+            if (profiler_) {
+                int64_t now = get_current_time_ms();
+                profiler_->record_acquire(lock.resource_.data(), lock.resource_.size(), retry.attempt + 1, retry.attempt, now - begin_time, true, now);
+            }
             return true; // 锁获取成功
         }
 
-        // 步骤4：获取失败时，释放所有已获取的锁（避免残留无效锁）
-        for (auto &ctx : servers_) {
-            unlock_instance(ctx, resource, value); // 单个节点解锁（即使该节点加锁失败也不影响）
+        // 步骤4：获取失败时，释放本轮加锁成功及结果未知的节点（避免残留无效锁），各节点的解锁命令流水线发送；
+        // 只有确定拒绝（返回持有者租约）和命令未发出的节点不需要释放
+        if (std::any_of(lease_ms_.begin(), lease_ms_.end(), lease_needs_release)) {
+            int64_t release_start_us = get_steady_time_us();
+            int released = unlock_nodes(group, lock, lease_ms_.data());
+            trace_span("release", release_start_us, -1, nullptr, "released", released);
         }
+        trace_span("attempt", round_start_us, -1, success_count >= group.quorum ? "expired" : "no quorum", "nodes_ok", success_count);
 
-        // 步骤5：重试前等待随机延迟（减少多客户端同时重试的竞争）
-        if(attempt > 0){
-            std::uniform_int_distribution<int> dist(0, retry_delay_ms_); // 0到retry_delay_ms_的随机数
-            // 随机睡眠，避免所有客户端同时重试（如默认200ms内随机延迟）
-            std::this_thread::sleep_for(std::chrono::milliseconds(dist(rd))); 
+        // 步骤5：重试前按策略等待（减少多客户端同时重试的竞争），等待会越过截止时间时放弃
+        // 多数派节点上的持有者租约何时到期：本轮拿到的节点已释放（为0），扣除本轮已过去的时间（含失败后的清理耗时）
+        int64_t now = get_current_time_ms();
+        retry_after_round(retry, lease_ms_.data(), lease_ms_.size(), group.quorum, now - start_time, now - begin_time);
+        if(attempt <= 0 || !wait_before_retry(retry, deadline)){
+            break;
         }
     }
+    if (tracing_) {
+        trace_end("lock", lock, trace_start, "gave up", "attempts", retry.attempt);
+    }
+    flight.holder_pttl_ms = static_cast<int32_t>(retry.holder_pttl_ms);
+    flight_record(flight, FlightRecorder::OP_LOCK, lock, group.nodes.size(), group.quorum, false, retry.attempt, ttl_ms, 0, call_start_us);
+    if (profiler_) {  // 放弃：每一轮都失败了
+        int64_t now = get_current_time_ms();
+        profiler_->record_acquire(lock.resource_.data(), lock.resource_.size(), retry.attempt, retry.attempt, now - begin_time, false, now);
+    }
     return false;
 }
 
 /*
-功能：在单个 Redis 节点上执行SET命令尝试加锁，使用NX和PX选项保证原子性。
+功能：按重试策略计算等待时间并睡眠。
+返回值：false 表示等待结束后再进行一轮（耗时按刚结束的一轮估计）会越过截止时间，不应再尝试，此时不睡眠。
+*/
+bool RedLock::wait_before_retry(RetryContext &ctx, std::chrono::steady_clock::time_point deadline){
+    int64_t remaining_ms = INT64_MAX;
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    }
+    int delay = retry_delay_ms(*retry_policy_, ctx, rng_, remaining_ms);
+    if (delay < 0) {
+        return false;
+    }
+    int64_t sleep_start_us = get_steady_time_us();
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    trace_span("sleep", sleep_start_us, -1, ctx.holder_pttl_ms >= 0 ? "holder lease" : nullptr, "delay_ms", delay);
+    ctx.prev_delay_ms = delay;
+    return true;
+}
+
+/*
+功能：在单个 Redis 节点上通过加锁脚本执行 SET NX PX 尝试加锁；失败时脚本在同一次往返中返回持有者的 PTTL。
 参数：
-context：Redis 连接上下文（已建立的连接）。
-resource、value、ttl_ms：同lock函数参数。
+node：Redis 节点（已建立的连接 + 命令编码缓冲区）。
+lock：待获取的锁（资源名 + 持有者ID）。
+ttl_ms：同lock函数参数。
+lease_ms：输出参数，加锁成功时为0；失败时为持有者租约的剩余时间，无法得知时为-1。
 */
-bool RedLock::lock_instance(redisContext* context, const std::string& resource, const std::string& value, int ttl_ms) {
+bool RedLock::lock_instance(RedisNode &node, const Lock &lock, int ttl_ms, int64_t &lease_ms) {
+    lease_ms = -1;
+    redisContext *context = node.ctx;
     if (!context || context->err != 0) {
-        std::cerr << "[Error] Connection error: " << (context ? context->errstr : "null") << std::endl;
         return false;
     }
 
-    const char* argv[] = {"SET", resource.c_str(), value.c_str(), "NX", "PX", std::to_string(ttl_ms).c_str()};
-    int argc = sizeof(argv) / sizeof(argv[0]);
+    // EVAL acquire_script() 1 resource value ttl_ms（ttl 在缓冲区中就地格式化）
+    node.cmd.eval(acquire_script(), lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size(), ttl_ms);
+    stats_.redis_ops++;
 
-    auto* reply = (redisReply*)redisCommandArgv(context, argc, argv, nullptr);
+    redisReply *reply = execute(node);
     if (!reply) {
-        std::cerr << "[Error] redisCommandArgv failed: " << context->errstr << std::endl;
-        return false;
+        return false;  // 超时或连接出错（节点已标记为失效，结果记录在飞行记录器中）
     }
 
-    // 打印reply->type的整数值（关键！）
-    std::cerr << "[Debug] reply->type = " << reply->type << std::endl;
-
     bool ok = false;
     switch (reply->type) {
         case REDIS_REPLY_STATUS:
-            ok = (reply->str && strcmp(reply->str, "ok") == 0);
-            std::cerr << "[Debug] Status: " << (reply->str ? reply->str : "null") << std::endl;
+            ok = (reply->str && strcmp(reply->str, "OK") == 0);  // Redis 对成功的 SET 返回状态 "OK"
             break;
-        case REDIS_REPLY_ERROR:
-            std::cerr << "[Debug] Error: " << (reply->str ? reply->str : "null") << std::endl;
+        case REDIS_REPLY_INTEGER:
+            // 锁已被占用：返回值为持有者的 PTTL（-1 表示没有过期时间，视为未知）
+            lease_ms = reply->integer >= 0 ? reply->integer : -1;
             break;
-        case REDIS_REPLY_NIL:
-            std::cerr << "[Debug] Lock already exists (NIL)" << std::endl;
-            break;
-        default:
-            std::cerr << "[Debug] Unexpected reply type: " << reply->type << std::endl;
+        default:  // 脚本出错等：按失败处理
             break;
     }
 
     freeReplyObject(reply);
+    if (ok) {
+        lease_ms = 0;
+    }
     return ok;
 }
 
 /*
-功能：在所有 Redis 节点上释放指定的锁，通过unlock_instance保证单个节点的原子性释放。
+功能：把节点缓冲区中已编码好的 RESP 命令追加到连接的输出缓冲，并同步等待回复。
+说明：等价于 redisCommandArgv，但跳过了 hiredis 对参数的格式化与拷贝，命令编码全程复用 node.cmd 的容量。
+*/
+redisReply *RedLock::execute(RedisNode &node) {
+    int64_t start_us = get_steady_time_us();
+    if (redisAppendFormattedCommand(node.ctx, node.cmd.data(), node.cmd.size()) != REDIS_OK) {
+        node_failed(node);
+        return nullptr;
+    }
+    void *reply = nullptr;
+    int rc = redisGetReply(node.ctx, &reply);
+    // 超时的命令也按已等待的时间计入分布：节点整体变慢时超时随之放宽，而不是一直超时
+    int64_t elapsed_us = get_steady_time_us() - start_us;
+    node.latency.add(elapsed_us);
+    latency_.add(elapsed_us);
+    if (rc != REDIS_OK) {
+        node_failed(node);  // 超时或连接出错：连接上可能还有迟到的回复，不能再用
+        return nullptr;
+    }
+    node.reconnect_delay_ms = 0;
+    return static_cast<redisReply *>(reply);
+}
+
+/*
+功能：节点的自适应命令超时（微秒）：最近命令往返延迟的分位数 × multiplier，限制在 [min_timeout_ms, 上限] 内。
+节点自身样本不足时（例如从一开始就无响应）改用所有节点的分布，也不足时直接使用上限。
+上限为节点的 command_timeout_ms（大于0时）或 max_timeout_ms。返回 0 表示不限制。
+*/
+int64_t RedLock::node_timeout_us(const RedisNode &node) const {
+    const CommandTimeoutOptions &opt = timeout_options_;
+    int64_t cap_us = static_cast<int64_t>(node.options.command_timeout_ms > 0 ? node.options.command_timeout_ms
+                                                                              : (opt.adaptive ? opt.max_timeout_ms : 0)) * 1000;
+    uint32_t min_samples = static_cast<uint32_t>(opt.min_samples);
+    const LogHistogram *hist = node.latency.total() >= min_samples ? &node.latency : latency_.total() >= min_samples ? &latency_ : nullptr;
+    if (!opt.adaptive || !hist) {
+        return std::max<int64_t>(0, cap_us);
+    }
+    int64_t timeout_us = static_cast<int64_t>(std::ceil(hist->quantile(opt.quantile) * opt.multiplier));
+    timeout_us = std::max<int64_t>(timeout_us, static_cast<int64_t>(opt.min_timeout_ms) * 1000);
+    return cap_us > 0 ? std::min(timeout_us, cap_us) : timeout_us;
+}
+
+/*
+功能：第 index 个节点当前的命令超时（毫秒，向上取整，0 表示不限制）。
+*/
+int RedLock::command_timeout_ms(size_t index) const {
+    if (index >= servers_.size()) {
+        return 0;
+    }
+    return static_cast<int>((node_timeout_us(servers_[index]) + 999) / 1000);
+}
+
+/*
+功能：发送命令前准备节点。
+1. 连接已失效（超时/出错）时，到了重连时间才重连：连接超时不超过本次的命令超时，成功后替换旧连接；
+2. 命令超时取 min(自适应超时, budget_us)，按毫秒向上取整，只有变化时才重新设置（每次设置是两次 setsockopt）。
+返回值：false 表示节点暂不可用（等待重连或重连失败），本轮跳过该节点。
+*/
+bool RedLock::prepare_node(RedisNode &node, int64_t budget_us) {
+    int64_t timeout_us = node_timeout_us(node);
+    if (budget_us > 0 && (timeout_us == 0 || budget_us < timeout_us)) {
+        timeout_us = budget_us;
+    }
+    timeout_us = (timeout_us + 999) / 1000 * 1000;
+
+    if (!node.ctx || node.ctx->err != 0) {
+        if (get_steady_time_ms() < node.reconnect_at_ms) {
+            return false;
+        }
+        ServerOptions options = node.options;
+        if (timeout_us > 0) {
+            options.connect_timeout_ms = std::min<int64_t>(options.connect_timeout_ms, timeout_us / 1000);
+        }
+        redisContext *context = connect_redis(node.host, node.port, options);
+        if (!context || context->err) {
+            if (context) {
+                redisFree(context);
+            }
+            node_failed(node);
+            return false;
+        }
+        if (node.ctx) {
+            redisFree(node.ctx);
+        }
+        node.ctx = context;
+        node.timeout_us = static_cast<int64_t>(options.command_timeout_ms) * 1000;  // connect_redis 按选项设置过
+        stats_.reconnects++;
+    }
+
+    if (timeout_us != node.timeout_us) {
+        if (redisSetTimeout(node.ctx, us_to_timeval(timeout_us)) != REDIS_OK) {
+            node_failed(node);
+            return false;
+        }
+        node.timeout_us = timeout_us;
+    }
+    return true;
+}
+
+/*
+功能：命令超时或连接出错后调用。把连接标记为失效（连接上可能还有迟到的回复，继续使用会读错），
+在退避间隔之后由 prepare_node 重连；连续失败时间隔加倍，命令成功后恢复初始值。
+*/
+void RedLock::node_failed(RedisNode &node) {
+    stats_.node_errors++;
+    if (node.ctx && node.ctx->err == 0) {
+        node.ctx->err = REDIS_ERR_OTHER;
+        snprintf(node.ctx->errstr, sizeof(node.ctx->errstr), "command failed");
+    }
+    int delay = node.reconnect_delay_ms > 0 ? node.reconnect_delay_ms : timeout_options_.reconnect_delay_ms;
+    node.reconnect_at_ms = get_steady_time_ms() + delay;
+    node.reconnect_delay_ms = std::min(delay * 2, std::max(delay, timeout_options_.max_reconnect_delay_ms));
+}
+
+/*
+功能：填写一次调用的结果并写入飞行记录器（无等待，几十纳秒）。各节点的结果由调用方在 e 中填写。
+*/
+void RedLock::flight_record(FlightRecorder::Entry &e, FlightRecorder::Op op, const Lock &lock, size_t nodes, int quorum, bool ok, int attempts, int ttl_ms, int64_t valid_ms, int64_t start_us) {
+    if (!recorder_) {
+        return;
+    }
+    e.op = op;
+    e.ok = ok;
+    e.nodes = static_cast<uint8_t>(std::min<size_t>(nodes, 255));
+    e.quorum = static_cast<uint16_t>(quorum);
+    e.attempts = static_cast<uint8_t>(std::min(std::max(attempts, 0), 255));
+    e.ttl_ms = ttl_ms;
+    e.valid_ms = static_cast<int32_t>(valid_ms);
+    e.end_us = get_steady_time_us();
+    e.dur_us = e.end_us - start_us;
+    e.set_resource(lock.resource_.data(), lock.resource_.size());
+    recorder_->record(e);
+}
+
+/*
+功能：调用开始时按追踪器的采样决定是否记录本次调用。未设置追踪器或不记录时，之后的 trace_span / trace_end 都直接返回。
+*/
+int64_t RedLock::trace_begin() {
+    tracing_ = tracer_ && tracer_->begin(trace_sampled_);
+    return tracing_ ? get_steady_time_us() : 0;
+}
+
+void RedLock::trace_span(const char *name, int64_t start_us, int node, const char *outcome, const char *value_name, int64_t value) {
+    if (!tracing_) {
+        return;
+    }
+    trace_.emplace_back();
+    LockTracer::Event &e = trace_.back();
+    e.name = name;
+    e.outcome = outcome;
+    e.ts_us = start_us;
+    e.dur_us = get_steady_time_us() - start_us;
+    e.node = node;
+    e.value_name = value_name;
+    e.value = value;
+}
+
+/*
+功能：记录最外层的调用事件（带资源名），采样命中或耗时超过 slow_ms 时由追踪器保留本次调用的全部事件。
+*/
+void RedLock::trace_end(const char *name, const Lock &lock, int64_t start_us, const char *outcome, const char *value_name, int64_t value) {
+    trace_span(name, start_us, -1, outcome, value_name, value);
+    trace_.back().resource.assign(lock.resource_.data(), lock.resource_.size());
+    tracing_ = false;
+    tracer_->commit(trace_, trace_sampled_, trace_.back().dur_us);
+}
+
+/*
+功能：在资源所属组的所有 Redis 节点上释放指定的锁（各节点的解锁脚本流水线发送）。
 参数：lock为之前获取的锁对象，包含资源名和持有者 ID。
 */
 bool RedLock::unlock(const Lock &lock) {
     if (servers_.empty()) { // 无服务器时直接返回
         return false;
     }
-    // 遍历所有服务器节点，释放锁
-    for (auto &ctx : servers_) {
-        unlock_instance(ctx, lock.resource_, lock.value_); // 单个节点解锁
+    if (track_held_) {
+        held_.erase(lock);  // 从持有表注销
+    }
+    if (ttl_model_) {
+        ttl_model_->on_released(lock.resource_.data(), lock.resource_.size(), get_current_time_ms());
+    }
+    if (profiler_) {
+        profiler_->record_release(lock.resource_.data(), lock.resource_.size(), get_current_time_ms());
     }
+    int64_t trace_start = trace_begin();
+    int64_t call_start_us = get_steady_time_us();
+    const NodeGroup &group = groups_[group_of(lock.resource_.data(), lock.resource_.size())];
+    FlightRecorder::Entry flight;
+    int released = unlock_nodes(group, lock, nullptr, recorder_ ? &flight : nullptr);
+    if (tracing_) {
+        trace_end("unlock", lock, trace_start, nullptr, "released", released);
+    }
+    flight_record(flight, FlightRecorder::OP_UNLOCK, lock, group.nodes.size(), group.quorum, released >= group.quorum, 1, 0, 0, call_start_us);
     return true; // 无论是否全部成功，均返回true（不保证原子性，仅尽力释放）
 }
 
+/*
+功能：异步释放锁。从持有表注销后把请求放入发送器的队列立即返回，不做任何网络 I/O；
+后台线程把来自各线程的解锁请求按节点合并成批，流水线发送。
+参数：
+lock：之前获取的锁对象。
+done：可选的完成回调，在发送线程中以 ok=true/false 报告是否在多数派节点上确认删除
+     （false 通常表示锁已过期被他人获取，或节点不可达）。
+说明：未调用 set_unlock_sender 时首次调用会创建本实例专用的发送器。
+*/
+bool RedLock::unlock_async(const Lock &lock, UnlockSender::Callback done) {
+    if (servers_.empty()) { // 无服务器时直接返回
+        return false;
+    }
+    const NodeGroup &group = groups_[group_of(lock.resource_.data(), lock.resource_.size())];
+    std::shared_ptr<UnlockSender> sender;
+    int sender_group;
+    {
+        std::lock_guard<std::mutex> guard(sender_mu_);
+        if (!sender_) {
+            sender_ = std::make_shared<UnlockSender>(RELEASE_BATCH);
+        }
+        bind_sender();
+        sender = sender_;
+        sender_group = group.sender_group;
+    }
+    if (track_held_) {
+        held_.erase(lock);  // 从持有表注销
+    }
+    if (ttl_model_) {
+        ttl_model_->on_released(lock.resource_.data(), lock.resource_.size(), get_current_time_ms());
+    }
+    if (profiler_) {
+        profiler_->record_release(lock.resource_.data(), lock.resource_.size(), get_current_time_ms());
+    }
+    sender->submit(sender_group, lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size(), std::move(done));
+    return true;
+}
+
+/*
+功能：设置异步解锁发送器。同一个发送器可以被多个 RedLock 实例（通常每个线程一个）共享，
+它对相同地址的节点只建立一个连接，各线程的解锁请求会合并成批发送。
+*/
+void RedLock::set_unlock_sender(std::shared_ptr<UnlockSender> sender) {
+    std::lock_guard<std::mutex> guard(sender_mu_);
+    sender_ = std::move(sender);
+    for (auto &node : servers_) {
+        node.sender_id = -1;
+    }
+    for (auto &group : groups_) {
+        group.sender_group = -1;
+    }
+    if (sender_) {
+        bind_sender();
+    }
+}
+
+/*
+功能：把尚未注册的节点和组注册到发送器（调用方持有 sender_mu_）。
+暂时连接不上的节点也会登记，由发送器的后台线程按退避间隔重连。
+*/
+void RedLock::bind_sender() {
+    for (auto &node : servers_) {
+        if (node.sender_id == -1) {
+            std::string err;
+            node.sender_id = sender_->add_node(node.host, node.port, node.options, err);
+        }
+    }
+    for (auto &group : groups_) {
+        if (group.sender_group != -1) {
+            continue;
+        }
+        std::vector<int> ids;
+        for (size_t idx : group.nodes) {
+            if (servers_[idx].sender_id >= 0) {
+                ids.push_back(servers_[idx].sender_id);
+            }
+        }
+        group.sender_group = sender_->add_group(ids, group.quorum);
+    }
+}
+
+/*
+功能：设置加锁 I/O 线程。同一个 LockBatcher 通常由各线程的 RedLock 实例共享：它对相同地址的节点只建立一个连接，
+并发的加锁/续锁/解锁请求在每个节点上合并为一次流水线往返。多数派判断、有效时间、重试与退避仍在调用线程中进行。
+说明：启用后每轮的命令超时由 LockBatcher 的连接决定（不再按本轮剩余的有效期预算收紧），continue_many / release_all
+     仍使用本实例自己的连接。
+*/
+void RedLock::set_batcher(std::shared_ptr<LockBatcher> batcher) {
+    batcher_ = std::move(batcher);
+    for (auto &node : servers_) {
+        node.batcher_id = -1;
+    }
+    for (auto &group : groups_) {
+        group.batcher_group = -1;
+    }
+    if (batcher_) {
+        bind_batcher();
+    }
+}
+
+/*
+功能：把尚未注册的节点和组注册到加锁 I/O 线程。暂时连接不上的节点也会登记，由 I/O 线程按退避间隔重连。
+*/
+void RedLock::bind_batcher() {
+    for (auto &node : servers_) {
+        if (node.batcher_id == -1) {
+            std::string err;
+            node.batcher_id = batcher_->add_node(node.host, node.port, node.options, err);
+        }
+    }
+    for (auto &group : groups_) {
+        if (group.batcher_group != -1) {
+            continue;
+        }
+        std::vector<int> ids;
+        for (size_t idx : group.nodes) {
+            ids.push_back(servers_[idx].batcher_id);
+        }
+        group.batcher_group = batcher_->add_group(ids);
+    }
+}
+
 /*
 功能：通过 Lua 脚本原子化执行 “检查锁持有者 + 删除锁” 操作，确保仅删除当前客户端的锁。
 Lua 脚本逻辑：
 若GET resource等于value，则DEL resource并返回 1；
 否则返回 0（不删除）。
+参数：
+group：资源所属的组。
+lease_ms：为空时在组内所有节点上解锁；否则只在 lease_needs_release(lease_ms[i])（本轮加锁成功或结果未知）的第 i 个节点上解锁。
+流程：先把解锁命令追加到每个节点的输出缓冲，再统一写出，最后逐个读取回复，
+总耗时约为一次往返，而不是每个节点一次往返。返回成功删除锁的节点数。
 */
-bool RedLock::unlock_instance(redisContext* context, const std::string& resource, const std::string& value) {
-    // Lua脚本参数：
-    // KEYS[1] = resource，ARGV[1] = value
-    const char* argv[] = {
-        "EVAL", UNLOCK_SCRIPT.c_str(), "1", resource.c_str(), value.c_str()
-    };
-    // 执行Lua脚本，原子化检查并删除锁（避免误删其他客户端的锁）
-    redisReply* reply = (redisReply*)redisCommandArgv(context, 
-        sizeof(argv) / sizeof(argv[0]), argv, nullptr); // 参数个数自动计算
-    
-    if (!reply) { // 命令执行失败
-        return false;
+int RedLock::unlock_nodes(const NodeGroup &group, const Lock &lock, const int64_t *lease_ms, FlightRecorder::Entry *flight) {
+    if (batcher_) { // 交给加锁 I/O 线程，与其他线程的请求合并发送
+        if (group.batcher_group == -1) {
+            bind_batcher();
+        }
+        stats_.redis_ops += group.nodes.size();
+        return batcher_->release(unlock_script(), group.batcher_group, lock, lease_ms);
     }
-    
-    // 检查返回值是否为1（表示成功删除锁）
-    bool ok = (reply->type == REDIS_REPLY_INTEGER && reply->integer == 1);
-    freeReplyObject(reply);
-    return ok;
+    // 步骤1：编码并追加到各节点的输出缓冲
+    pending_.assign(group.nodes.size(), 0);
+    for (size_t i = 0; i < group.nodes.size(); i++) {
+        RedisNode &node = servers_[group.nodes[i]];
+        if ((lease_ms && !lease_needs_release(lease_ms[i])) || !prepare_node(node, 0)) {
+            if (flight && !lease_ms) {
+                flight->set_node(i, FlightRecorder::NODE_UNAVAILABLE);
+            }
+            continue;
+        }
+        // Lua脚本参数：
+        // KEYS[1] = resource，ARGV[1] = value
+        node.cmd.eval(unlock_script(), lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size());
+        stats_.redis_ops++;
+        pending_[i] = redisAppendFormattedCommand(node.ctx, node.cmd.data(), node.cmd.size()) == REDIS_OK;
+        if (!pending_[i]) {
+            node_failed(node);
+        }
+    }
+
+    // 步骤2：写出所有节点的输出缓冲（各节点并行执行脚本）
+    for (size_t i = 0; i < group.nodes.size(); i++) {
+        int written = 0;
+        while (pending_[i] && !written) {
+            if (redisBufferWrite(servers_[group.nodes[i]].ctx, &written) != REDIS_OK) {
+                node_failed(servers_[group.nodes[i]]);
+                pending_[i] = 0;
+            }
+        }
+    }
+
+    // 步骤3：逐个读取回复，返回值为1表示成功删除锁
+    int released = 0;
+    for (size_t i = 0; i < group.nodes.size(); i++) {
+        void *reply = nullptr;
+        if (!pending_[i]) {
+            continue;
+        }
+        if (redisGetReply(servers_[group.nodes[i]].ctx, &reply) != REDIS_OK) {
+            node_failed(servers_[group.nodes[i]]);
+            if (flight) {
+                flight->set_node(i, FlightRecorder::NODE_ERROR);
+            }
+            continue;
+        }
+        redisReply *r = static_cast<redisReply *>(reply);
+        bool ok = r && r->type == REDIS_REPLY_INTEGER && r->integer == 1;
+        if (ok) {
+            released++;
+        }
+        if (flight) {
+            flight->set_node(i, ok ? FlightRecorder::NODE_OK : FlightRecorder::NODE_REJECTED);
+        }
+        freeReplyObject(reply);
+    }
+    return released;
 }
 
 /*
 功能：延长分布式锁的有效时间，逻辑与lock类似，但调用续锁的 Lua 脚本。
 参数：
 resource、ttl_ms：同lock，ttl_ms为新的有效时间。
-lock：输入时提供锁的持有者 ID，输出时更新剩余有效时间。
+lock：输入时提供锁的持有者 ID，输出时更新资源名和剩余有效时间。
 */
 bool RedLock::continue_lock(const std::string& resource, int ttl_ms, Lock& lock) {
     if (servers_.empty()) { // 无服务器时失败
         return false;
     }
-    int attempts = retry_count_ + 1; // 总尝试次数（同lock函数逻辑）
+    lock.resource_.assign(resource.data(), resource.size()); // 以传入的资源名为准（内联拷贝）
+    // 尝试次数与截止时间（同lock函数逻辑）
+    if (acquire_timeout_ms_ > 0) {
+        return extend(lock, ttl_ms, std::numeric_limits<int>::max(), std::chrono::steady_clock::now() + std::chrono::milliseconds(acquire_timeout_ms_));
+    }
+    return extend(lock, ttl_ms, retry_count_ + 1, std::chrono::steady_clock::time_point::max());
+}
+
+/*
+功能：continue_lock 的实际实现，最多尝试 max_attempts 轮，且不会在 deadline 之后开始新的一轮。
+*/
+bool RedLock::extend(Lock &lock, int ttl_ms, int max_attempts, std::chrono::steady_clock::time_point deadline) {
+    if (servers_.empty()) {
+        return false;
+    }
+    ttl_ms = resolve_ttl(lock.resource_.data(), lock.resource_.size(), ttl_ms);
+    if (ttl_ms <= 0) {
+        return false;
+    }
+    const NodeGroup &group = groups_[group_of(lock.resource_.data(), lock.resource_.size())];  // 资源所属的组
+    int64_t trace_start = trace_begin();
+    int64_t call_start_us = get_steady_time_us();
+    FlightRecorder::Entry flight;  // 飞行记录（各节点为最后一轮的结果，交给加锁 I/O 线程时不记录）
+    int attempts = max_attempts;
+    RetryContext retry;
+    int64_t begin_time = get_current_time_ms();
     while (attempts-- > 0) {
         
         int64_t start_time = get_current_time_ms(); // 记录开始时间
         int success_count = 0; // 成功续锁的节点数
         
-        // 步骤1：在所有节点上尝试续锁
-        for (auto &ctx : servers_) {
-            if (continue_lock_instance(ctx, resource, lock.value_, ttl_ms)) { // 单个节点续锁
+        int64_t drift = static_cast<int64_t>(ttl_ms * DEFAULT_LOCK_DRIFT_FACTOR) + 2;
+
+        // 步骤1：在组内所有节点上尝试续锁（有效期预算与跳过规则同lock函数）
+        int64_t round_start_us = get_steady_time_us();
+        int64_t budget_us = (ttl_ms - drift) * 1000;
+        flight.node_results = 0;
+        if (batcher_) {
+            if (group.batcher_group == -1) {
+                bind_batcher();
+            }
+            success_count = batcher_->extend(extend_script(), group.batcher_group, lock, ttl_ms);
+            stats_.redis_ops += group.nodes.size();
+            trace_span("batched", round_start_us, -1, nullptr, "nodes_ok", success_count);
+        }
+        for (size_t i = 0; i < group.nodes.size() && !batcher_; i++) {
+            int64_t node_start_us = get_steady_time_us();
+            int64_t left_us = budget_us - (node_start_us - round_start_us);
+            if (left_us <= 0 || success_count + static_cast<int>(group.nodes.size() - i) < group.quorum) {
+                stats_.skipped_nodes += group.nodes.size() - i;
+                trace_span("skipped", node_start_us, -1, left_us <= 0 ? "budget spent" : "quorum unreachable", "nodes", group.nodes.size() - i);
+                break;
+            }
+            RedisNode &node = servers_[group.nodes[i]];
+            bool ready = prepare_node(node, left_us);
+            bool ok = ready && continue_lock_instance(node, lock, ttl_ms);  // 单个节点续锁
+            if (ok) {
                 success_count++;
             }
+            flight.set_node(i, !ready ? FlightRecorder::NODE_UNAVAILABLE
+                                      : (ok ? FlightRecorder::NODE_OK : (node.ctx && node.ctx->err == 0 ? FlightRecorder::NODE_REJECTED : FlightRecorder::NODE_ERROR)));
+            trace_span("node", node_start_us, static_cast<int>(group.nodes[i]), !ready ? "unavailable" : (ok ? "extended" : "rejected"), nullptr, 0);
         }
         
-        // 步骤2：计算时间漂移和新有效时间（逻辑同lock函数）
-        int64_t drift = static_cast<int64_t>(ttl_ms * DEFAULT_LOCK_DRIFT_FACTOR) + 2;
+        // 步骤2：计算新有效时间（逻辑同lock函数）
         int64_t elapsed_time = get_current_time_ms() - start_time;
         int64_t valid_time = ttl_ms - elapsed_time - drift;
         
         // 步骤3：验证多数派和有效时间
-        if (success_count >= quorum_ && valid_time > 0) {
-            lock.valid_time_ = valid_time; // 更新锁的剩余有效时间
+        if (success_count >= group.quorum && valid_time > 0) {
+            lock.valid_time_ = static_cast<int>(valid_time); // 更新锁的剩余有效时间
+            if (track_held_) {
+                held_.put(lock);  // 更新持有表中的记录
+            }
+            if (tracing_) {
+                trace_span("attempt", round_start_us, -1, "extended", "attempt", retry.attempt + 1);
+                trace_end("extend", lock, trace_start, "extended", "valid_ms", valid_time);
+            }
+            flight_record(flight, FlightRecorder::OP_EXTEND, lock, group.nodes.size(), group.quorum, true, retry.attempt + 1, ttl_ms, valid_time, call_start_us);
             return true; // 续锁成功
         }
+        trace_span("attempt", round_start_us, -1, "no quorum", "nodes_ok", success_count);
         
-        // 步骤4：重试前随机延迟（不释放锁，仅等待后重试）
-        if (attempts > 0) {
-            std::uniform_int_distribution<int> dist(0, retry_delay_ms_);
-            std::this_thread::sleep_for(std::chrono::milliseconds(dist(rd)));
+        // 步骤4：重试前按策略等待（不释放锁，仅等待后重试）
+        retry.attempt++;
+        retry.round_ms = static_cast<int>(elapsed_time);
+        retry.elapsed_ms = get_current_time_ms() - begin_time;
+        if (attempts <= 0 || !wait_before_retry(retry, deadline)) {
+            break;
         }
     }
+    if (tracing_) {
+        trace_end("extend", lock, trace_start, "gave up", "attempts", retry.attempt);
+    }
+    flight_record(flight, FlightRecorder::OP_EXTEND, lock, group.nodes.size(), group.quorum, false, retry.attempt, ttl_ms, 0, call_start_us);
     return false; // 所有尝试失败
 }
 
+/*
+功能：批量续锁。N 把锁的续期不再是 N × 节点数次往返，而是每个节点一次往返：
+1. 按 RELEASE_BATCH 把锁分批，每个节点把每批中属于本组的锁编码为一条多 key 续期脚本（ARGV[1] 为 TTL，
+   其后依次为各 key 的持有者标识），该节点的所有脚本一次写出；
+2. 所有节点写出后再逐个读取回复（各节点并行执行），回复为按 key 顺序的 1/0 数组；
+3. 每把锁统计续期成功的节点数，达到所在组的多数派且有效时间（扣除本次耗时与时钟漂移）为正时视为成功。
+说明：只尝试一轮、不重试；失败的锁可以再用 continue_lock 单独续期。命令超时不超过有效期预算（同 lock）。
+*/
+size_t RedLock::continue_many(std::vector<Lock> &locks, int ttl_ms, std::vector<bool> *renewed) {
+    if (renewed) {
+        renewed->assign(locks.size(), false);
+    }
+    if (servers_.empty() || locks.empty() || ttl_ms <= 0) {
+        return 0;
+    }
+    int64_t start_time = get_current_time_ms();
+    int64_t call_start_us = get_steady_time_us();
+    int64_t drift = static_cast<int64_t>(ttl_ms * DEFAULT_LOCK_DRIFT_FACTOR) + 2;
+    std::vector<size_t> lock_group(locks.size());
+    for (size_t k = 0; k < locks.size(); k++) {
+        lock_group[k] = group_of(locks[k].resource_.data(), locks[k].resource_.size());
+    }
+    std::vector<int> acks(locks.size(), 0);
+
+    // 步骤1：编码并写出各节点的全部批次
+    std::vector<size_t> batches(servers_.size(), 0);  // 每个节点发送的脚本条数
+    for (size_t i = 0; i < servers_.size(); i++) {
+        RedisNode &node = servers_[i];
+        node.cmd.clear();
+        for (size_t done = 0; done < locks.size(); done += RELEASE_BATCH) {
+            size_t end = std::min(locks.size(), done + RELEASE_BATCH);
+            size_t keys = 0;
+            for (size_t k = done; k < end; k++) {
+                keys += lock_group[k] == node.group;
+            }
+            if (keys == 0) {
+                continue;
+            }
+            node.cmd.begin(static_cast<int>(4 + 2 * keys));
+            node.cmd.arg("EVAL", 4);
+            node.cmd.arg(extend_many_script());
+            node.cmd.arg(static_cast<int64_t>(keys));
+            for (size_t k = done; k < end; k++) {
+                if (lock_group[k] == node.group) {
+                    node.cmd.arg(locks[k].resource_.data(), locks[k].resource_.size());
+                }
+            }
+            node.cmd.arg(static_cast<int64_t>(ttl_ms));
+            for (size_t k = done; k < end; k++) {
+                if (lock_group[k] == node.group) {
+                    node.cmd.arg(locks[k].value_.data(), locks[k].value_.size());
+                }
+            }
+            batches[i]++;
+        }
+        if (batches[i] == 0 || !prepare_node(node, (ttl_ms - drift) * 1000)) {
+            batches[i] = 0;
+            continue;
+        }
+        if (redisAppendFormattedCommand(node.ctx, node.cmd.data(), node.cmd.size()) != REDIS_OK) {
+            node_failed(node);
+            batches[i] = 0;
+            continue;
+        }
+        stats_.redis_ops += batches[i];
+        int written = 0;
+        while (!written) {
+            if (redisBufferWrite(node.ctx, &written) != REDIS_OK) {
+                node_failed(node);
+                batches[i] = 0;
+                break;
+            }
+        }
+    }
+
+    // 步骤2：逐个节点读取回复，按批次顺序把 1/0 对应回本组的锁
+    for (size_t i = 0; i < servers_.size(); i++) {
+        RedisNode &node = servers_[i];
+        size_t sent = 0;
+        for (size_t done = 0; done < locks.size() && sent < batches[i]; done += RELEASE_BATCH) {
+            size_t end = std::min(locks.size(), done + RELEASE_BATCH);
+            size_t keys = 0;
+            for (size_t k = done; k < end; k++) {
+                keys += lock_group[k] == node.group;
+            }
+            if (keys == 0) {
+                continue;  // 与步骤1相同，本批没有属于本组的锁时没有发送
+            }
+            sent++;
+            void *reply = nullptr;
+            if (redisGetReply(node.ctx, &reply) != REDIS_OK) {
+                node_failed(node);
+                break;
+            }
+            redisReply *r = static_cast<redisReply *>(reply);
+            size_t idx = 0;
+            for (size_t k = done; k < end; k++) {
+                if (lock_group[k] != node.group) {
+                    continue;
+                }
+                if (r && r->type == REDIS_REPLY_ARRAY && idx < r->elements &&
+                    r->element[idx]->type == REDIS_REPLY_INTEGER && r->element[idx]->integer == 1) {
+                    acks[k]++;
+                }
+                idx++;
+            }
+            freeReplyObject(reply);
+        }
+    }
+
+    // 步骤3：按锁判断多数派与剩余有效时间
+    int64_t valid_time = ttl_ms - (get_current_time_ms() - start_time) - drift;
+    size_t count = 0;
+    for (size_t k = 0; k < locks.size(); k++) {
+        bool ok = valid_time > 0 && acks[k] >= groups_[lock_group[k]].quorum;
+        if (ok) {
+            locks[k].valid_time_ = static_cast<int>(valid_time);
+            if (track_held_) {
+                held_.put(locks[k]);
+            }
+            if (renewed) {
+                (*renewed)[k] = true;
+            }
+            count++;
+        }
+        if (recorder_) {
+            FlightRecorder::Entry flight;
+            flight_record(flight, FlightRecorder::OP_EXTEND_MANY, locks[k], 0, groups_[lock_group[k]].quorum, ok, 1, ttl_ms, ok ? valid_time : 0, call_start_us);
+        }
+    }
+    return count;
+}
+
+/*
+功能：持锁执行业务函数，替代手写的“加锁 → 执行 → 续锁 → 解锁”流程。
+流程：
+1. 按 lock 的规则获取锁，失败时返回 NotAcquired，不调用 fn；
+2. 后台续锁线程在每段有效时间过半时续锁一次（续锁的重试不会越过令牌的最迟停止时间）；
+   续锁失败立即取消令牌，续锁成功则后移令牌的最迟停止时间；
+3. 令牌的最迟停止时间为有效期结束前 ttl_ms * RUN_LOCKED_CANCEL_FACTOR，
+   即使续锁线程卡在无响应的节点上，fn 也能在锁失效之前看到取消；
+4. fn 返回或抛出异常后停止续锁线程，并通过 unlock_async 释放锁（异常会继续向外抛出）。
+返回值：fn 执行期间令牌是否被取消（Cancelled 表示期间可能已失去互斥保护）。
+*/
+LockRunStatus RedLock::run_locked(const std::string &resource, int ttl_ms, const std::function<void(const CancelToken &)> &fn) {
+    typedef std::chrono::steady_clock Clock;
+    ttl_ms = resolve_ttl(resource.data(), resource.size(), ttl_ms);  // 自适应 TTL 只在开始时选择一次，续锁沿用
+    auto margin = std::chrono::milliseconds(static_cast<int64_t>(ttl_ms * RUN_LOCKED_CANCEL_FACTOR));
+    Lock held;
+    if (!lock(resource, ttl_ms, held)) {
+        return LockRunStatus::NotAcquired;
+    }
+    // valid_time_ 已扣除成功那一轮的耗时与时钟漂移，表示从返回时刻起的剩余有效时间
+    Clock::time_point lease_start = Clock::now();
+    CancelToken token(lease_start + std::chrono::milliseconds(held.valid_time_) - margin);
+
+    std::mutex mu;
+    std::condition_variable cv;
+    bool done = false;
+    std::thread renewer([&] {
+        std::unique_lock<std::mutex> guard(mu);
+        while (!done) {
+            auto renew_at = lease_start + std::chrono::milliseconds(held.valid_time_ / 2);
+            if (cv.wait_until(guard, renew_at, [&] { return done; })) {
+                break;
+            }
+            guard.unlock();
+            bool ok = extend(held, ttl_ms, std::numeric_limits<int>::max(), token.deadline());
+            guard.lock();
+            if (!ok) {
+                token.cancel();
+                break;
+            }
+            lease_start = Clock::now();
+            token.extend(lease_start + std::chrono::milliseconds(held.valid_time_) - margin);
+        }
+    });
+    auto stop = [&] {
+        {
+            std::lock_guard<std::mutex> guard(mu);
+            done = true;
+        }
+        cv.notify_all();
+        renewer.join();
+    };
+
+    try {
+        fn(token);
+    } catch (...) {
+        stop();
+        unlock_async(held);
+        throw;
+    }
+    stop();
+    bool cancelled = token.cancelled();
+    unlock_async(held);
+    return cancelled ? LockRunStatus::Cancelled : LockRunStatus::Completed;
+}
+
 /*
 功能：通过 Lua 脚本原子化执行 “检查锁持有者 + 延长过期时间” 操作。
 */
-bool RedLock::continue_lock_instance(redisContext* context, const std::string& resource, const std::string& value, int ttl_ms) {
-    std::string ttl_ms_str = std::to_string(ttl_ms); // 将ttl转为字符串（Lua脚本需要）
+bool RedLock::continue_lock_instance(RedisNode &node, const Lock &lock, int ttl_ms) {
+    if (!node.ctx || node.ctx->err != 0) {
+        return false;
+    }
     // Lua脚本参数：
-    // KEYS[1] = resource，ARGV[1] = value，ARGV[2] = ttl_ms
-    const char* argv[] = {
-        "EVAL", CONTINUE_LOCK_SCRIPT.c_str(), "1", resource.c_str(), value.c_str(), ttl_ms_str.c_str()
-    };
+    // KEYS[1] = resource，ARGV[1] = value，ARGV[2] = ttl_ms（就地格式化）
+    node.cmd.eval(extend_script(), lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size(), ttl_ms);
+    stats_.redis_ops++;
     // 执行Lua脚本，原子化检查并续期锁
-    redisReply* reply = (redisReply*)redisCommandArgv(context, 
-        sizeof(argv) / sizeof(argv[0]), argv, nullptr);
+    redisReply* reply = execute(node);
     
     if (!reply) { // 命令执行失败
         return false;
@@ -294,4 +1161,146 @@ bool RedLock::set_retry_count(int count) {
     }
     retry_count_ = count; // 更新成员变量
     return true;
-}
\ No newline at end of file
+}
+
+/*
+功能：设置重试前随机等待的上限（毫秒），等价于使用 [0, delay_ms] 的均匀抖动策略。
+参数：delay_ms为新的重试间隔上限（≥0）。
+已通过 set_retry_policy 设置自定义策略时只记录上限，不替换自定义策略（传空策略恢复默认时才生效）。
+*/
+bool RedLock::set_retry_delay(int delay_ms) {
+    if (delay_ms < 0) { // 间隔不能为负数
+        return false;
+    }
+    retry_delay_ms_ = delay_ms;
+    if (!custom_retry_policy_) {
+        retry_policy_ = default_retry_policy(delay_ms);
+    }
+    return true;
+}
+
+/*
+功能：设置重试/退避策略（如 ExponentialBackoffPolicy、DecorrelatedJitterPolicy、FixedRatePolicy）。
+参数：policy 为空时恢复默认策略。
+*/
+void RedLock::set_retry_policy(std::shared_ptr<const RetryPolicy> policy) {
+    retry_policy_ = policy ? policy : default_retry_policy(retry_delay_ms_);
+    custom_retry_policy_ = policy != nullptr;
+}
+
+/*
+功能：设置获取锁/续锁的总等待时间（毫秒）。大于0时以截止时间代替重试次数作为上限；0 表示恢复按次数重试。
+*/
+bool RedLock::set_acquire_timeout(int timeout_ms) {
+    if (timeout_ms < 0) {
+        return false;
+    }
+    acquire_timeout_ms_ = timeout_ms;
+    return true;
+}
+
+/*
+功能：设置锁令牌的格式（十六进制或紧凑的二进制），只影响之后获取的锁。
+*/
+void RedLock::set_token_format(TokenFormat format) {
+    token_format_ = format;
+}
+
+/*
+功能：批量释放当前客户端持有的所有锁，用于进程优雅退出（避免其他客户端等待整个TTL）。
+做法：
+1. 从登记表取出所有锁，按 RELEASE_BATCH 个一组；
+2. 每组编码为一条多 key 解锁脚本，先写入所有节点，再逐个读取回复，
+   同一组在各节点上并行执行，每个节点每组只需一次往返；
+3. 每组发送前检查 deadline，超时则停止，剩余的锁保留在登记表中；
+4. 节点回复了脚本结果即确认本批属于该组的 key 在该节点上已不再由本客户端持有（已删除或早已过期/易主），
+   只有在所属组的多数派节点上得到确认的锁才从登记表注销；节点出错或未发送而没有确认的锁留在登记表中，
+   再次调用 release_all 时重试（过期后自然从登记表消失）。
+返回值：确认释放（已从登记表移除）的锁数量。
+*/
+size_t RedLock::release_all(std::chrono::steady_clock::time_point deadline) {
+    std::vector<Lock> locks = held_.snapshot();
+    // 每把锁所属的组（每个节点只发送本组的 key）
+    std::vector<size_t> lock_group(locks.size());
+    for (size_t k = 0; k < locks.size(); k++) {
+        lock_group[k] = group_of(locks[k].resource_.data(), locks[k].resource_.size());
+    }
+    std::vector<int> acks(locks.size(), 0);  // 每把锁得到确认的节点数
+    size_t done = 0;
+    size_t released = 0;
+    while (done < locks.size() && std::chrono::steady_clock::now() < deadline) {
+        size_t n = std::min(RELEASE_BATCH, locks.size() - done);
+
+        // 步骤1：把这一批中属于该节点所在组的锁编码后追加到节点的输出缓冲
+        std::vector<bool> sent(servers_.size(), false);
+        for (size_t i = 0; i < servers_.size(); i++) {
+            RedisNode &node = servers_[i];
+            size_t keys = 0;
+            for (size_t k = done; k < done + n; k++) {
+                keys += lock_group[k] == node.group;
+            }
+            if (keys == 0 || !prepare_node(node, 0)) {
+                continue;
+            }
+            node.cmd.clear();
+            node.cmd.begin(static_cast<int>(3 + 2 * keys));
+            node.cmd.arg("EVAL", 4);
+            node.cmd.arg(unlock_count_script());
+            node.cmd.arg(static_cast<int64_t>(keys));
+            for (size_t k = done; k < done + n; k++) {
+                if (lock_group[k] == node.group) {
+                    node.cmd.arg(locks[k].resource_.data(), locks[k].resource_.size());
+                }
+            }
+            for (size_t k = done; k < done + n; k++) {
+                if (lock_group[k] == node.group) {
+                    node.cmd.arg(locks[k].value_.data(), locks[k].value_.size());
+                }
+            }
+            sent[i] = redisAppendFormattedCommand(node.ctx, node.cmd.data(), node.cmd.size()) == REDIS_OK;
+            stats_.redis_ops++;
+            if (!sent[i]) {
+                node_failed(node);
+            }
+        }
+
+        // 步骤2：先把所有节点的输出缓冲写出，再逐个读取回复（各节点并行执行脚本）
+        for (size_t i = 0; i < servers_.size(); i++) {
+            int written = 0;
+            while (sent[i] && !written) {
+                if (redisBufferWrite(servers_[i].ctx, &written) != REDIS_OK) {
+                    node_failed(servers_[i]);
+                    sent[i] = false;
+                }
+            }
+        }
+        for (size_t i = 0; i < servers_.size(); i++) {
+            void *reply = nullptr;
+            if (!sent[i]) {
+                continue;
+            }
+            if (redisGetReply(servers_[i].ctx, &reply) != REDIS_OK) {
+                node_failed(servers_[i]);
+                continue;
+            }
+            // 脚本正常返回（删除数量）：本批属于该组的 key 在该节点上都已不再由本客户端持有；脚本出错时不算确认
+            redisReply *r = static_cast<redisReply *>(reply);
+            if (r && r->type == REDIS_REPLY_INTEGER) {
+                for (size_t k = done; k < done + n; k++) {
+                    acks[k] += lock_group[k] == servers_[i].group;
+                }
+            }
+            freeReplyObject(reply);
+        }
+
+        // 步骤3：多数派节点确认的锁从登记表注销，其余的留待重试
+        for (size_t k = done; k < done + n; k++) {
+            if (acks[k] >= groups_[lock_group[k]].quorum) {
+                held_.erase(locks[k]);
+                released++;
+            }
+        }
+        done += n;
+    }
+    return released;
+}
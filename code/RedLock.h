@@ -1,20 +1,71 @@
 #pragma once
+#include "AdaptiveTtl.h"
+#include "CancelToken.h"
+#include "ConsistentHash.h"
+#include "ContentionProfiler.h"
+#include "InlineString.h"
+#include "Lock.h"
+#include "LockBatcher.h"
+#include "LockRegistry.h"
+#include "FlightRecorder.h"
+#include "LockTracer.h"
+#include "LogHistogram.h"
+#include "RespEncoder.h"
+#include "RetryPolicy.h"
+#include "ServerOptions.h"
+#include "TokenGenerator.h"
+#include "UnlockSender.h"
 #include <hiredis/hiredis.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
-//表示一个分布式锁的状态的结构体
-struct Lock{
-    // 默认构造函数：初始化有效时间为0
-    Lock() : valid_time_(0) {};
-    //构造函数：通过资源名、持有者标识、有效时间初始化锁对象
-    Lock(const std::string &resource,const std::string &value,int valid_time)
-        : resource_(resource),value_(value),valid_time_(valid_time){}
-
-    std::string resource_;  // 被加锁的资源名称（如"user_123_lock"）    
-    std::string value_;  // 锁的唯一持有者标识（防止误释放其他客户端的锁）
-    int valid_time_;  // 锁的剩余有效时间（单位：毫秒）
+// 客户端累计统计（供压测工具/诊断使用，只增不减）
+struct RedLockStats{
+    uint64_t lock_calls = 0;     // lock() 调用次数
+    uint64_t lock_success = 0;   // lock() 成功次数
+    uint64_t lock_attempts = 0;  // 加锁轮次（首次尝试 + 重试）
+    uint64_t redis_ops = 0;      // 发往Redis的命令总数（SET/EVAL）
+    uint64_t node_errors = 0;    // 命令超时或连接出错的次数（连接随后被关闭，按退避间隔重连）
+    uint64_t skipped_nodes = 0;  // 本轮有效期预算已耗尽或已不可能达到多数派、因而没有发送的节点数
+    uint64_t reconnects = 0;     // 重连成功的次数
+};
+
+// run_locked 的结果
+enum class LockRunStatus{
+    NotAcquired,  // 没有拿到锁，业务函数未执行
+    Completed,    // 业务函数执行期间锁一直有效
+    Cancelled,    // 业务函数执行期间续锁失败或租约即将到期，令牌已取消
+};
+
+// 单个Redis节点：连接上下文 + 该连接专用的命令编码缓冲区
+struct RedisNode{
+    redisContext *ctx = nullptr;  // hiredis连接对象
+    RespEncoder cmd;              // 复用的RESP编码缓冲区（避免每条命令分配内存）
+    size_t group = 0;             // 所属的组下标
+    std::string host;             // 节点地址（异步解锁发送器按地址建立自己的连接）
+    int port = 0;
+    ServerOptions options;        // 连接选项
+    int sender_id = -1;           // 在异步解锁发送器中的节点编号（-1 未注册）
+    int batcher_id = -1;          // 在加锁 I/O 线程中的节点编号（-1 未注册）
+    LogHistogram latency;         // 命令往返延迟（微秒），用于计算自适应命令超时
+    int64_t timeout_us = 0;       // 当前设置在连接上的命令超时（微秒，0 表示未设置）
+    int64_t reconnect_at_ms = 0;  // 连接失效后最早的重连时间（steady_clock 毫秒）
+    int reconnect_delay_ms = 0;   // 下一次重连失败后的退避间隔（毫秒，0 表示按选项的初始值）
+};
+
+// 一组相互独立的节点：资源按一致性哈希路由到某一组，在组内执行多数派逻辑
+struct NodeGroup{
+    std::vector<size_t> nodes;  // 组内节点在 servers_ 中的下标
+    int quorum = 0;             // 组内多数派节点数
+    int sender_group = -1;      // 在异步解锁发送器中的组编号（-1 未注册）
+    int batcher_group = -1;     // 在加锁 I/O 线程中的组编号（-1 未注册）
 };
 
 // 基于Redis的分布式锁实现类（遵循RedLock算法）
@@ -22,59 +73,206 @@ class RedLock{
 public:
     // RedLock.h
     ~RedLock() {
-        for (auto ctx : servers_) {
-            if (ctx) {
-                redisFree(ctx); // 释放所有Redis连接
+        for (auto &node : servers_) {
+            if (node.ctx) {
+                redisFree(node.ctx); // 释放所有Redis连接
             }
         }
     }
     // 设置获取锁/续锁时的重试次数（用于失败后重试）
     bool set_retry_count(int count);
 
-    // 向分布式锁实例中添加一个Redis服务器节点
+    // 向分布式锁实例中添加一个Redis服务器节点（属于第0组）
     bool add_server(const std::string &host,int port,std::string &err);
 
+    // 按连接选项添加节点（Unix 域套接字、连接/命令超时、TCP_NODELAY、keepalive、收发缓冲区）
+    bool add_server(const std::string &host, int port, const ServerOptions &options, std::string &err);
+
+    // 添加一组独立的Redis节点（新的多数派组），资源按一致性哈希分布到各组
+    bool add_server_group(const std::vector<std::pair<std::string, int>> &servers, std::string &err);
+    bool add_server_group(const std::vector<std::pair<std::string, int>> &servers, const ServerOptions &options, std::string &err);
+
+    // 组数量
+    size_t group_count() const { return groups_.size(); }
+
+    // 资源名所属的组下标
+    size_t group_of(const std::string &resource) const;
+
     //尝试获取分布式锁（核心方法）
     bool lock(const std::string& resource, int ttl_ms, Lock& lock);
 
+    // 在截止时间之前反复尝试获取锁（不限次数，等待间隔由重试策略决定）；节点的命令超时以截止时间为上限，不经过 LockBatcher
+    bool lock(const std::string& resource, int ttl_ms, Lock& lock, std::chrono::steady_clock::time_point deadline);
+
+    // 只尝试一轮（各节点一次往返，失败时不等待、不重试）
+    bool try_lock(const std::string& resource, int ttl_ms, Lock& lock);
+
     // 释放分布式锁（在所有Redis节点上删除锁）
     bool unlock(const Lock &lock);
 
+    // 异步释放分布式锁：放入后台发送器的队列后立即返回，done（可选）在发送线程中报告是否在多数派节点上确认删除
+    // 可以与其他线程对同一实例的 unlock_async 并发调用，但不能与 add_server 等配置函数并发
+    bool unlock_async(const Lock &lock, UnlockSender::Callback done = nullptr);
+
+    // 设置异步解锁发送器（可在多个 RedLock 实例之间共享，使不同线程的解锁请求合并发送）
+    void set_unlock_sender(std::shared_ptr<UnlockSender> sender);
+
+    // 设置加锁 I/O 线程（为空时恢复直接发送）：lock / try_lock / continue_lock / unlock 的每一轮交给它发送，
+    // 多个线程（各自的 RedLock 实例）共享同一个 I/O 线程时，并发的请求按节点合并为一次流水线往返
+    void set_batcher(std::shared_ptr<LockBatcher> batcher);
+
     // 延长锁的有效时间（续锁）
     bool continue_lock(const std::string &resource,int ttl_ms,Lock &lock);
 
+    // 批量续锁：每个节点只发送一次（每 RELEASE_BATCH 把锁一条多 key 续期脚本，全部流水线发送），按锁分别判断多数派。
+    // 只尝试一轮；成功的锁更新 valid_time_，renewed（可选）按 locks 的顺序给出每把锁是否续期成功。
+    // ttl_ms 不支持 AUTO_TTL。返回续期成功的锁数量
+    size_t continue_many(std::vector<Lock> &locks, int ttl_ms, std::vector<bool> *renewed = nullptr);
+
+    // 持锁执行：获取锁后调用 fn，fn 执行期间由后台线程续锁，结束后（包括抛出异常时）异步释放锁。
+    // 续锁失败或租约即将到期时取消 token；fn 执行期间本实例由续锁线程使用，fn 不能再调用本实例的其他函数
+    LockRunStatus run_locked(const std::string &resource, int ttl_ms, const std::function<void(const CancelToken &)> &fn);
+
+    // 设置默认策略的重试间隔上限（毫秒）：不知道持有者租约的剩余时间时，等待[0, delay_ms]内的随机值。
+    // 已用 set_retry_policy 设置自定义策略时自定义策略优先，delay_ms 只在之后恢复默认策略时生效
+    bool set_retry_delay(int delay_ms);
+
+    // 设置重试/退避策略（为空时恢复默认的均匀抖动，使用 set_retry_delay 设置的上限）
+    void set_retry_policy(std::shared_ptr<const RetryPolicy> policy);
+
+    // 设置获取锁/续锁的总等待时间（毫秒，>0 时以截止时间代替重试次数，0 表示按次数）
+    bool set_acquire_timeout(int timeout_ms);
+
+    // 设置锁令牌格式（默认十六进制；二进制令牌更短，但在 redis-cli 中不可读）
+    void set_token_format(TokenFormat format);
+
+    // 设置自适应命令超时（所有节点共用一套参数，各节点按自己的延迟分布计算）
+    void set_command_timeouts(const CommandTimeoutOptions &options) { timeout_options_ = options; }
+
+    // 第 index 个节点（按添加顺序）当前的命令超时（毫秒，0 表示不限制），用于诊断
+    int command_timeout_ms(size_t index) const;
+
+    // 获取累计统计
+    const RedLockStats &stats() const { return stats_; }
+
+    // 设置自适应 TTL（为空时关闭）：ttl_ms 传 AUTO_TTL 时按资源的持锁时间分布选择 TTL，可在多个实例之间共享
+    void set_adaptive_ttl(std::shared_ptr<AdaptiveTtl> model) { ttl_model_ = std::move(model); }
+
+    // 资源当前会使用的自适应 TTL（未设置 set_adaptive_ttl 时返回 0）
+    int adaptive_ttl(const std::string &resource) const { return resolve_ttl(resource.data(), resource.size(), AUTO_TTL); }
+
+    static constexpr int AUTO_TTL = 0;  // 作为 ttl_ms 传入时使用自适应 TTL（lock / try_lock / continue_lock / run_locked）
+
+    // 设置追踪器（为空时关闭，默认关闭）：按采样记录每次 lock / continue_lock / unlock 的每一轮、每个节点命令与重试睡眠，
+    // 可在多个实例之间共享，用 LockTracer::dump 导出 Chrome trace JSON
+    void set_tracer(std::shared_ptr<LockTracer> tracer) { tracer_ = std::move(tracer); }
+
+    // 设置飞行记录器（默认为进程级的 FlightRecorder::global()，传 nullptr 关闭）：每次 lock / continue_lock / unlock /
+    // continue_many 结束时写入一条记录（资源、各节点结果、耗时、有效期），用 FlightRecorder::dump 导出
+    void set_flight_recorder(FlightRecorder *recorder) { recorder_ = recorder; }
+
+    // 设置竞争分析器（为空时关闭，默认关闭）：按资源记录加锁轮次、失败、等待与持锁时间，可在多个实例之间共享
+    void set_profiler(std::shared_ptr<ContentionProfiler> profiler) { profiler_ = std::move(profiler); }
+
+    // 开启/关闭持有表（默认关闭，应在开始加锁前设置）：开启后 lock/continue_lock/continue_many 成功时登记，
+    // unlock 时注销，find_lock / release_all 依赖它；关闭时加解锁不访问持有表
+    void set_track_held(bool on) { track_held_ = on; }
+
+    // 按资源名查找当前客户端持有且未过期的锁（需开启 set_track_held）
+    bool find_lock(const std::string &resource, Lock &out) const { return held_.find(resource, out); }
+
+    // 把其他进程交来的锁登记为本实例持有（不访问Redis，见 HostLockTable；不受 set_track_held 影响）
+    void adopt(const Lock &lock) { held_.put(lock); }
+
+    // 从持有表注销但不释放（锁已交给其他进程）
+    bool disown(const Lock &lock) { return held_.erase(lock); }
+
+    // 当前客户端持有的锁数量
+    size_t held_count() const { return held_.size(); }
+
+    // 批量释放所有已登记且未过期的锁（用于优雅退出，需开启 set_track_held 或用 adopt 登记）：每个节点按批发送多 key 解锁脚本并流水线执行，
+    // 到达 deadline 后不再发送新的批次。只有多数派节点确认已释放（删除或早已不属于本客户端）的锁才从登记表移除，其余的留待再次调用时重试。
+    // 返回确认释放的锁数量
+    size_t release_all(std::chrono::steady_clock::time_point deadline);
+
 private:
-    // 私有辅助函数：在单个Redis节点上尝试获取锁
-    bool lock_instance(redisContext* context, const std::string& resource, const std::string& value, int ttl_ms);
-    // 私有辅助函数：在单个Redis节点上释放锁（通过Lua脚本保证原子性）
-    bool unlock_instance(redisContext* context, const std::string& resource, const std::string& value);
+    // 私有辅助函数：连接一个节点（检查重复），失败时返回 nullptr
+    redisContext *connect_node(const std::string &host, int port, const ServerOptions &options, std::string &err);
+    // 私有辅助函数：把连接加入服务器列表并归入第 group 组
+    void attach_node(redisContext *context, size_t group, const std::string &host, int port, const ServerOptions &options);
+    // 私有辅助函数：把尚未注册的节点/组注册到异步解锁发送器
+    void bind_sender();
+    // 私有辅助函数：把尚未注册的节点/组注册到加锁 I/O 线程
+    void bind_batcher();
+    // 私有辅助函数：ttl_ms 为 AUTO_TTL 时换成自适应 TTL（未设置时为0，加锁失败）
+    int resolve_ttl(const char *resource, size_t len, int ttl_ms) const{
+        return ttl_ms == AUTO_TTL && ttl_model_ ? ttl_model_->ttl_for(resource, len) : ttl_ms;
+    }
+    // 私有辅助函数：资源名所属的组下标
+    size_t group_of(const char *resource, size_t len) const { return shard_of(resource, len, groups_.size()); }
+    // 私有辅助函数：lock 的实现（最多 max_attempts 轮，不会在 deadline 之后开始新的一轮，节点命令超时也不超过 deadline）
+    bool acquire(const std::string& resource, int ttl_ms, Lock& lock, int max_attempts, std::chrono::steady_clock::time_point deadline);
+    // 私有辅助函数：按重试策略等待，等待结束后再进行一轮（按上一轮的耗时估计）会越过 deadline 时返回 false
+    bool wait_before_retry(RetryContext &ctx, std::chrono::steady_clock::time_point deadline);
+    // 私有辅助函数：在单个Redis节点上尝试获取锁，失败时 lease_ms 为该节点上持有者租约的剩余时间（-1 表示未知）
+    bool lock_instance(RedisNode &node, const Lock &lock, int ttl_ms, int64_t &lease_ms);
+    // 私有辅助函数：在组内节点上流水线释放锁（通过Lua脚本保证原子性），lease_ms 非空时只释放本轮加锁成功的节点；
+    // flight 非空时填写各节点的结果
+    int unlock_nodes(const NodeGroup &group, const Lock &lock, const int64_t *lease_ms, FlightRecorder::Entry *flight = nullptr);
+    // 私有辅助函数：continue_lock 的实现（最多 max_attempts 轮，不会在 deadline 之后开始新的一轮）
+    bool extend(Lock &lock, int ttl_ms, int max_attempts, std::chrono::steady_clock::time_point deadline);
     // 私有辅助函数：在单个Redis节点上续锁（延长锁的有效时间）
-    bool continue_lock_instance(redisContext* context, const std::string& resource, const std::string& value, int ttl_ms);
+    bool continue_lock_instance(RedisNode &node, const Lock &lock, int ttl_ms);
+    // 私有辅助函数：发送节点缓冲区中已编码的命令并同步读取回复（记录往返延迟，失败时关闭连接）
+    redisReply *execute(RedisNode &node);
+    // 私有辅助函数：发送前准备节点：连接失效时按退避间隔重连，把命令超时设为 min(自适应超时, budget_us)；
+    // budget_us 为 0 表示不受有效期预算限制。节点不可用时返回 false
+    bool prepare_node(RedisNode &node, int64_t budget_us);
+    // 私有辅助函数：节点的自适应命令超时（微秒，0 表示不限制）
+    int64_t node_timeout_us(const RedisNode &node) const;
+    // 私有辅助函数：命令超时或连接出错：关闭连接（可能还有未读取的回复）并安排重连
+    void node_failed(RedisNode &node);
+    // 私有辅助函数：填写调用的结果并写入飞行记录器（各节点结果由调用方填写，dur 为从 start_us 到现在）
+    void flight_record(FlightRecorder::Entry &e, FlightRecorder::Op op, const Lock &lock, size_t nodes, int quorum, bool ok, int attempts, int ttl_ms, int64_t valid_ms, int64_t start_us);
+    // 私有辅助函数：调用开始时按采样决定是否追踪本次调用，返回开始时间（steady_clock 微秒）
+    int64_t trace_begin();
+    // 私有辅助函数：追踪中时记录一个从 start_us 到现在的时间段（node 为节点下标，-1 表示不是节点命令）
+    void trace_span(const char *name, int64_t start_us, int node, const char *outcome, const char *value_name, int64_t value);
+    // 私有辅助函数：记录最外层的调用事件，并把本次调用的事件交给追踪器保留或丢弃
+    void trace_end(const char *name, const Lock &lock, int64_t start_us, const char *outcome, const char *value_name, int64_t value);
 
     // 静态常量成员：默认配置参数
     static constexpr float DEFAULT_LOCK_DRIFT_FACTOR = 0.01f;  // 时钟漂移因子（用于补偿不同服务器的时间差）
     static constexpr int DEFAULT_LOCK_RETRY_COUNT = 3;         // 默认重试次数（获取锁失败时的重试次数）
     static constexpr int DEFAULT_LOCK_RETRY_DELAY = 200;        // 默认重试延迟（毫秒，失败后等待的时间）
+    static constexpr size_t RELEASE_BATCH = 256;                // release_all / continue_many 每条脚本携带的 key 数
+    static constexpr float RUN_LOCKED_CANCEL_FACTOR = 0.1f;     // run_locked 在租约剩余 TTL 的该比例时取消令牌（留给业务函数收尾）
 
     //成员变量
-    std::vector<redisContext*> servers_; // 存储所有Redis服务器的连接上下文（hiredis的连接对象）
-    int quorum_;   // 多数派节点数（锁操作需要成功的最小节点数，防止脑裂）
+    std::vector<RedisNode> servers_; // 存储所有Redis服务器节点（连接上下文 + 编码缓冲区）
+    std::vector<NodeGroup> groups_;  // 节点组（每组有自己的多数派节点数，锁操作需要组内多数派成功，防止脑裂）
     int retry_count_ = DEFAULT_LOCK_RETRY_COUNT;  // 当前设置的重试次数（可通过set_retry_count修改）
     int retry_delay_ms_ = DEFAULT_LOCK_RETRY_DELAY;  // 重试间隔时间（毫秒
-    std::mt19937 rng_;  // Mersenne Twister随机数生成器（用于生成随机延迟和唯一锁标识）
-
-     // Lua脚本（用于原子化操作Redis）
-    // 解锁脚本：仅当锁的持有者标识匹配时才删除锁（防止误删其他客户端的锁）
-    const std::string UNLOCK_SCRIPT = 
-        "if redis.call('get', KEYS[1]) == ARGV[1] then "  // 检查当前锁的值是否等于客户端的唯一标识
-        "return redis.call('del', KEYS[1]) "              // 匹配则删除锁
-        "else "                                            // 不匹配
-        "return 0 "                                        // 返回0（表示未删除）
-        "end"; 
-
-    // 续锁脚本：仅当锁的持有者标识匹配时，延长锁的有效时间
-    const std::string CONTINUE_LOCK_SCRIPT = 
-        "if redis.call('get', KEYS[1]) == ARGV[1] then "  // 检查锁的值是否匹配
-        "return redis.call('pexpire', KEYS[1], ARGV[2]) "  // 匹配则设置新的有效时间（毫秒）
-        "end";  // 不匹配则无操作（返回nil）
+    int acquire_timeout_ms_ = 0;  // 获取锁的总等待时间（毫秒，0表示按重试次数）
+    std::shared_ptr<const RetryPolicy> retry_policy_ = default_retry_policy(retry_delay_ms_);  // 重试/退避策略（默认见 RetryPolicy.h）
+    bool custom_retry_policy_ = false;  // retry_policy_ 是否由 set_retry_policy 设置（此时 set_retry_delay 不替换它）
+    std::mt19937 rng_{static_cast<std::mt19937::result_type>(TokenGenerator::local().next_u64())};  // 随机延迟生成器（每个实例独立播种）
+    TokenFormat token_format_ = TokenFormat::Hex;  // 锁令牌格式
+    RedLockStats stats_;  // 累计统计
+    LockRegistry held_;   // 当前持有的锁（分片登记表）
+    bool track_held_ = false;  // 加解锁时是否自动登记到 held_
+    std::vector<int64_t> lease_ms_;  // 加锁失败时各节点上持有者租约的剩余时间（按节点下标，复用容量）
+    std::vector<char> pending_;      // 流水线解锁时各节点是否有待读取的回复（按组内下标，复用容量）
+    std::shared_ptr<UnlockSender> sender_;  // 异步解锁发送器（首次 unlock_async 时创建，或通过 set_unlock_sender 共享）
+    std::mutex sender_mu_;                  // 保护 sender_ 及节点/组的注册状态
+    std::shared_ptr<LockBatcher> batcher_;          // 加锁 I/O 线程（可选）
+    std::shared_ptr<ContentionProfiler> profiler_;  // 竞争分析器（可选）
+    std::shared_ptr<LockTracer> tracer_;            // 追踪器（可选）
+    FlightRecorder *recorder_ = &FlightRecorder::global();  // 飞行记录器（为空时不记录）
+    std::vector<LockTracer::Event> trace_;          // 本次调用的追踪事件（调用结束时交给追踪器，复用容量）
+    bool tracing_ = false;                          // 本次调用是否在追踪
+    bool trace_sampled_ = false;                    // 本次调用是否采样命中（未命中时只在耗时超过 slow_ms 时保留）
+    std::shared_ptr<AdaptiveTtl> ttl_model_;        // 自适应 TTL（可选）
+    CommandTimeoutOptions timeout_options_;         // 自适应命令超时
+    LogHistogram latency_;                          // 所有节点的命令往返延迟（微秒，节点自身样本不足时使用）
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "RedLockClient.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool RedLockClient::connect(const std::string &path, std::string &err){
+    close();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        err = "socket path too long: " + path;
+        return false;
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        err = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        err = "connect " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+void RedLockClient::close(){
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+/*
+功能：发送一个请求并同步读取回复。
+说明：请求的头部与数据通过一次 sendmsg 写出；回复的 id 与请求不一致或 I/O 失败时断开连接
+     （之后的调用都返回 false，需要重新 connect）。
+*/
+bool RedLockClient::call(uint8_t op, const char *resource, size_t resource_len, const char *token, size_t token_len,
+                         int ttl_ms, int wait_ms, Lock *out, uint8_t &status){
+    if (fd_ < 0 || resource_len > LOCKPROTO_MAX_RESOURCE || token_len > LOCKPROTO_MAX_TOKEN) {
+        return false;
+    }
+    LockRequestHeader req;
+    req.id = next_id_++;
+    req.op = op;
+    req.token_len = static_cast<uint8_t>(token_len);
+    req.resource_len = static_cast<uint16_t>(resource_len);
+    req.ttl_ms = ttl_ms;
+    req.wait_ms = wait_ms;
+    LockResponseHeader resp;
+    if (!lockproto_write(fd_, &req, sizeof(req), resource, resource_len, token, token_len) ||
+        !lockproto_read(fd_, &resp, sizeof(resp)) || resp.id != req.id) {
+        close();
+        return false;
+    }
+    char token_buf[LOCKPROTO_MAX_TOKEN];
+    if (resp.token_len > 0 && !lockproto_read(fd_, token_buf, resp.token_len)) {
+        close();
+        return false;
+    }
+    status = resp.status;
+    if (out && status == LOCK_STATUS_OK) {
+        if (resp.token_len > 0) {
+            out->value_.assign(token_buf, resp.token_len);
+        }
+        out->valid_time_ = resp.valid_ms;
+    }
+    return true;
+}
+
+bool RedLockClient::acquire(uint8_t op, const std::string &resource, int ttl_ms, int wait_ms, Lock &lock){
+    uint8_t status = LOCK_STATUS_ERROR;
+    lock.resource_.assign(resource.data(), resource.size());
+    lock.value_.clear();
+    lock.valid_time_ = 0;
+    return call(op, resource.data(), resource.size(), nullptr, 0, ttl_ms, wait_ms, &lock, status) && status == LOCK_STATUS_OK;
+}
+
+bool RedLockClient::lock(const std::string &resource, int ttl_ms, Lock &lock){
+    return acquire(LOCK_OP_LOCK, resource, ttl_ms, -1, lock);
+}
+
+bool RedLockClient::lock(const std::string &resource, int ttl_ms, Lock &lock, std::chrono::steady_clock::time_point deadline){
+    using namespace std::chrono;
+    int64_t wait_ms = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+    wait_ms = std::max<int64_t>(0, std::min<int64_t>(wait_ms, INT32_MAX));
+    return acquire(LOCK_OP_LOCK, resource, ttl_ms, static_cast<int>(wait_ms), lock);
+}
+
+bool RedLockClient::try_lock(const std::string &resource, int ttl_ms, Lock &lock){
+    return acquire(LOCK_OP_TRY_LOCK, resource, ttl_ms, -1, lock);
+}
+
+bool RedLockClient::unlock(const Lock &lock){
+    uint8_t status = LOCK_STATUS_ERROR;
+    return call(LOCK_OP_UNLOCK, lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size(),
+                0, -1, nullptr, status) && status == LOCK_STATUS_OK;
+}
+
+bool RedLockClient::continue_lock(const std::string &resource, int ttl_ms, Lock &lock){
+    uint8_t status = LOCK_STATUS_ERROR;
+    lock.resource_.assign(resource.data(), resource.size());  // 与 RedLock::continue_lock 一样以传入的资源名为准
+    return call(LOCK_OP_CONTINUE, resource.data(), resource.size(), lock.value_.data(), lock.value_.size(),
+                ttl_ms, -1, &lock, status) && status == LOCK_STATUS_OK;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Lock.h"
+#include "LockProtocol.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// redlockd 的客户端：接口与 RedLock 相同（lock / try_lock / unlock / continue_lock），
+// 但只与本机的守护进程通信，不直接连接 Redis。
+// - 启动时只需连接一个 Unix 域套接字，不需要逐个连接 Redis 节点；每次操作是一次本机往返
+// - Redis 连接数由守护进程决定，与客户端进程数无关
+// - 连接断开（包括进程崩溃）时，守护进程会释放经该连接获取且尚未释放的锁
+// 重试次数、重试间隔等由守护进程配置。与 RedLock 一样不是线程安全的（每个线程一个客户端）。
+class RedLockClient{
+public:
+    RedLockClient() = default;
+    ~RedLockClient() { close(); }
+
+    RedLockClient(const RedLockClient &) = delete;
+    RedLockClient &operator=(const RedLockClient &) = delete;
+
+    // 连接守护进程（path 为 redlockd --listen 的路径），失败时填写 err
+    bool connect(const std::string &path, std::string &err);
+
+    // 断开连接（守护进程会释放本连接持有的锁）
+    void close();
+
+    bool connected() const { return fd_ >= 0; }
+
+    // 获取锁（按守护进程的重试设置）
+    bool lock(const std::string &resource, int ttl_ms, Lock &lock);
+
+    // 在截止时间之前反复尝试获取锁
+    bool lock(const std::string &resource, int ttl_ms, Lock &lock, std::chrono::steady_clock::time_point deadline);
+
+    // 只尝试一轮
+    bool try_lock(const std::string &resource, int ttl_ms, Lock &lock);
+
+    // 释放锁：返回 true 表示在多数派节点上确认删除
+    bool unlock(const Lock &lock);
+
+    // 续锁：lock.resource_ 设为 resource，成功时更新 lock.valid_time_
+    bool continue_lock(const std::string &resource, int ttl_ms, Lock &lock);
+
+private:
+    // 发送一个请求并等待回复；I/O 失败时断开连接并返回 false
+    bool call(uint8_t op, const char *resource, size_t resource_len, const char *token, size_t token_len,
+              int ttl_ms, int wait_ms, Lock *out, uint8_t &status);
+    bool acquire(uint8_t op, const std::string &resource, int ttl_ms, int wait_ms, Lock &lock);
+
+    int fd_ = -1;
+    uint32_t next_id_ = 1;
+};
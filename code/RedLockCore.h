@@ -0,0 +1,245 @@
+#pragma once
+#include "Lock.h"
+#include "RetryPolicy.h"
+#include "TokenGenerator.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+
+// 模板化的 RedLock 核心（纯头文件）：节点数、传输层、时钟、随机数生成器都在编译期确定
+// - N 个节点存放在 std::array 中，多数派 QUORUM 与漂移补偿都是编译期常量，循环可以完全展开
+// - 传输层是普通的类（非虚函数），调用可以内联；换成 MockTransport 即可在没有 Redis 的情况下压测/测试
+// - 每一轮把命令先写入所有节点再统一读取回复，总耗时约为一次往返
+// - 重试与 RedLock 相同：同一个 RetryPolicy（默认按持有者租约调度）、同一套 RetryContext 记账（retry_after_round），
+//   等待之后再进行一轮会越过截止时间时放弃（retry_delay_ms）；命令超时不超过有效期预算与距截止时间的剩余时间，
+//   两者已耗尽时不再发送。与 RedLock 的差别：一轮中所有节点同时发送，没有逐个节点的多数派跳过；
+//   没有按节点延迟分布的自适应超时（超时上限由传输层自己的配置决定）
+// - 漂移补偿是编译期策略 Drift（默认 DefaultDrift，与 RedLock 相同），热路径上没有运行时分支
+// 适合节点固定的部署；需要分组、异步解锁、持有表等功能时使用 RedLock。与 RedLock 一样不是线程安全的。
+//
+// Transport 需要提供（每个节点一个对象）：
+//   void set_timeout_us(int64_t us);                  // 之后的命令最多等待 us 微秒（0 表示只受传输层自己的命令超时限制）
+//   bool send_acquire(const Lock &lock, int ttl_ms);  // 追加 SET NX PX（失败时带回持有者 PTTL）的命令，返回是否成功写入缓冲
+//   bool send_release(const Lock &lock);              // 追加“持有者匹配时删除”的命令
+//   bool send_extend(const Lock &lock, int ttl_ms);   // 追加“持有者匹配时续期”的命令
+//   void flush();                                     // 把缓冲中的命令写出
+//   bool recv_acquire(int64_t &lease_ms);             // 读取加锁结果，失败时 lease_ms 为持有者剩余时间（-1 未知）
+//   bool recv_release();                              // 读取解锁结果（是否删除）
+//   bool recv_extend();                               // 读取续期结果
+// send_* 返回 true 的节点才会被 flush / recv_*
+
+// 时钟的睡眠方式：标准时钟使用 std::this_thread；模拟时钟可以特化本模板，在虚拟时间上推进
+template <typename Clock>
+struct ClockTraits{
+    template <typename Duration>
+    static void sleep_for(const Duration &d) { std::this_thread::sleep_for(d); }
+};
+
+// 默认的时钟漂移补偿：TTL 的 1% + 2ms（与 RedLock 的 DEFAULT_LOCK_DRIFT_FACTOR 相同），整数运算、编译期常量
+struct DefaultDrift{
+    static constexpr int64_t drift_ms(int ttl_ms) { return ttl_ms / 100 + 2; }
+};
+
+// 默认随机数来源：当前线程的 ChaCha20 令牌生成器（令牌需要不可预测）
+struct TokenRng{
+    typedef uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+    result_type operator()() { return TokenGenerator::local().next_u64(); }
+};
+
+template <typename Transport, size_t N, typename Clock = std::chrono::steady_clock, typename Rng = TokenRng, typename Drift = DefaultDrift>
+class RedLockCore{
+    static_assert(N >= 1, "RedLockCore needs at least one node");
+    static_assert(Rng::max() - Rng::min() >= 0xffffffffu, "Rng must produce at least 32 random bits per call");
+
+public:
+    typedef typename Clock::time_point TimePoint;
+
+    static constexpr size_t NODE_COUNT = N;
+    static constexpr size_t QUORUM = N / 2 + 1;  // 多数派节点数
+
+    static constexpr int64_t drift_ms(int ttl_ms) { return Drift::drift_ms(ttl_ms); }
+
+    // retry_delay_ms：默认重试策略的等待上限（与 RedLock::set_retry_delay 相同，见 default_retry_policy）
+    explicit RedLockCore(std::array<Transport, N> nodes, Rng rng = Rng(), int retry_delay_ms = 200)
+        : nodes_(std::move(nodes)), rng_(std::move(rng)), retry_delay_ms_(retry_delay_ms),
+          retry_policy_(default_retry_policy(retry_delay_ms)) {
+        retry_rng_.seed(static_cast<std::mt19937::result_type>(rng_() - Rng::min()));
+    }
+
+    Transport &node(size_t i) { return nodes_[i]; }
+
+    // 设置重试/退避策略（与 RedLock::set_retry_policy 相同的策略对象，可以共享）；为空时恢复默认策略
+    void set_retry_policy(std::shared_ptr<const RetryPolicy> policy){
+        retry_policy_ = policy ? std::move(policy) : default_retry_policy(retry_delay_ms_);
+    }
+
+    // 只尝试一轮，不睡眠
+    bool try_lock(const char *resource, size_t len, int ttl_ms, Lock &lock){
+        lock.resource_.assign(resource, len);
+        new_token(lock);
+        return acquire_round(lock, ttl_ms, TimePoint::max());
+    }
+
+    // 在截止时间之前反复尝试，等待间隔由重试策略决定（失败的一轮带回各节点持有者的剩余租约）；
+    // 等待之后再进行一轮（按上一轮耗时估计）会越过截止时间时放弃，一轮中的命令超时也不超过截止时间
+    bool lock(const char *resource, size_t len, int ttl_ms, Lock &lock, TimePoint deadline){
+        lock.resource_.assign(resource, len);
+        new_token(lock);
+        RetryContext retry;
+        TimePoint begin = Clock::now();
+        while (true) {
+            TimePoint start = Clock::now();
+            if (acquire_round(lock, ttl_ms, deadline)) {
+                return true;
+            }
+            TimePoint now = Clock::now();
+            retry_after_round(retry, lease_.data(), N, QUORUM, to_ms(now - start), to_ms(now - begin));
+            int delay = retry_delay_ms(*retry_policy_, retry, retry_rng_, deadline == TimePoint::max() ? INT64_MAX : to_ms(deadline - now));
+            if (delay < 0) {
+                return false;
+            }
+            ClockTraits<Clock>::sleep_for(std::chrono::milliseconds(delay));
+            retry.prev_delay_ms = delay;
+        }
+    }
+
+    // 续期一轮：在多数派节点上成功时更新 valid_time_（失败时保持不变）
+    bool extend(Lock &lock, int ttl_ms){
+        TimePoint start = Clock::now();
+        int64_t budget_us = (ttl_ms - drift_ms(ttl_ms)) * 1000;
+        if (budget_us <= 0) {
+            return false;
+        }
+        for (size_t i = 0; i < N; i++) {
+            nodes_[i].set_timeout_us(budget_us);
+            sent_[i] = nodes_[i].send_extend(lock, ttl_ms);
+        }
+        flush_sent();
+        size_t ok = 0;
+        for (size_t i = 0; i < N; i++) {
+            if (sent_[i]) {
+                limit_recv(i, start, budget_us);
+                ok += nodes_[i].recv_extend();
+            }
+        }
+        return finish_round(lock, ttl_ms, start, ok);
+    }
+
+    // 在所有节点上释放锁，返回确认删除的节点数
+    size_t unlock(const Lock &lock){
+        for (size_t i = 0; i < N; i++) {
+            nodes_[i].set_timeout_us(0);
+            sent_[i] = nodes_[i].send_release(lock);
+        }
+        return release_sent();
+    }
+
+private:
+    template <typename Duration>
+    static int64_t to_ms(const Duration &d) { return std::chrono::duration_cast<std::chrono::milliseconds>(d).count(); }
+
+    // 读取节点 i 的回复之前把它的超时设为本轮剩余的预算：逐个读取时，后面的节点不会再等一个完整的超时
+    void limit_recv(size_t i, TimePoint start, int64_t budget_us){
+        int64_t left_us = budget_us - std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        nodes_[i].set_timeout_us(std::max<int64_t>(left_us, 1));
+    }
+
+    // 一轮加锁：命令超时不超过有效期预算（TTL - 漂移）与距截止时间的剩余时间，两者已耗尽时不发送；
+    // 失败时释放本轮拿到的及结果未知（超时、出错）的节点，只跳过确定拒绝的节点。lease_ 记录各节点结果供重试策略使用
+    bool acquire_round(Lock &lock, int ttl_ms, TimePoint deadline){
+        TimePoint start = Clock::now();
+        lease_.fill(LEASE_NOT_SENT);
+        lock.valid_time_ = 0;
+        int64_t budget_us = (ttl_ms - drift_ms(ttl_ms)) * 1000;
+        if (deadline != TimePoint::max()) {
+            budget_us = std::min<int64_t>(budget_us, std::chrono::duration_cast<std::chrono::microseconds>(deadline - start).count());
+        }
+        if (budget_us <= 0) {
+            return false;
+        }
+        for (size_t i = 0; i < N; i++) {
+            nodes_[i].set_timeout_us(budget_us);
+            sent_[i] = nodes_[i].send_acquire(lock, ttl_ms);
+        }
+        flush_sent();
+        size_t granted = 0;
+        bool release = false;
+        for (size_t i = 0; i < N; i++) {
+            if (sent_[i]) {
+                limit_recv(i, start, budget_us);
+                granted += nodes_[i].recv_acquire(lease_[i]);
+            }
+            release_[i] = sent_[i] && lease_needs_release(lease_[i]);
+            release = release || release_[i];
+        }
+        if (finish_round(lock, ttl_ms, start, granted)) {
+            return true;
+        }
+        lock.valid_time_ = 0;
+        if (release) {
+            for (size_t i = 0; i < N; i++) {
+                nodes_[i].set_timeout_us(0);
+                sent_[i] = release_[i] && nodes_[i].send_release(lock);
+            }
+            release_sent();
+        }
+        return false;
+    }
+
+    bool finish_round(Lock &lock, int ttl_ms, TimePoint start, size_t ok){
+        int64_t elapsed = to_ms(Clock::now() - start);
+        int64_t valid = ttl_ms - elapsed - drift_ms(ttl_ms);
+        if (ok >= QUORUM && valid > 0) {
+            lock.valid_time_ = static_cast<int>(valid);
+            return true;
+        }
+        return false;
+    }
+
+    size_t release_sent(){
+        flush_sent();
+        size_t released = 0;
+        for (size_t i = 0; i < N; i++) {
+            released += sent_[i] && nodes_[i].recv_release();
+        }
+        return released;
+    }
+
+    void flush_sent(){
+        for (size_t i = 0; i < N; i++) {
+            if (sent_[i]) {
+                nodes_[i].flush();
+            }
+        }
+    }
+
+    // 160 位随机令牌（十六进制），每次取随机数的低 32 位
+    void new_token(Lock &lock){
+        uint8_t raw[TOKEN_RAW_LEN];
+        for (size_t i = 0; i < TOKEN_RAW_LEN; i += 4) {
+            uint32_t v = static_cast<uint32_t>(rng_() - Rng::min());
+            for (size_t k = 0; k < 4; k++) {
+                raw[i + k] = static_cast<uint8_t>(v >> (8 * k));
+            }
+        }
+        char hex[TOKEN_HEX_LEN];
+        hex_encode(raw, TOKEN_RAW_LEN, hex);
+        lock.value_.assign(hex, TOKEN_HEX_LEN);
+    }
+
+    std::array<Transport, N> nodes_;
+    std::array<bool, N> sent_{};     // 本轮命令已写入缓冲的节点
+    std::array<bool, N> release_{};  // 本轮加锁失败后需要释放的节点（加锁成功或结果未知）
+    std::array<int64_t, N> lease_{};  // 本轮各节点的加锁结果（见 LEASE_*），交给重试策略
+    Rng rng_;
+    int retry_delay_ms_;
+    std::shared_ptr<const RetryPolicy> retry_policy_;
+    std::mt19937 retry_rng_;  // 重试策略的随机数（由 rng_ 播种，模拟时可复现）
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// RESP 命令编码器：把固定形状的命令（SET NX PX / EVAL）直接编码到可复用的缓冲区中，
+// 再通过 redisAppendFormattedCommand 交给 hiredis。
+// 缓冲区容量在首次使用后保留，稳定状态下编码不会产生任何堆分配。
+class RespEncoder{
+public:
+    // 清空已编码内容（保留容量）
+    void clear() { buf_.clear(); }
+
+    const char *data() const { return buf_.data(); }
+    size_t size() const { return buf_.size(); }
+
+    // 写入数组头：*<argc>\r\n
+    void begin(int argc){
+        buf_.push_back('*');
+        append_uint(static_cast<uint64_t>(argc));
+        buf_.append("\r\n", 2);
+    }
+
+    // 写入一个二进制安全的参数：$<len>\r\n<data>\r\n
+    void arg(const char *s, size_t len){
+        buf_.push_back('$');
+        append_uint(len);
+        buf_.append("\r\n", 2);
+        buf_.append(s, len);
+        buf_.append("\r\n", 2);
+    }
+
+    void arg(const std::string &s) { arg(s.data(), s.size()); }
+
+    // 写入一个整数参数（就地格式化，不经过 std::to_string）
+    void arg(int64_t v){
+        char digits[24];
+        size_t len = format_int(v, digits);
+        arg(digits, len);
+    }
+
+    // SET <key> <value> NX PX <ttl_ms>
+    void set_nx_px(const char *key, size_t key_len, const char *val, size_t val_len, int64_t ttl_ms){
+        clear();
+        begin(6);
+        arg("SET", 3);
+        arg(key, key_len);
+        arg(val, val_len);
+        arg("NX", 2);
+        arg("PX", 2);
+        arg(ttl_ms);
+    }
+
+    // EVAL <script> 1 <key> <arg1>
+    void eval(const std::string &script, const char *key, size_t key_len, const char *arg1, size_t arg1_len){
+        clear();
+        begin(5);
+        arg("EVAL", 4);
+        arg(script);
+        arg("1", 1);
+        arg(key, key_len);
+        arg(arg1, arg1_len);
+    }
+
+    // EVAL <script> 1 <key> <arg1> <ttl_ms>
+    void eval(const std::string &script, const char *key, size_t key_len, const char *arg1, size_t arg1_len, int64_t ttl_ms){
+        clear();
+        begin(6);
+        arg("EVAL", 4);
+        arg(script);
+        arg("1", 1);
+        arg(key, key_len);
+        arg(arg1, arg1_len);
+        arg(ttl_ms);
+    }
+
+private:
+    // 十进制格式化，返回写入的字节数（out 至少 24 字节）
+    static size_t format_int(int64_t v, char *out){
+        uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+        char tmp[24];
+        size_t n = 0;
+        do {
+            tmp[n++] = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (u);
+        size_t len = 0;
+        if (v < 0) {
+            out[len++] = '-';
+        }
+        while (n) {
+            out[len++] = tmp[--n];
+        }
+        return len;
+    }
+
+    void append_uint(uint64_t u){
+        char digits[24];
+        size_t len = format_int(static_cast<int64_t>(u), digits);
+        buf_.append(digits, len);
+    }
+
+    std::string buf_;  // 复用的编码缓冲区
+};
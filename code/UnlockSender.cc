@@ -0,0 +1,295 @@
+#include "UnlockSender.h"
+#include "LockScripts.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+constexpr int UnlockSender::RECONNECT_DELAY_MS;
+constexpr int UnlockSender::MAX_RECONNECT_DELAY_MS;
+
+static int64_t steady_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+UnlockSender::UnlockSender(size_t max_batch, int command_timeout_ms)
+    : max_batch_(max_batch ? max_batch : 1), command_timeout_ms_(command_timeout_ms > 0 ? command_timeout_ms : 0) {
+    worker_ = std::thread(&UnlockSender::run, this);
+}
+
+UnlockSender::~UnlockSender() {
+    {
+        std::lock_guard<std::mutex> guard(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+    for (auto &node : nodes_) {
+        if (node.ctx) {
+            redisFree(node.ctx);
+        }
+    }
+}
+
+/*
+功能：注册一个节点。相同地址（host:port 或 Unix 域套接字路径）只建立一个连接，重复注册返回已有的编号。
+节点没有设置命令超时时使用发送器的默认值。连接失败时填写 err 但仍登记节点，由 prepare_node 按退避间隔重连。
+*/
+int UnlockSender::add_node(const std::string &host, int port, const ServerOptions &options, std::string &err) {
+    std::string endpoint = options.unix_path.empty() ? host + ":" + std::to_string(port) : options.unix_path;
+    {
+        std::lock_guard<std::mutex> guard(reg_mu_);
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (nodes_[i].endpoint == endpoint) {
+                return static_cast<int>(i);
+            }
+        }
+    }
+    ServerOptions opts = options;
+    if (opts.command_timeout_ms <= 0) {
+        opts.command_timeout_ms = command_timeout_ms_;
+    }
+    // 在锁外建立连接，避免阻塞后台线程
+    redisContext *context = connect_redis(host, port, opts);
+    if (context == nullptr || context->err) {
+        if (context) {
+            err = std::string(context->errstr);
+            redisFree(context);
+        } else {
+            err = "Redis connection error: can't allocate redis context";
+        }
+        context = nullptr;
+    }
+    std::lock_guard<std::mutex> guard(reg_mu_);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].endpoint == endpoint) { // 并发注册了同一地址
+            if (context) {
+                redisFree(context);
+            }
+            return static_cast<int>(i);
+        }
+    }
+    nodes_.emplace_back();
+    Node &node = nodes_.back();
+    node.endpoint = endpoint;
+    node.host = host;
+    node.port = port;
+    node.options = opts;
+    node.ctx = context;
+    if (!context) {
+        node.reconnect_at_ms = steady_ms() + RECONNECT_DELAY_MS;
+        node.reconnect_delay_ms = RECONNECT_DELAY_MS * 2;
+    }
+    return static_cast<int>(nodes_.size() - 1);
+}
+
+int UnlockSender::add_group(const std::vector<int> &nodes, int quorum) {
+    std::lock_guard<std::mutex> guard(reg_mu_);
+    groups_.push_back(Group{nodes, quorum});
+    return static_cast<int>(groups_.size() - 1);
+}
+
+void UnlockSender::submit(int group, const char *resource, size_t resource_len, const char *token, size_t token_len, Callback done) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(mu_);
+        wake = queue_.empty();  // 队列非空时后台线程要么已被唤醒、要么正在发送，无需再次通知
+        queue_.emplace_back();
+        Request &req = queue_.back();
+        req.group = group;
+        req.resource.assign(resource, resource_len);
+        req.token.assign(token, token_len);
+        req.done = std::move(done);
+        req.released = 0;
+        submitted_++;
+    }
+    if (wake) {
+        cv_.notify_one();
+    }
+}
+
+void UnlockSender::flush() {
+    std::unique_lock<std::mutex> guard(mu_);
+    uint64_t target = submitted_;
+    idle_cv_.wait(guard, [this, target]() { return completed_ >= target; });
+}
+
+UnlockSender::Stats UnlockSender::stats() const {
+    std::lock_guard<std::mutex> guard(mu_);
+    return stats_;
+}
+
+/*
+功能：后台线程主循环。每次取走队列中的全部请求作为一批发送，发送期间新到的请求累积为下一批；
+退出时先把队列发送完。
+*/
+void UnlockSender::run() {
+    std::vector<Request> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(mu_);
+            cv_.wait(guard, [this]() { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) { // stop_ 且没有剩余请求
+                return;
+            }
+            batch.swap(queue_);
+        }
+
+        send_batch(batch);
+
+        uint64_t failures = 0;
+        for (auto &req : batch) {
+            bool ok = req.released >= req.quorum;
+            failures += !ok;
+            if (req.done) {
+                req.done(ok);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(mu_);
+            completed_ += batch.size();
+            stats_.requests += batch.size();
+            stats_.batches++;
+            stats_.failures += failures;
+        }
+        idle_cv_.notify_all();
+        batch.clear();
+    }
+}
+
+/*
+功能：发送一批解锁请求。
+流程：
+1. 按节点归类：每个请求加入其所在组的每个节点的列表；
+2. 每个节点按 max_batch_ 个 key 一条脚本编码并追加到输出缓冲；
+3. 写出所有节点的输出缓冲（各节点并行执行），再逐个读取回复，按 key 统计确认删除的节点数。
+连接失效的节点到了重连时间才重连，否则本批发往该节点的解锁都视为失败；命令超时或连接出错后按退避间隔重连。
+*/
+void UnlockSender::send_batch(std::vector<Request> &batch) {
+    std::lock_guard<std::mutex> guard(reg_mu_);
+    for (auto &node : nodes_) {
+        node.requests.clear();
+        node.sent = 0;
+    }
+    for (size_t k = 0; k < batch.size(); k++) {
+        batch[k].quorum = groups_[batch[k].group].quorum;
+        for (int id : groups_[batch[k].group].nodes) {
+            nodes_[id].requests.push_back(k);
+        }
+    }
+
+    uint64_t commands = 0;
+    for (auto &node : nodes_) {
+        if (node.requests.empty() || !prepare_node(node)) {
+            continue;
+        }
+        for (size_t begin = 0; begin < node.requests.size(); begin += max_batch_) {
+            size_t n = std::min(max_batch_, node.requests.size() - begin);
+            node.cmd.clear();
+            node.cmd.begin(static_cast<int>(3 + 2 * n));
+            node.cmd.arg("EVAL", 4);
+            node.cmd.arg(unlock_many_script());
+            node.cmd.arg(static_cast<int64_t>(n));
+            for (size_t i = begin; i < begin + n; i++) {
+                const Request &req = batch[node.requests[i]];
+                node.cmd.arg(req.resource.data(), req.resource.size());
+            }
+            for (size_t i = begin; i < begin + n; i++) {
+                const Request &req = batch[node.requests[i]];
+                node.cmd.arg(req.token.data(), req.token.size());
+            }
+            if (redisAppendFormattedCommand(node.ctx, node.cmd.data(), node.cmd.size()) != REDIS_OK) {
+                node_failed(node);
+                node.sent = 0;
+                break;
+            }
+            node.sent++;
+            commands++;
+        }
+    }
+
+    for (auto &node : nodes_) {
+        int written = 0;
+        while (node.sent && !written) {
+            if (redisBufferWrite(node.ctx, &written) != REDIS_OK) {
+                node_failed(node);
+                node.sent = 0;
+            }
+        }
+    }
+
+    for (auto &node : nodes_) {
+        for (size_t c = 0; c < node.sent; c++) {
+            void *reply = nullptr;
+            if (redisGetReply(node.ctx, &reply) != REDIS_OK) {
+                node_failed(node);  // 超时或连接出错：后续回复都读不到了，连接上可能还有迟到的回复
+                break;
+            }
+            redisReply *r = static_cast<redisReply *>(reply);
+            if (r && r->type == REDIS_REPLY_ARRAY) {
+                size_t begin = c * max_batch_;
+                for (size_t j = 0; j < r->elements && begin + j < node.requests.size(); j++) {
+                    const redisReply *e = r->element[j];
+                    if (e->type == REDIS_REPLY_INTEGER && e->integer == 1) {
+                        batch[node.requests[begin + j]].released++;
+                    }
+                }
+            }
+            freeReplyObject(reply);
+        }
+        if (node.sent && node.ctx && node.ctx->err == 0) {
+            node.reconnect_delay_ms = 0;
+        }
+    }
+
+    std::lock_guard<std::mutex> stats_guard(mu_);
+    stats_.commands += commands;
+}
+
+/*
+功能：发送前准备节点：连接失效时到了重连时间才重连（连接超时不超过命令超时）。
+返回值：false 表示节点暂不可用，本批发往该节点的解锁都视为失败。
+*/
+bool UnlockSender::prepare_node(Node &node) {
+    if (node.ctx && node.ctx->err == 0) {
+        return true;
+    }
+    if (steady_ms() < node.reconnect_at_ms) {
+        return false;
+    }
+    ServerOptions options = node.options;
+    if (options.command_timeout_ms > 0) {
+        options.connect_timeout_ms = std::min(options.connect_timeout_ms, options.command_timeout_ms);
+    }
+    redisContext *context = connect_redis(node.host, node.port, options);
+    if (!context || context->err) {
+        if (context) {
+            redisFree(context);
+        }
+        node_failed(node);
+        return false;
+    }
+    if (node.ctx) {
+        redisFree(node.ctx);
+    }
+    node.ctx = context;
+    std::lock_guard<std::mutex> guard(mu_);
+    stats_.reconnects++;
+    return true;
+}
+
+/*
+功能：命令超时或连接出错后调用：把连接标记为失效，在退避间隔之后由 prepare_node 重连，连续失败时间隔加倍。
+*/
+void UnlockSender::node_failed(Node &node) {
+    if (node.ctx && node.ctx->err == 0) {
+        node.ctx->err = REDIS_ERR_OTHER;
+        snprintf(node.ctx->errstr, sizeof(node.ctx->errstr), "command failed");
+    }
+    int delay = node.reconnect_delay_ms > 0 ? node.reconnect_delay_ms : RECONNECT_DELAY_MS;
+    node.reconnect_at_ms = steady_ms() + delay;
+    node.reconnect_delay_ms = std::min(delay * 2, MAX_RECONNECT_DELAY_MS);
+    std::lock_guard<std::mutex> guard(mu_);
+    stats_.node_errors++;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "InlineString.h"
+#include "RespEncoder.h"
+#include "ServerOptions.h"
+#include <hiredis/hiredis.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 异步解锁发送器：调用线程只把解锁请求放进队列就返回，后台线程按节点攒批，
+// 每个节点每批只发送一条多 key 解锁脚本，并且所有节点流水线执行。
+// 发送器持有自己的连接（hiredis 连接不能跨线程共享），可以被多个 RedLock 实例/多个线程共享，
+// 这样来自不同线程的解锁请求会在同一个节点上合并成一批。
+// 不需要显式攒批的定时器：一批在途时新到的请求自然累积为下一批。
+// 连接出错或命令超时后按退避间隔重连（与 LockBatcher 相同），一个卡住的节点最多拖住一批一个命令超时。
+class UnlockSender{
+public:
+    // 解锁完成回调：ok 为 true 表示在多数派节点上确认删除了锁（在发送线程中调用，应尽快返回）
+    typedef std::function<void(bool ok)> Callback;
+
+    // 累计统计
+    struct Stats{
+        uint64_t requests = 0;  // 处理的解锁请求数
+        uint64_t batches = 0;   // 后台线程的发送轮次
+        uint64_t commands = 0;  // 发往Redis的解锁脚本条数
+        uint64_t failures = 0;  // 未能在多数派节点上确认删除的请求数
+        uint64_t node_errors = 0;  // 命令超时或连接出错的次数
+        uint64_t reconnects = 0;   // 重连成功的次数
+    };
+
+    // command_timeout_ms：节点没有设置 command_timeout_ms 时使用的命令超时（等待解锁结果的调用方不能被卡住的节点无限拖住）
+    explicit UnlockSender(size_t max_batch = 256, int command_timeout_ms = 1000);
+    // 发送完队列中剩余的请求后退出后台线程并关闭连接
+    ~UnlockSender();
+
+    UnlockSender(const UnlockSender &) = delete;
+    UnlockSender &operator=(const UnlockSender &) = delete;
+
+    // 注册一个节点（相同地址只连接一次），返回节点编号。连接失败时填写 err，节点仍然登记，
+    // 由后台线程按退避间隔重连（在此之前发往该节点的解锁视为失败）
+    int add_node(const std::string &host, int port, const ServerOptions &options, std::string &err);
+
+    // 注册一个节点组（节点编号列表 + 多数派节点数），返回组编号
+    int add_group(const std::vector<int> &nodes, int quorum);
+
+    // 提交一个解锁请求（线程安全，不做网络 I/O）
+    void submit(int group, const char *resource, size_t resource_len, const char *token, size_t token_len, Callback done);
+
+    // 等待提交到此刻为止的请求全部处理完
+    void flush();
+
+    Stats stats() const;
+
+private:
+    static constexpr size_t RESOURCE_INLINE = 64;
+    static constexpr size_t TOKEN_INLINE = 40;
+
+    struct Request{
+        int group;
+        InlineString<RESOURCE_INLINE> resource;
+        InlineString<TOKEN_INLINE> token;
+        Callback done;
+        int released;  // 确认删除的节点数
+        int quorum;    // 所在组的多数派节点数（发送时填写）
+    };
+
+    struct Node{
+        std::string endpoint;          // host:port 或 Unix 域套接字路径（用于去重）
+        std::string host;
+        int port = 0;
+        ServerOptions options;
+        redisContext *ctx = nullptr;   // 为空或 err 非 0 时连接失效，等待重连
+        RespEncoder cmd;
+        std::vector<size_t> requests;  // 本轮发往该节点的请求下标
+        size_t sent = 0;               // 本轮追加的脚本条数
+        int64_t reconnect_at_ms = 0;   // 连接失效后最早的重连时间（steady_clock 毫秒）
+        int reconnect_delay_ms = 0;    // 下一次重连失败后的退避间隔（毫秒）
+    };
+
+    struct Group{
+        std::vector<int> nodes;
+        int quorum;
+    };
+
+    void run();
+    void send_batch(std::vector<Request> &batch);
+    bool prepare_node(Node &node);
+    void node_failed(Node &node);
+
+    static constexpr int RECONNECT_DELAY_MS = 200;       // 首次重连间隔
+    static constexpr int MAX_RECONNECT_DELAY_MS = 5000;  // 重连间隔上限
+
+    size_t max_batch_;
+    int command_timeout_ms_;
+    mutable std::mutex mu_;            // 保护队列、计数与统计
+    std::mutex reg_mu_;                // 保护 nodes_ / groups_（注册时追加，后台线程发送期间持有）
+    std::condition_variable cv_;       // 有新请求 / 需要退出
+    std::condition_variable idle_cv_;  // 一轮处理完成（flush 等待）
+    std::vector<Request> queue_;       // 待发送的请求
+    uint64_t submitted_ = 0;           // 已提交的请求数
+    uint64_t completed_ = 0;           // 已处理的请求数
+    bool stop_ = false;
+    std::vector<Node> nodes_;          // 已注册的节点
+    std::vector<Group> groups_;        // 已注册的节点组
+    Stats stats_;
+    std::thread worker_;
+};
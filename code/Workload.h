@@ -0,0 +1,144 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 压测工具（redlock-loadgen）与模拟器（redlock-sim）共用的负载模型：随机分布、资源选择与延迟分位数
+
+// 可配置的随机分布（单位：毫秒），格式见 Distribution::parse
+class Distribution{
+public:
+    Distribution() : kind_(CONST), a_(0), b_(0) {}
+
+    /*
+    功能：解析分布描述字符串。
+    支持：
+    const:V          固定值 V
+    uniform:LO:HI    [LO, HI] 均匀分布
+    exp:MEAN         均值为 MEAN 的指数分布
+    normal:MEAN:SD   正态分布（截断到 ≥0）
+    pareto:MIN:ALPHA 帕累托分布（长尾持锁时间）
+    */
+    static bool parse(const std::string &spec, Distribution &out, std::string &err){
+        std::vector<std::string> parts;
+        std::stringstream ss(spec);
+        std::string item;
+        while (std::getline(ss, item, ':')) {
+            parts.push_back(item);
+        }
+        if (parts.empty()) {
+            err = "empty distribution";
+            return false;
+        }
+        std::vector<double> args;
+        for (size_t i = 1; i < parts.size(); i++) {
+            char *end = nullptr;
+            double v = strtod(parts[i].c_str(), &end);
+            if (end == parts[i].c_str() || *end != '\0' || v < 0) {
+                err = "bad number '" + parts[i] + "' in '" + spec + "'";
+                return false;
+            }
+            args.push_back(v);
+        }
+
+        const std::string &name = parts[0];
+        size_t want = 0;
+        if (name == "const") { out.kind_ = CONST; want = 1; }
+        else if (name == "uniform") { out.kind_ = UNIFORM; want = 2; }
+        else if (name == "exp") { out.kind_ = EXP; want = 1; }
+        else if (name == "normal") { out.kind_ = NORMAL; want = 2; }
+        else if (name == "pareto") { out.kind_ = PARETO; want = 2; }
+        else {
+            err = "unknown distribution '" + name + "'";
+            return false;
+        }
+        if (args.size() != want) {
+            err = "distribution '" + name + "' expects " + std::to_string(want) + " argument(s)";
+            return false;
+        }
+        out.a_ = args[0];
+        out.b_ = want > 1 ? args[1] : 0;
+        if ((out.kind_ == UNIFORM && out.b_ < out.a_) || (out.kind_ == PARETO && out.b_ <= 0)) {
+            err = "invalid parameters in '" + spec + "'";
+            return false;
+        }
+        out.spec_ = spec;
+        return true;
+    }
+
+    // 采样一个值（毫秒，≥0）；Rng 为任意满足标准库要求的随机数生成器
+    template <typename Rng>
+    double sample(Rng &rng) const{
+        switch (kind_) {
+            case CONST:
+                return a_;
+            case UNIFORM:
+                return std::uniform_real_distribution<double>(a_, b_)(rng);
+            case EXP:
+                return a_ > 0 ? std::exponential_distribution<double>(1.0 / a_)(rng) : 0;
+            case NORMAL:
+                return std::max(0.0, std::normal_distribution<double>(a_, b_)(rng));
+            case PARETO: {
+                double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+                return a_ / std::pow(1.0 - u, 1.0 / b_);
+            }
+        }
+        return 0;
+    }
+
+    const std::string &describe() const { return spec_; }
+
+private:
+    enum Kind { CONST, UNIFORM, EXP, NORMAL, PARETO };
+    Kind kind_;
+    double a_;
+    double b_;
+    std::string spec_ = "const:0";
+};
+
+// Zipf 资源选择器（预先计算累计分布，二分查找）
+class ResourcePicker{
+public:
+    ResourcePicker(int k, double s){
+        cdf_.resize(k);
+        double sum = 0;
+        for (int i = 0; i < k; i++) {
+            sum += 1.0 / std::pow(i + 1, s);
+            cdf_[i] = sum;
+        }
+        for (auto &v : cdf_) {
+            v /= sum;
+        }
+    }
+
+    template <typename Rng>
+    int pick(Rng &rng) const{
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        size_t idx = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return static_cast<int>(std::min(idx, cdf_.size() - 1));
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+// 已排序样本的 p 分位数（p 取 0..100）
+inline double percentile(const std::vector<double> &sorted, double p){
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    idx = std::min(sorted.size() - 1, idx == 0 ? 0 : idx - 1);
+    return sorted[idx];
+}
+
+inline void print_latency(const char *name, std::vector<double> &v){
+    std::sort(v.begin(), v.end());
+    printf("%-18s n=%-8zu p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f max=%.2f (ms)\n",
+           name, v.size(), percentile(v, 50), percentile(v, 90), percentile(v, 99),
+           percentile(v, 99.9), v.empty() ? 0.0 : v.back());
+}
@@ -1,4 +1,4 @@
-// g++ -o redlock RedLock.cc main.cc -lhiredis -std=c++11
+// g++ -o redlock RedLock.cc UnlockSender.cc LockBatcher.cc LockTracer.cc main.cc -lhiredis -lpthread -I../include -std=c++11
 
 #include "RedLock.h"
 #include <iostream>
@@ -19,12 +19,15 @@ int main() {
 
     while (true) {
         std::cout << "Attempting to acquire lock...\n";
-        Lock mtx;
-        if (redlock.lock("my_resource", 10000, mtx)) {
-            std::cout << "Lock acquired. Validity: " << mtx.valid_time_ << "ms\n";
-            // 执行业务逻辑...
-            std::this_thread::sleep_for(std::chrono::seconds(10));
-            redlock.unlock(mtx);
+        // 持锁执行：执行期间自动续锁，结束后释放；续锁失败时 token 被取消
+        LockRunStatus status = redlock.run_locked("my_resource", 10000, [](const CancelToken &token) {
+            std::cout << "Lock acquired.\n";
+            // 执行业务逻辑...（用 wait_for 代替 sleep，锁不可靠时提前结束）
+            if (token.wait_for(std::chrono::seconds(10))) {
+                std::cerr << "Lock lost, stopping early.\n";
+            }
+        });
+        if (status != LockRunStatus::NotAcquired) {
             std::this_thread::sleep_for(std::chrono::seconds(1));
         } else {
             std::cerr << "Failed to acquire lock. Retrying...\n";
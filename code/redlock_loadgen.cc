@@ -0,0 +1,387 @@
+// g++ -o redlock-loadgen RedLock.cc UnlockSender.cc LockBatcher.cc LockTracer.cc HostLockTable.cc redlock_loadgen.cc -lhiredis -lpthread -lrt -I../include -std=c++11
+//
+// RedLock 竞争压测工具：模拟 M 个客户端争抢 K 个资源，输出获取延迟分位数、
+// 每次成功的重试次数、每次成功的Redis命令数、客户端公平性（Jain指数）以及租约丢失次数。
+//
+// 用法示例：
+//   ./redlock-loadgen --servers 127.0.0.1:6379,127.0.0.1:6380,127.0.0.1:6381
+//       --clients 32 --resources 4 --duration 30
+//       --hold exp:20 --arrival uniform:0:50 --ttl const:200 --retry-count 3 --retry-delay 50
+
+#include "HostLockTable.h"
+#include "RedLock.h"
+#include "Workload.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// 压测配置
+struct LoadConfig{
+    std::vector<std::pair<std::string, int>> servers;  // Redis 节点
+    int groups = 1;                  // 把节点按顺序均分为几个独立的多数派组（资源按一致性哈希路由）
+    int clients = 8;                 // 并发客户端数（每个客户端一个线程 + 独立的RedLock实例）
+    int resources = 1;               // 资源数
+    double zipf = 0;                 // 资源选择的Zipf指数（0表示均匀）
+    int duration_s = 10;             // 压测时长（秒）
+    int retry_count = 3;             // RedLock 重试次数
+    int retry_delay_ms = 200;        // RedLock 重试间隔上限
+    bool async_unlock = false;       // 是否通过共享的后台发送器异步解锁
+    bool batched_io = false;         // 是否通过共享的加锁 I/O 线程发送（各客户端的请求按节点合并）
+    int profile_top = 0;             // 大于0时打印竞争最激烈的前 K 个资源
+    std::string host_table;          // 非空时各客户端经该共享内存锁表加解锁（本机排队、令牌交接）
+    std::string trace_path;          // 非空时记录加锁调用的追踪并在结束时写出（Chrome trace-event JSON）
+    double trace_rate = 0.01;        // 追踪的采样比例
+    int trace_slow_ms = 0;           // 大于0时耗时达到该值的调用总会保留
+    std::string prefix = "loadgen:"; // 资源名前缀
+    Distribution ttl;                // 锁TTL分布
+    Distribution hold;               // 持锁时间分布
+    Distribution arrival;            // 同一客户端相邻两次请求的到达间隔分布
+};
+
+// 单个客户端的统计结果
+struct ClientResult{
+    uint64_t requests = 0;            // 发起的 lock() 次数
+    uint64_t acquired = 0;            // 成功获取次数
+    uint64_t lost_leases = 0;         // 持锁时间超过有效期（租约丢失）的次数
+    uint64_t connect_errors = 0;      // 连接失败的节点数（多组时为未能加入的组数）
+    RedLockStats stats;               // RedLock 内部统计
+    std::vector<double> acquire_ms;   // 成功获取的耗时
+    std::vector<double> fail_ms;      // 放弃获取的耗时
+};
+
+static double now_ms(){
+    using namespace std::chrono;
+    return duration_cast<duration<double, std::milli>>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 单个客户端的压测循环
+static void run_client(int id, const LoadConfig &cfg, const ResourcePicker &picker,
+                       const std::shared_ptr<UnlockSender> &sender, const std::shared_ptr<LockBatcher> &batcher,
+                       const std::shared_ptr<ContentionProfiler> &profiler, const std::shared_ptr<LockTracer> &tracer,
+                       HostLockTable *table, const std::atomic<bool> &stop, ClientResult &result){
+    RedLock redlock;
+    redlock.set_retry_count(cfg.retry_count);
+    redlock.set_retry_delay(cfg.retry_delay_ms);
+    // 单组时逐个添加（个别节点不可用时其余节点仍然加入）；多组时整组加入
+    if (cfg.groups == 1) {
+        for (const auto &s : cfg.servers) {
+            std::string err;
+            if (!redlock.add_server(s.first, s.second, err)) {
+                result.connect_errors++;
+            }
+        }
+    } else {
+        size_t per_group = cfg.servers.size() / cfg.groups;
+        for (int g = 0; g < cfg.groups; g++) {
+            std::string err;
+            std::vector<std::pair<std::string, int>> group(cfg.servers.begin() + g * per_group,
+                                                           cfg.servers.begin() + (g + 1) * per_group);
+            if (!redlock.add_server_group(group, err)) {
+                result.connect_errors++;
+            }
+        }
+    }
+
+    if (sender) {
+        redlock.set_unlock_sender(sender);  // 所有客户端共享一个发送器，解锁请求跨线程合并
+    }
+    if (batcher) {
+        redlock.set_batcher(batcher);  // 所有客户端共享一个 I/O 线程，并发的加锁轮次按节点合并
+    }
+    redlock.set_profiler(profiler);  // 所有客户端共享一个分析器
+    redlock.set_tracer(tracer);
+
+    std::mt19937_64 rng(std::random_device{}() ^ (static_cast<uint64_t>(id) << 32));
+    double next_arrival = now_ms() + cfg.arrival.sample(rng);
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        // 按到达间隔调度下一次请求（落后时立即发起）
+        double wait = next_arrival - now_ms();
+        if (wait > 0) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(wait));
+        }
+        next_arrival += cfg.arrival.sample(rng);
+        if (stop.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        std::string resource = cfg.prefix + std::to_string(picker.pick(rng));
+        int ttl = std::max(1, static_cast<int>(cfg.ttl.sample(rng)));
+        double hold = cfg.hold.sample(rng);
+
+        Lock lock;
+        result.requests++;
+        double start = now_ms();
+        bool ok = table ? table->lock(redlock, resource, ttl, lock) : redlock.lock(resource, ttl, lock);
+        double acquired_at = now_ms();
+        if (!ok) {
+            result.fail_ms.push_back(acquired_at - start);
+            continue;
+        }
+        result.acquired++;
+        result.acquire_ms.push_back(acquired_at - start);
+
+        // 模拟业务执行；若持锁时间超过有效期，则视为租约丢失
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(hold));
+        if (now_ms() - acquired_at > lock.valid_time_) {
+            result.lost_leases++;
+        }
+        if (table) {
+            table->unlock(redlock, lock);  // 有本机等待者时交接令牌，否则同步释放
+        } else if (sender) {
+            redlock.unlock_async(lock);
+        } else {
+            redlock.unlock(lock);
+        }
+    }
+    result.stats = redlock.stats();
+}
+
+// Jain 公平性指数：(Σx)^2 / (n·Σx^2)，1 表示完全公平，1/n 表示完全不公平
+static double jain_index(const std::vector<double> &xs){
+    double sum = 0, sq = 0;
+    for (double x : xs) {
+        sum += x;
+        sq += x * x;
+    }
+    if (xs.empty() || sq == 0) {
+        return 0;
+    }
+    return sum * sum / (xs.size() * sq);
+}
+
+static void report(const LoadConfig &cfg, std::vector<ClientResult> &results, double elapsed_s){
+    ClientResult total;
+    std::vector<double> per_client;
+    for (auto &r : results) {
+        total.requests += r.requests;
+        total.acquired += r.acquired;
+        total.lost_leases += r.lost_leases;
+        total.connect_errors += r.connect_errors;
+        total.stats.lock_calls += r.stats.lock_calls;
+        total.stats.lock_attempts += r.stats.lock_attempts;
+        total.stats.redis_ops += r.stats.redis_ops;
+        total.stats.node_errors += r.stats.node_errors;
+        total.stats.skipped_nodes += r.stats.skipped_nodes;
+        total.stats.reconnects += r.stats.reconnects;
+        total.acquire_ms.insert(total.acquire_ms.end(), r.acquire_ms.begin(), r.acquire_ms.end());
+        total.fail_ms.insert(total.fail_ms.end(), r.fail_ms.begin(), r.fail_ms.end());
+        per_client.push_back(static_cast<double>(r.acquired));
+    }
+
+    double succ = total.acquired ? static_cast<double>(total.acquired) : 1.0;
+    printf("servers=%zu groups=%d clients=%d resources=%d zipf=%.2f retry_count=%d retry_delay=%dms\n",
+           cfg.servers.size(), cfg.groups, cfg.clients, cfg.resources, cfg.zipf, cfg.retry_count, cfg.retry_delay_ms);
+    printf("ttl=%s hold=%s arrival=%s duration=%.1fs\n",
+           cfg.ttl.describe().c_str(), cfg.hold.describe().c_str(), cfg.arrival.describe().c_str(), elapsed_s);
+    if (total.connect_errors) {
+        printf("connect errors      %llu\n", (unsigned long long)total.connect_errors);
+    }
+    printf("requests            %llu\n", (unsigned long long)total.requests);
+    printf("acquired            %llu (%.1f%%, %.1f/s)\n", (unsigned long long)total.acquired,
+           total.requests ? 100.0 * total.acquired / total.requests : 0.0, total.acquired / elapsed_s);
+    printf("gave up             %llu\n", (unsigned long long)(total.requests - total.acquired));
+    printf("retries/success     %.3f\n",
+           static_cast<double>(total.stats.lock_attempts - total.stats.lock_calls) / succ);
+    printf("redis ops/success   %.3f\n", total.stats.redis_ops / succ);
+    if (total.stats.node_errors || total.stats.skipped_nodes) {
+        printf("node errors         %llu (skipped %llu, reconnects %llu)\n", (unsigned long long)total.stats.node_errors,
+               (unsigned long long)total.stats.skipped_nodes, (unsigned long long)total.stats.reconnects);
+    }
+    printf("lost leases         %llu\n", (unsigned long long)total.lost_leases);
+    print_latency("acquire latency", total.acquire_ms);
+    print_latency("give-up latency", total.fail_ms);
+
+    std::sort(per_client.begin(), per_client.end());
+    printf("fairness (Jain)     %.4f  per-client acquired min=%.0f median=%.0f max=%.0f\n",
+           jain_index(per_client), per_client.empty() ? 0.0 : per_client.front(),
+           percentile(per_client, 50), per_client.empty() ? 0.0 : per_client.back());
+}
+
+static void print_profile(const ContentionProfiler &profiler, int k){
+    printf("\n%-24s %10s %8s %8s %8s %8s %10s %10s\n", "resource", "attempts", "fail%", "acq", "gaveup", "released", "wait/req", "hold/rel");
+    for (const auto &e : profiler.top(static_cast<size_t>(k))) {
+        uint64_t requests = e.acquired + e.gave_up;
+        printf("%-24s %10llu %7.1f%% %8llu %8llu %8llu %8.2fms %8.2fms\n", e.resource.c_str(), (unsigned long long)e.attempts,
+               e.attempts > e.error ? 100.0 * e.failures / (e.attempts - e.error) : 0.0, (unsigned long long)e.acquired,
+               (unsigned long long)e.gave_up, (unsigned long long)e.released,
+               requests ? static_cast<double>(e.wait_ms) / requests : 0.0, e.released ? static_cast<double>(e.hold_ms) / e.released : 0.0);
+    }
+}
+
+static void usage(const char *prog){
+    fprintf(stderr,
+        "usage: %s --servers host:port[,host:port...] [options]\n"
+        "  --groups G         split servers into G independent quorum groups (default 1)\n"
+        "  --clients N        concurrent clients (default 8)\n"
+        "  --resources K      number of contended resources (default 1)\n"
+        "  --zipf S           zipf exponent for resource choice, 0 = uniform (default 0)\n"
+        "  --duration SEC     run time in seconds (default 10)\n"
+        "  --ttl DIST         lock ttl in ms (default const:1000)\n"
+        "  --hold DIST        hold time in ms (default exp:10)\n"
+        "  --arrival DIST     per-client inter-arrival time in ms (default exp:10)\n"
+        "  --retry-count N    RedLock retry count (default 3)\n"
+        "  --retry-delay MS   RedLock max retry delay (default 200)\n"
+        "  --prefix STR       resource key prefix (default loadgen:)\n"
+        "  --unlock MODE      sync | async (async: one shared background sender batches releases)\n"
+        "  --io MODE          direct | batched (batched: one shared I/O thread pipelines all clients' rounds)\n"
+        "  --host-table NAME  queue clients on the shared-memory HostLockTable NAME (e.g. /redlock-table) and hand\n"
+        "                     leases over locally; processes using the same NAME share it (--unlock is ignored)\n"
+        "  --profile K        print the K most contended resources\n"
+        "  --trace FILE       write sampled lock traces to FILE (Chrome trace JSON, open in ui.perfetto.dev)\n"
+        "  --trace-rate R     fraction of calls traced (default 0.01)\n"
+        "  --trace-slow MS    always keep traces of calls taking at least MS\n"
+        "DIST: const:V | uniform:LO:HI | exp:MEAN | normal:MEAN:SD | pareto:MIN:ALPHA\n",
+        prog);
+}
+
+static bool parse_servers(const std::string &list, LoadConfig &cfg){
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t pos = item.rfind(':');
+        if (pos == std::string::npos) {
+            return false;
+        }
+        int port = atoi(item.c_str() + pos + 1);
+        if (port <= 0) {
+            return false;
+        }
+        cfg.servers.push_back(std::make_pair(item.substr(0, pos), port));
+    }
+    return !cfg.servers.empty();
+}
+
+int main(int argc, char **argv){
+    LoadConfig cfg;
+    std::string err;
+    Distribution::parse("const:1000", cfg.ttl, err);
+    Distribution::parse("exp:10", cfg.hold, err);
+    Distribution::parse("exp:10", cfg.arrival, err);
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-h" || opt == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string val = argv[++i];
+        bool ok = true;
+        if (opt == "--servers") ok = parse_servers(val, cfg);
+        else if (opt == "--groups") ok = (cfg.groups = atoi(val.c_str())) > 0;
+        else if (opt == "--clients") ok = (cfg.clients = atoi(val.c_str())) > 0;
+        else if (opt == "--resources") ok = (cfg.resources = atoi(val.c_str())) > 0;
+        else if (opt == "--zipf") ok = (cfg.zipf = atof(val.c_str())) >= 0;
+        else if (opt == "--duration") ok = (cfg.duration_s = atoi(val.c_str())) > 0;
+        else if (opt == "--retry-count") ok = (cfg.retry_count = atoi(val.c_str())) >= 0;
+        else if (opt == "--retry-delay") ok = (cfg.retry_delay_ms = atoi(val.c_str())) >= 0;
+        else if (opt == "--prefix") cfg.prefix = val;
+        else if (opt == "--unlock") ok = (cfg.async_unlock = (val == "async")) || val == "sync";
+        else if (opt == "--io") ok = (cfg.batched_io = (val == "batched")) || val == "direct";
+        else if (opt == "--host-table") ok = !(cfg.host_table = val).empty();
+        else if (opt == "--profile") ok = (cfg.profile_top = atoi(val.c_str())) > 0;
+        else if (opt == "--trace") ok = !(cfg.trace_path = val).empty();
+        else if (opt == "--trace-rate") ok = (cfg.trace_rate = atof(val.c_str())) >= 0 && cfg.trace_rate <= 1;
+        else if (opt == "--trace-slow") ok = (cfg.trace_slow_ms = atoi(val.c_str())) > 0;
+        else if (opt == "--ttl") ok = Distribution::parse(val, cfg.ttl, err);
+        else if (opt == "--hold") ok = Distribution::parse(val, cfg.hold, err);
+        else if (opt == "--arrival") ok = Distribution::parse(val, cfg.arrival, err);
+        else {
+            fprintf(stderr, "unknown option %s\n", opt.c_str());
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "invalid value for %s: %s %s\n", opt.c_str(), val.c_str(), err.c_str());
+            return 1;
+        }
+    }
+    if (cfg.servers.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (cfg.servers.size() % cfg.groups != 0) {
+        fprintf(stderr, "--groups %d does not divide %zu servers evenly\n", cfg.groups, cfg.servers.size());
+        return 1;
+    }
+
+    FlightRecorder::install_signal_handlers();  // 崩溃时把最近的锁操作写到标准错误
+    ResourcePicker picker(cfg.resources, cfg.zipf);
+    std::atomic<bool> stop(false);
+    std::vector<ClientResult> results(cfg.clients);
+    std::shared_ptr<UnlockSender> sender;
+    if (cfg.async_unlock) {
+        sender = std::make_shared<UnlockSender>();
+    }
+    std::shared_ptr<LockBatcher> batcher;
+    if (cfg.batched_io) {
+        batcher = std::make_shared<LockBatcher>();
+    }
+    std::shared_ptr<ContentionProfiler> profiler;
+    if (cfg.profile_top > 0) {
+        profiler = std::make_shared<ContentionProfiler>();
+    }
+    std::unique_ptr<HostLockTable> table;
+    if (!cfg.host_table.empty()) {
+        table = HostLockTable::open(cfg.host_table, err);
+        if (!table) {
+            fprintf(stderr, "host table %s: %s\n", cfg.host_table.c_str(), err.c_str());
+            return 1;
+        }
+    }
+    std::shared_ptr<LockTracer> tracer;
+    if (!cfg.trace_path.empty()) {
+        TraceOptions options;
+        options.sample_rate = cfg.trace_rate;
+        options.slow_ms = cfg.trace_slow_ms;
+        tracer = std::make_shared<LockTracer>(options);
+    }
+    std::vector<std::thread> threads;
+    double start = now_ms();
+    for (int i = 0; i < cfg.clients; i++) {
+        threads.emplace_back(run_client, i, std::cref(cfg), std::cref(picker), std::cref(sender), std::cref(batcher), std::cref(profiler),
+                             std::cref(tracer), table.get(), std::cref(stop), std::ref(results[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(cfg.duration_s));
+    stop.store(true);
+    for (auto &t : threads) {
+        t.join();
+    }
+    if (sender) {
+        sender->flush();
+    }
+    report(cfg, results, (now_ms() - start) / 1000.0);
+    if (batcher) {
+        LockBatcher::Stats st = batcher->stats();
+        printf("batched io: %llu requests in %llu rounds (%.1f per round), %llu node errors\n",
+               static_cast<unsigned long long>(st.requests), static_cast<unsigned long long>(st.batches),
+               st.batches ? static_cast<double>(st.requests) / st.batches : 0.0, static_cast<unsigned long long>(st.node_errors));
+    }
+    if (table) {
+        HostLockTable::Stats st = table->stats();
+        printf("host table: %llu local handoffs, %llu redis acquires, %llu redis releases, %llu bypassed\n",
+               static_cast<unsigned long long>(st.local_handoffs), static_cast<unsigned long long>(st.redis_acquires),
+               static_cast<unsigned long long>(st.redis_releases), static_cast<unsigned long long>(st.bypassed));
+    }
+    if (profiler) {
+        print_profile(*profiler, cfg.profile_top);
+    }
+    if (tracer) {
+        if (tracer->dump(cfg.trace_path, err)) {
+            printf("trace: %zu events written to %s\n", tracer->event_count(), cfg.trace_path.c_str());
+        } else {
+            fprintf(stderr, "trace: %s\n", err.c_str());
+        }
+    }
+    return 0;
+}
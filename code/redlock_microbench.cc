@@ -0,0 +1,368 @@
+// g++ -O2 -o redlock-microbench redlock_microbench.cc ../redlock-cpp/sds.c -I.. -I../include -I../redlock-cpp -lhiredis -std=c++11
+//
+// 客户端 CPU 开销微基准：逐项测量一次锁操作在客户端一侧的花费（不访问网络），
+// 用来判断瓶颈在客户端还是在 Redis。每项输出：
+//   ns/op      单次耗时
+//   allocs/op  单次堆分配次数（malloc/calloc/realloc，含 hiredis、sds 与 operator new）
+//   instr/op   单次用户态指令数（perf_event_open；内核不允许时显示 -）
+//
+// 用法：
+//   ./redlock-microbench                    全部测试项
+//   ./redlock-microbench --filter reply     名称包含 reply 的测试项
+//   ./redlock-microbench --min-time 500     每项至少运行 500ms（默认 200ms）
+
+#include "FlightRecorder.h"
+#include "Lock.h"
+#include "LockRegistry.h"
+#include "LockScripts.h"
+#include "RespEncoder.h"
+#include "RetryPolicy.h"
+#include "TokenGenerator.h"
+#include "redlock.h"  // LOCK_ID_LEN 与 sds（只用到头文件）
+#include <hiredis/hiredis.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ---------------- 分配计数：替换 malloc 系列，转发给 glibc 的实现 ----------------
+static uint64_t g_allocs = 0;  // 单线程基准，不需要原子操作
+
+#if defined(__GLIBC__)
+#define MICROBENCH_COUNT_ALLOCS 1
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+    g_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    g_allocs++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+    g_allocs++;
+    return __libc_realloc(p, size);
+}
+}
+#endif
+
+// ---------------- 指令计数：perf_event_open，只统计本线程的用户态指令 ----------------
+static int open_instruction_counter(){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return fd;
+}
+
+static uint64_t read_counter(int fd){
+    uint64_t v = 0;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != static_cast<ssize_t>(sizeof(v))) {
+        return 0;
+    }
+    return v;
+}
+
+// 阻止编译器把基准中的结果优化掉
+template <typename T>
+static inline void keep(const T &v){
+    asm volatile("" : : "r,m"(v) : "memory");
+}
+
+static double now_ns(){
+    using namespace std::chrono;
+    return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+struct BenchOptions{
+    std::string filter;      // 只运行名称包含该子串的测试项
+    double min_time_ms = 200;
+    int perf_fd = -1;
+};
+
+/*
+功能：运行一个测试项。body(n) 执行 n 次被测操作（循环写在 body 里，避免每次迭代的间接调用）。
+先以 10 倍递增的次数试跑到 10ms 以上，按耗时估算出满足 min_time_ms 的次数，再正式运行一次并统计。
+*/
+template <typename Body>
+static void run(const BenchOptions &opt, const char *name, Body body){
+    if (!opt.filter.empty() && strstr(name, opt.filter.c_str()) == nullptr) {
+        return;
+    }
+    uint64_t n = 1;
+    double elapsed = 0;
+    for (;;) {
+        double start = now_ns();
+        body(n);
+        elapsed = now_ns() - start;
+        if (elapsed >= 10e6 || n >= (uint64_t(1) << 40)) {
+            break;
+        }
+        n *= 10;
+    }
+    n = std::max<uint64_t>(1, static_cast<uint64_t>(n * (opt.min_time_ms * 1e6 / std::max(elapsed, 1.0))));
+
+    uint64_t allocs = g_allocs;
+    uint64_t instructions = read_counter(opt.perf_fd);
+    double start = now_ns();
+    body(n);
+    double ns = now_ns() - start;
+    instructions = read_counter(opt.perf_fd) - instructions;
+    allocs = g_allocs - allocs;
+
+    char instr[32] = "-";
+    if (opt.perf_fd >= 0) {
+        snprintf(instr, sizeof(instr), "%.0f", static_cast<double>(instructions) / n);
+    }
+#ifdef MICROBENCH_COUNT_ALLOCS
+    printf("%-28s %10.1f %10.2f %10s\n", name, ns / n, static_cast<double>(allocs) / n, instr);
+#else
+    printf("%-28s %10.1f %10s %10s\n", name, ns / n, "-", instr);
+#endif
+}
+
+// 解析一段完整的回复并释放（与 redisGetReply 读到数据后的路径相同）
+static void parse_reply(redisReader *reader, const std::string &wire){
+    void *reply = nullptr;
+    redisReaderFeed(reader, wire.data(), wire.size());
+    redisReaderGetReply(reader, &reply);
+    keep(reply);
+    freeReplyObject(reply);
+}
+
+// 改为 RespEncoder 之前 CRedLock::RedisCommandArgv 的编码路径：每个参数 sdsnew 一份，
+// 另分配长度数组，再由 hiredis 格式化为 RESP（redisCommandArgv 内部的 redisFormatCommandArgv）
+static void encode_argv_sds(int argc, char **args){
+    char **argv = static_cast<char **>(malloc(sizeof(char *) * argc));
+    size_t *argvlen = static_cast<size_t *>(malloc(argc * sizeof(size_t)));
+    for (int j = 0; j < argc; j++) {
+        argv[j] = sdsnew(args[j]);
+        argvlen[j] = sdslen(argv[j]);
+    }
+    char *cmd = nullptr;
+    int len = redisFormatCommandArgv(&cmd, argc, const_cast<const char **>(argv), argvlen);
+    keep(len);
+    redisFreeCommand(cmd);
+    for (int j = 0; j < argc; j++) {
+        sdsfree(argv[j]);
+    }
+    free(argvlen);
+    free(argv);
+}
+
+static void usage(const char *prog){
+    fprintf(stderr, "usage: %s [--filter SUBSTR] [--min-time MS]\n", prog);
+}
+
+int main(int argc, char **argv){
+    BenchOptions opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            opt.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            opt.min_time_ms = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    opt.perf_fd = open_instruction_counter();
+    printf("%-28s %10s %10s %10s\n", "benchmark", "ns/op", "allocs/op", "instr/op");
+
+    // 与 RedLock 相同的脚本（决定了每条命令的编码长度）
+    const std::string &acquire = acquire_script();
+    const std::string &unlock = unlock_script();
+    Lock lock;
+    lock.resource_.assign("orders:12345", 12);
+    char token[LOCK_TOKEN_LEN + 1];
+    TokenGenerator::local().next_hex(token);
+    lock.value_.assign(token, TOKEN_HEX_LEN);
+
+    // ---------------- 令牌生成 ----------------
+    run(opt, "token/hex (RedLock)", [](uint64_t n) {  // generate_unique_id
+        char buf[LOCK_TOKEN_LEN];
+        InlineString<LOCK_TOKEN_LEN> out;
+        for (uint64_t i = 0; i < n; i++) {
+            size_t len = TokenGenerator::local().next(TokenFormat::Hex, buf);
+            out.assign(buf, len);
+            keep(out);
+        }
+    });
+    run(opt, "token/binary (RedLock)", [](uint64_t n) {
+        char buf[LOCK_TOKEN_LEN];
+        InlineString<LOCK_TOKEN_LEN> out;
+        for (uint64_t i = 0; i < n; i++) {
+            size_t len = TokenGenerator::local().next(TokenFormat::Binary, buf);
+            out.assign(buf, len);
+            keep(out);
+        }
+    });
+    run(opt, "token/GetUniqueLockId", [](uint64_t n) {  // CRedLock::GetUniqueLockId
+        char out[LOCK_ID_LEN + 1];
+        for (uint64_t i = 0; i < n; i++) {
+            TokenGenerator::local().next_hex(out);
+            out[LOCK_ID_LEN] = '\0';
+            keep(out);
+        }
+    });
+
+    // ---------------- 命令编码 ----------------
+    RespEncoder enc;
+    run(opt, "encode/lock_instance", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            enc.eval(acquire, lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size(), 10000);
+            keep(enc.size());
+        }
+    });
+    run(opt, "encode/unlock", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            enc.eval(unlock, lock.resource_.data(), lock.resource_.size(), lock.value_.data(), lock.value_.size());
+            keep(enc.size());
+        }
+    });
+    run(opt, "encode/argv+sds (old)", [&](uint64_t n) {
+        char ttl[] = "10000";
+        char nkeys[] = "1";
+        char eval[] = "EVAL";
+        std::string resource(lock.resource_.data(), lock.resource_.size());
+        char *args[] = {eval, const_cast<char *>(acquire.c_str()), nkeys, const_cast<char *>(resource.c_str()), token, ttl};
+        for (uint64_t i = 0; i < n; i++) {
+            encode_argv_sds(6, args);
+        }
+    });
+
+    // ---------------- 回复解析 + freeReplyObject ----------------
+    redisReader *reader = redisReaderCreate();
+    std::string status_wire = "+OK\r\n";
+    std::string pttl_wire = ":4821\r\n";
+    std::string array_wire = "*256\r\n";  // release_all / continue_many 一条脚本的回复
+    for (int i = 0; i < 256; i++) {
+        array_wire += ":1\r\n";
+    }
+    run(opt, "reply/status OK", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            parse_reply(reader, status_wire);
+        }
+    });
+    run(opt, "reply/integer pttl", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            parse_reply(reader, pttl_wire);
+        }
+    });
+    run(opt, "reply/array x256", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            parse_reply(reader, array_wire);
+        }
+    });
+    redisReaderFree(reader);
+
+    // ---------------- 有效时间计算 ----------------
+    run(opt, "validity/round math", [](uint64_t n) {  // RedLock::acquire 步骤2、3（含两次取系统时间）
+        using namespace std::chrono;
+        int ttl_ms = 10000;
+        for (uint64_t i = 0; i < n; i++) {
+            int64_t start = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+            int64_t drift = static_cast<int64_t>(ttl_ms * 0.01f) + 2;
+            int64_t elapsed = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count() - start;
+            int64_t valid = ttl_ms - elapsed - drift;
+            keep(valid);
+        }
+    });
+    run(opt, "validity/quorum_lease x5", [](uint64_t n) {
+        int64_t lease[5];
+        for (uint64_t i = 0; i < n; i++) {
+            lease[0] = 120; lease[1] = -1; lease[2] = 0; lease[3] = 80; lease[4] = 300;
+            keep(quorum_lease_ms(lease, 5, 3));
+        }
+    });
+    run(opt, "clock/steady_clock", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            keep(std::chrono::steady_clock::now());
+        }
+    });
+
+    // ---------------- 持有表 ----------------
+    LockRegistry registry;
+    run(opt, "registry/put+erase", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            registry.put(lock);
+            keep(registry.erase(lock));
+        }
+    });
+
+    // ---------------- 飞行记录器（每次锁操作结束时写入一条） ----------------
+    FlightRecorder recorder;
+    run(opt, "flight/record", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            FlightRecorder::Entry e;
+            e.op = FlightRecorder::OP_LOCK;
+            e.ok = 1;
+            e.nodes = 3;
+            e.set_node(0, FlightRecorder::NODE_OK);
+            e.set_node(1, FlightRecorder::NODE_HELD);
+            e.set_node(2, FlightRecorder::NODE_OK);
+            e.end_us = static_cast<int64_t>(i);  // RedLock 用计算耗时时已读的单调时钟填写
+            e.set_resource(lock.resource_.data(), lock.resource_.size());
+            recorder.record(e);
+        }
+    });
+
+    // ---------------- sds（redlock-cpp/sds.c） ----------------
+    run(opt, "sds/new+free 40B", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            sds s = sdsnew(token);
+            keep(s);
+            sdsfree(s);
+        }
+    });
+    run(opt, "sds/catlen resource+token", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            sds s = sdsempty();
+            s = sdscatlen(s, lock.resource_.data(), lock.resource_.size());
+            s = sdscatlen(s, ":", 1);
+            s = sdscatlen(s, token, TOKEN_HEX_LEN);
+            keep(s);
+            sdsfree(s);
+        }
+    });
+    run(opt, "sds/fromlonglong", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            sds s = sdsfromlonglong(static_cast<long long>(i));
+            keep(s);
+            sdsfree(s);
+        }
+    });
+    run(opt, "sds/catprintf ttl", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            sds s = sdscatprintf(sdsempty(), "%d", 10000);
+            keep(s);
+            sdsfree(s);
+        }
+    });
+
+    if (opt.perf_fd >= 0) {
+        close(opt.perf_fd);
+    }
+    return 0;
+}
@@ -0,0 +1,853 @@
+// g++ -O2 -o redlock-sim redlock_sim.cc -I../include -std=c++11
+//
+// RedLock 确定性离散事件模拟器：RedLockCore 的加锁逻辑运行在模拟的节点上，时间是虚拟的。
+// RedLockCore 与 RedLock 共用重试逻辑（RetryPolicy.h 的策略、retry_after_round、retry_delay_ms），默认同样按持有者租约调度；
+// 命令超时同样不超过有效期预算与截止时间，超时的命令仍可能在节点上执行（之后按结果未知释放）。
+// 与 RedLock 的差别：一轮中所有节点同时发送（没有逐个节点的多数派跳过），命令超时上限是固定的 --command-timeout，
+// 没有按节点延迟分布的自适应超时；这两点对结果的影响需要用 redlock-loadgen 对真实节点测量。
+// 可以设置每个节点的网络延迟与时钟漂移、节点宕机与重启，以及成千上万个虚拟客户端。
+// 输出吞吐量、获取延迟分位数，以及安全性违规（两个客户端同时认为自己持有同一把锁）。
+// 同一组参数与种子的结果完全相同，适合在修改漂移因子、重试间隔、节点数等参数之前先扫描一遍。
+//
+// 用法示例：
+//   ./redlock-sim --nodes 5 --clients 2000 --resources 50 --duration 120
+//       --latency exp:0.3 --clock-drift 0.02 --drift-factor 0.01 --crash-mtbf 30 --restart empty
+
+#include "RedLockCore.h"
+#include "Workload.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#if !(defined(__x86_64__) && defined(__ELF__))
+#include <ucontext.h>
+#endif
+
+#if defined(__x86_64__) && defined(__ELF__)
+// 保存被调用者保存的寄存器与栈指针到 *save_sp，切换到 load_sp 指向的栈并恢复其寄存器
+extern "C" void redlock_sim_switch(void **save_sp, void *load_sp);
+// 新协程的第一条指令：以 r12 为参数调用 r13（协程入口不会返回）
+extern "C" void redlock_sim_start();
+asm(R"(
+    .pushsection .text
+    .globl redlock_sim_switch
+    .type redlock_sim_switch, @function
+redlock_sim_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size redlock_sim_switch, .-redlock_sim_switch
+    .globl redlock_sim_start
+    .type redlock_sim_start, @function
+redlock_sim_start:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size redlock_sim_start, .-redlock_sim_start
+    .popsection
+)");
+#endif
+
+// 协程：每个虚拟客户端一个独立的栈，由调度器显式切换（单线程，没有抢占）
+// x86-64 上用几条汇编指令保存/恢复寄存器（一次切换约 10ns）；其他平台退回 ucontext（每次切换还有一次系统调用）
+class Fiber{
+public:
+    typedef void (*Entry)(void *arg);
+
+    // 在新栈上准备入口，第一次切换到该协程时调用 entry(arg)
+    void init(Entry entry, void *arg, size_t stack_size){
+        stack_.reset(new char[stack_size]);
+#if defined(__x86_64__) && defined(__ELF__)
+        // 栈顶按 16 字节对齐；redlock_sim_switch 弹出 6 个寄存器后“返回”到 redlock_sim_start，
+        // 此时栈指针为 16 的倍数，满足 call 之前的对齐要求
+        uintptr_t top = (reinterpret_cast<uintptr_t>(stack_.get()) + stack_size) & ~static_cast<uintptr_t>(15);
+        void **frame = reinterpret_cast<void **>(top - 9 * sizeof(void *));
+        frame[0] = nullptr;                             // r15
+        frame[1] = nullptr;                             // r14
+        frame[2] = reinterpret_cast<void *>(entry);     // r13
+        frame[3] = arg;                                 // r12
+        frame[4] = nullptr;                             // rbx
+        frame[5] = nullptr;                             // rbp
+        frame[6] = reinterpret_cast<void *>(&redlock_sim_start);
+        sp_ = frame;
+#else
+        entry_ = entry;
+        arg_ = arg;
+        getcontext(&ctx_);
+        ctx_.uc_stack.ss_sp = stack_.get();
+        ctx_.uc_stack.ss_size = stack_size;
+        ctx_.uc_link = nullptr;
+        makecontext(&ctx_, &Fiber::trampoline, 0);
+#endif
+    }
+
+    // 挂起 from（保存到 from），运行 to
+    static void jump(Fiber &from, Fiber &to){
+#if defined(__x86_64__) && defined(__ELF__)
+        redlock_sim_switch(&from.sp_, to.sp_);
+#else
+        starting_ = &to;
+        swapcontext(&from.ctx_, &to.ctx_);
+#endif
+    }
+
+private:
+    std::unique_ptr<char[]> stack_;  // 调度器自身的 Fiber 没有栈
+#if defined(__x86_64__) && defined(__ELF__)
+    void *sp_ = nullptr;             // 挂起时的栈指针
+#else
+    static void trampoline() { starting_->entry_(starting_->arg_); }
+
+    static Fiber *starting_;
+    ucontext_t ctx_;
+    Entry entry_ = nullptr;
+    void *arg_ = nullptr;
+#endif
+};
+#if !(defined(__x86_64__) && defined(__ELF__))
+Fiber *Fiber::starting_ = nullptr;
+#endif
+
+// 事件类型
+enum EventKind{
+    EV_WAKE = 0,     // 恢复客户端协程（睡眠结束或本轮回复全部到达）；编号为客户端下标
+    EV_EXEC = 1,     // 命令到达节点并执行；编号为 客户端下标 × 节点数 + 节点下标
+    EV_CRASH = 2,    // 节点宕机；编号为节点下标
+    EV_RESTART = 3,  // 节点重启
+};
+
+// 事件：按 (时间, 序号) 排序，同一时刻的事件按产生的先后处理，结果只取决于参数与种子
+struct SimEvent{
+    int64_t t;     // 虚拟时间（微秒）
+    uint64_t tag;  // 序号 << 24 | 类型 << 22 | 编号
+    bool operator>(const SimEvent &o) const { return t != o.t ? t > o.t : tag > o.tag; }
+};
+
+// 模拟用的随机数（splitmix64）：状态只有 8 字节，成千上万个客户端各持一个也不占缓存；
+// 满足标准库的随机数生成器要求，可用于 std 的分布与 RedLockCore 的 Rng
+struct SimRng{
+    typedef uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit SimRng(uint64_t seed = 0) : state(seed) {}
+
+    result_type operator()(){
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state;
+};
+
+static constexpr uint32_t MAX_EVENT_ID = (1u << 22) - 1;
+static constexpr size_t FIBER_STACK = 64 * 1024;
+
+// 虚拟客户端的公共部分（调度器、时钟与传输层只用到这些）
+struct SimClient{
+    Fiber fiber;
+    uint32_t id = 0;
+    double skew = 0;        // 本地时钟速率偏差：本地时间 = 真实时间 × (1 + skew)
+    int resource = 0;       // 当前操作的资源下标（节点按下标保存 key，省去字符串哈希）
+    bool awaiting = false;  // 本轮已发出命令、尚未等待回复
+    int64_t reply_at = 0;   // 本轮最晚一条回复到达（或超时）的时间
+
+    int64_t local_us(int64_t t) const { return t + static_cast<int64_t>(t * skew); }
+};
+
+// 单线程调度器：事件堆 + 虚拟时间。客户端协程只在等待回复与睡眠时让出
+class Scheduler{
+public:
+    int64_t now_us = 0;             // 当前虚拟时间（真实时间轴）
+    SimClient *running = nullptr;   // 正在运行的客户端（调度器自身运行时为空）
+    uint64_t events = 0;            // 已处理的事件数
+
+    void push(int64_t t, EventKind kind, uint32_t id){
+        heap_.push_back(SimEvent{t, (seq_++ << 24) | (static_cast<uint64_t>(kind) << 22) | id});
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<SimEvent>());
+    }
+
+    bool pop(SimEvent &e){
+        if (heap_.empty()) {
+            return false;
+        }
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<SimEvent>());
+        e = heap_.back();
+        heap_.pop_back();
+        events++;
+        return true;
+    }
+
+    // 运行客户端直到它再次让出
+    void resume(SimClient &c){
+        running = &c;
+        Fiber::jump(main_, c.fiber);
+        running = nullptr;
+    }
+
+    // 客户端让出（由已经安排好的事件恢复）
+    void block() { Fiber::jump(running->fiber, main_); }
+
+    // 客户端按本地时钟睡眠 local_us 微秒
+    void sleep_local(int64_t local_us){
+        if (local_us <= 0) {
+            return;
+        }
+        SimClient *c = running;
+        push(now_us + static_cast<int64_t>(std::ceil(local_us / (1 + c->skew))), EV_WAKE, c->id);
+        block();
+    }
+
+private:
+    std::vector<SimEvent> heap_;
+    uint64_t seq_ = 0;
+    Fiber main_;
+};
+
+static Scheduler g_sched;
+
+// 模拟时钟：虚拟时间；在客户端协程内返回该客户端的本地时钟（含漂移）
+struct SimClock{
+    typedef std::chrono::microseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<SimClock> time_point;
+    static constexpr bool is_steady = true;
+
+    static time_point now(){
+        return time_point(duration(g_sched.running ? g_sched.running->local_us(g_sched.now_us) : g_sched.now_us));
+    }
+};
+
+// RedLockCore 两轮之间的睡眠在虚拟时间上推进
+template <>
+struct ClockTraits<SimClock>{
+    template <typename Duration>
+    static void sleep_for(const Duration &d) { g_sched.sleep_local(std::chrono::duration_cast<std::chrono::microseconds>(d).count()); }
+};
+
+enum SimOp { SIM_ACQUIRE, SIM_RELEASE, SIM_EXTEND };
+
+// 模拟的 Redis 节点：按资源下标保存 key（值为持有者令牌，过期时间按节点本地时钟），可以宕机与重启
+struct SimNode{
+    struct Key{
+        InlineString<LOCK_TOKEN_LEN> token;
+        int64_t expire_local = 0;  // 本地时钟的过期时间，0 表示不存在
+    };
+
+    Distribution latency;     // 单程网络延迟（毫秒）
+    double skew = 0;          // 本地时钟速率偏差
+    bool down = false;
+    SimRng rng;               // 延迟与故障间隔的随机数
+    std::vector<Key> keys;
+    uint64_t commands = 0;    // 到达的命令数
+    uint64_t errors = 0;      // 到达时节点已宕机的命令数
+    uint64_t crashes = 0;
+    uint64_t keys_lost = 0;   // 宕机时丢失的未过期 key 数
+
+    int64_t local_us(int64_t t) const { return t + static_cast<int64_t>(t * skew); }
+
+    int64_t delay_us() { return static_cast<int64_t>(std::llround(latency.sample(rng) * 1000)); }
+
+    /*
+    功能：在真实时间 t 执行一条命令，语义与 RedLock 的脚本相同。
+    返回值：加锁成功返回 0，被占用时返回持有者剩余时间（毫秒，至少 1）；解锁/续期成功返回 1，否则返回 0。
+    */
+    int64_t execute(SimOp op, int resource, const InlineString<LOCK_TOKEN_LEN> &token, int ttl_ms, int64_t t){
+        int64_t now = local_us(t);
+        Key &k = keys[resource];
+        bool live = k.expire_local > now;
+        bool owned = live && k.token.size() == token.size() && memcmp(k.token.data(), token.data(), k.token.size()) == 0;
+        switch (op) {
+            case SIM_ACQUIRE:
+                if (live) {
+                    return std::max<int64_t>(1, (k.expire_local - now + 999) / 1000);
+                }
+                k.token.assign(token.data(), token.size());
+                k.expire_local = now + ttl_ms * 1000LL;
+                return 0;
+            case SIM_RELEASE:
+                if (owned) {
+                    k.expire_local = 0;
+                }
+                return owned ? 1 : 0;
+            case SIM_EXTEND:
+                if (owned) {
+                    k.expire_local = now + ttl_ms * 1000LL;
+                }
+                return owned ? 1 : 0;
+        }
+        return 0;
+    }
+
+    // 宕机：不持久化时丢失全部 key（重启后是空库）
+    void crash(bool persist, int64_t t){
+        down = true;
+        crashes++;
+        if (!persist) {
+            int64_t now = local_us(t);
+            for (auto &k : keys) {
+                keys_lost += k.expire_local > now;
+                k.expire_local = 0;
+            }
+        }
+    }
+};
+
+// RedLockCore 的模拟传输层（每个客户端、每个节点一个）：命令经过单程延迟到达节点后执行，回复再经过单程延迟返回。
+// 两段延迟在发送时抽样，所以发送时就知道回复何时到达：超过命令超时的命令按超时处理（结果未知），
+// 但仍会在到达时在节点上执行，与真实连接上超时的命令一样。超时后连接作废，与 RedLock 一样退避之后才重连
+// （200ms 起，连续超时加倍到 5s，见 CommandTimeoutOptions），期间发往该节点的命令写入失败。同一连接上的命令按发送顺序到达。
+// 客户端读取本轮第一条回复时让出，到最晚的回复到达（或超时）时恢复
+class SimTransport{
+public:
+    void attach(SimClient *client, SimNode *node, uint32_t id, int64_t max_timeout_us){
+        client_ = client;
+        node_ = node;
+        id_ = id;
+        max_timeout_us_ = max_timeout_us;
+    }
+
+    // 与 HiredisTransport 相同：超时不超过 --command-timeout，0 表示只受它限制
+    void set_timeout_us(int64_t us){
+        timeout_us_ = (us <= 0 || (max_timeout_us_ > 0 && us > max_timeout_us_)) ? max_timeout_us_ : us;
+    }
+
+    bool send_acquire(const Lock &lock, int ttl_ms) { return send(SIM_ACQUIRE, lock, ttl_ms); }
+    bool send_release(const Lock &lock) { return send(SIM_RELEASE, lock, 0); }
+    bool send_extend(const Lock &lock, int ttl_ms) { return send(SIM_EXTEND, lock, ttl_ms); }
+    void flush() {}
+
+    bool recv_acquire(int64_t &lease_ms){
+        int64_t r = recv();
+        lease_ms = r > 0 ? r : (r == 0 ? 0 : LEASE_UNKNOWN);
+        return r == 0;
+    }
+    bool recv_release() { return recv() == 1; }
+    bool recv_extend() { return recv() == 1; }
+
+    // 命令到达节点（EV_EXEC）：执行最早发出的在途命令；超时的命令同样执行，只是结果没有人读取
+    void execute(){
+        Command c = inflight_.front();
+        inflight_.pop_front();
+        int64_t result = -1;  // 节点已宕机：连接被重置
+        node_->commands++;
+        if (node_->down) {
+            node_->errors++;
+        } else {
+            result = node_->execute(c.op, c.resource, c.token, c.ttl_ms, g_sched.now_us);
+        }
+        if (c.seq == seq_ && !timed_out_) {
+            reply_ = result;
+        }
+    }
+
+private:
+    struct Command{
+        SimOp op;
+        int resource;
+        int ttl_ms;
+        uint64_t seq;
+        InlineString<LOCK_TOKEN_LEN> token;
+    };
+
+    // 节点已宕机或连接在超时后等待重连时不可用，写入失败（RedLockCore 跳过该节点）
+    bool send(SimOp op, const Lock &lock, int ttl_ms){
+        int64_t now = g_sched.now_us;
+        if (node_->down || now < reconnect_at_) {
+            return false;
+        }
+        int64_t arrive = std::max(now + node_->delay_us(), last_arrive_);
+        int64_t reply_at = arrive + node_->delay_us();
+        last_arrive_ = arrive;
+        timed_out_ = timeout_us_ > 0 && reply_at - now > timeout_us_;
+        if (timed_out_) {
+            reconnect_delay_us_ = reconnect_delay_us_ > 0 ? std::min(reconnect_delay_us_ * 2, MAX_RECONNECT_DELAY_US) : RECONNECT_DELAY_US;
+            reconnect_at_ = now + timeout_us_ + reconnect_delay_us_;
+        } else {
+            reconnect_delay_us_ = 0;
+        }
+        reply_ = -1;
+        inflight_.push_back(Command{op, client_->resource, ttl_ms, ++seq_, lock.value_});
+        g_sched.push(arrive, EV_EXEC, id_);
+        client_->awaiting = true;
+        client_->reply_at = std::max(client_->reply_at, timed_out_ ? now + timeout_us_ : reply_at);
+        return true;
+    }
+
+    int64_t recv(){
+        if (client_->awaiting) {
+            client_->awaiting = false;
+            g_sched.push(client_->reply_at, EV_WAKE, client_->id);
+            client_->reply_at = 0;
+            g_sched.block();
+        }
+        return timed_out_ ? -1 : reply_;
+    }
+
+    static constexpr int64_t RECONNECT_DELAY_US = 200000;
+    static constexpr int64_t MAX_RECONNECT_DELAY_US = 5000000;
+
+    SimClient *client_ = nullptr;
+    SimNode *node_ = nullptr;
+    uint32_t id_ = 0;
+    int64_t max_timeout_us_ = 0;
+    int64_t reconnect_at_ = 0;        // 超时后连接作废，到这个时间才重新可用
+    int64_t reconnect_delay_us_ = 0;  // 当前的重连退避（命令成功后清零）
+    int64_t timeout_us_ = 0;
+    std::deque<Command> inflight_;  // 已发出、尚未到达节点的命令
+    int64_t last_arrive_ = 0;       // 上一条命令到达节点的时间
+    uint64_t seq_ = 0;              // 最近一条命令的序号（只有它的结果会被读取）
+    bool timed_out_ = false;        // 最近一条命令是否超时
+    int64_t reply_ = -1;
+};
+
+// 漂移补偿（RedLockCore 的 Drift 策略）：有效期扣除 TTL × factor + 2ms。
+// 扫描参数用的运行时因子只存在于模拟器中，生产代码使用编译期的 DefaultDrift
+struct SimDrift{
+    static double factor;
+    static int64_t drift_ms(int ttl_ms) { return static_cast<int64_t>(ttl_ms * factor) + 2; }
+};
+double SimDrift::factor = 0.01;
+
+// 模拟配置
+struct SimConfig{
+    int nodes = 5;                   // 节点数（1..9）
+    int clients = 1000;              // 虚拟客户端数
+    int resources = 100;             // 资源数
+    double zipf = 0;                 // 资源选择的Zipf指数（0表示均匀）
+    double duration_s = 60;          // 虚拟时长（秒）
+    int timeout_ms = 1000;           // 获取超时：lock() 的截止时间距发起的毫秒数
+    int retry_delay_ms = 200;        // 默认重试策略的等待上限（同 RedLock::set_retry_delay）
+    std::string retry_policy = "default";        // --retry-policy 的原文
+    std::shared_ptr<const RetryPolicy> policy;   // 由 retry_policy 构造，为空时使用默认策略
+    int command_timeout_ms = 1000;   // 命令超时上限（同 ServerOptions::command_timeout_ms，0 表示只受有效期预算限制）
+    double drift_factor = 0.01;      // 漂移因子（SimDrift）
+    double clock_drift = 0;          // 每个节点与客户端的时钟速率偏差在 [-R, R] 内均匀选取
+    double crash_mtbf_s = 0;         // 每个节点平均多久宕机一次（指数分布，0 表示不宕机）
+    bool persist = false;            // 宕机后重启时是否保留 key
+    uint64_t seed = 1;               // 随机数种子
+    Distribution ttl;                // 锁TTL分布
+    Distribution hold;               // 持锁时间分布
+    Distribution arrival;            // 同一客户端相邻两次请求的到达间隔分布
+    Distribution latency;            // 单程网络延迟分布
+    Distribution downtime;           // 宕机时长分布
+    std::vector<std::pair<int, Distribution>> node_latency;  // 个别节点的延迟分布
+};
+
+static int64_t ms_to_us(double ms) { return static_cast<int64_t>(std::llround(ms * 1000)); }
+
+template <size_t N>
+class Simulation{
+public:
+    explicit Simulation(const SimConfig &cfg) : cfg_(cfg), picker_(cfg.resources, cfg.zipf), holders_(cfg.resources) {
+        SimDrift::factor = cfg.drift_factor;
+        std::mt19937_64 seeder(cfg.seed);
+        std::uniform_real_distribution<double> skew(-cfg.clock_drift, cfg.clock_drift);
+        for (size_t i = 0; i < N; i++) {
+            SimNode &node = nodes_[i];
+            node.latency = cfg.latency;
+            node.skew = skew(seeder);
+            node.rng = SimRng(seeder());
+            node.keys.resize(cfg.resources);
+        }
+        for (const auto &nl : cfg.node_latency) {
+            nodes_[nl.first].latency = nl.second;
+        }
+        for (int r = 0; r < cfg.resources; r++) {
+            names_.push_back("sim:" + std::to_string(r));
+        }
+        for (int c = 0; c < cfg.clients; c++) {
+            uint64_t core_seed = seeder();
+            std::unique_ptr<Worker> w(new Worker(this, core_seed, seeder(), cfg.retry_delay_ms));
+            w->id = static_cast<uint32_t>(c);
+            w->skew = skew(seeder);
+            w->core.set_retry_policy(cfg.policy);
+            for (size_t i = 0; i < N; i++) {
+                w->core.node(i).attach(w.get(), &nodes_[i], static_cast<uint32_t>(c * N + i), cfg.command_timeout_ms * 1000LL);
+            }
+            w->fiber.init(&Simulation::client_main, w.get(), FIBER_STACK);
+            workers_.push_back(std::move(w));
+        }
+    }
+
+    /*
+    功能：运行到虚拟时长结束。所有客户端在时间 0 启动（各自先等待一个到达间隔），
+    结束时仍在进行中的请求不计入结果（协程直接丢弃）。
+    */
+    void run(){
+        for (auto &w : workers_) {
+            g_sched.push(0, EV_WAKE, w->id);
+        }
+        if (cfg_.crash_mtbf_s > 0) {
+            for (size_t i = 0; i < N; i++) {
+                g_sched.push(next_crash(nodes_[i]), EV_CRASH, static_cast<uint32_t>(i));
+            }
+        }
+        int64_t end_us = static_cast<int64_t>(cfg_.duration_s * 1e6);
+        SimEvent e;
+        while (g_sched.pop(e) && e.t <= end_us) {
+            g_sched.now_us = e.t;
+            uint32_t id = static_cast<uint32_t>(e.tag & MAX_EVENT_ID);
+            switch (static_cast<EventKind>((e.tag >> 22) & 3)) {
+                case EV_WAKE:
+                    g_sched.resume(*workers_[id]);
+                    break;
+                case EV_EXEC:
+                    workers_[id / N]->core.node(id % N).execute();
+                    break;
+                case EV_CRASH:
+                    nodes_[id].crash(cfg_.persist, e.t);
+                    g_sched.push(e.t + ms_to_us(cfg_.downtime.sample(nodes_[id].rng)), EV_RESTART, id);
+                    break;
+                case EV_RESTART:
+                    nodes_[id].down = false;
+                    g_sched.push(next_crash(nodes_[id]), EV_CRASH, id);
+                    break;
+            }
+        }
+    }
+
+    void report(double wall_s){
+        uint64_t commands = 0, errors = 0, crashes = 0, keys_lost = 0;
+        for (const auto &node : nodes_) {
+            commands += node.commands;
+            errors += node.errors;
+            crashes += node.crashes;
+            keys_lost += node.keys_lost;
+        }
+        printf("nodes=%zu quorum=%zu clients=%d resources=%d zipf=%.2f timeout=%dms retry_delay=%dms drift_factor=%.4f seed=%llu\n",
+               N, N / 2 + 1, cfg_.clients, cfg_.resources, cfg_.zipf, cfg_.timeout_ms, cfg_.retry_delay_ms, cfg_.drift_factor,
+               (unsigned long long)cfg_.seed);
+        printf("retry_policy=%s command_timeout=%dms\n", cfg_.retry_policy.c_str(), cfg_.command_timeout_ms);
+        printf("ttl=%s hold=%s arrival=%s latency=%s clock_drift=%.4f\n", cfg_.ttl.describe().c_str(), cfg_.hold.describe().c_str(),
+               cfg_.arrival.describe().c_str(), cfg_.latency.describe().c_str(), cfg_.clock_drift);
+        if (cfg_.crash_mtbf_s > 0) {
+            printf("crash_mtbf=%.1fs downtime=%s restart=%s\n", cfg_.crash_mtbf_s, cfg_.downtime.describe().c_str(),
+                   cfg_.persist ? "persist" : "empty");
+        }
+        printf("virtual time        %.1fs\n", cfg_.duration_s);
+        printf("requests            %llu\n", (unsigned long long)requests_);
+        printf("acquired            %llu (%.1f%%, %.1f/s)\n", (unsigned long long)acquire_ms_.size(),
+               requests_ ? 100.0 * acquire_ms_.size() / requests_ : 0.0, acquire_ms_.size() / cfg_.duration_s);
+        printf("gave up             %llu\n", (unsigned long long)fail_ms_.size());
+        printf("commands/request    %.3f\n", requests_ ? static_cast<double>(commands) / requests_ : 0.0);
+        if (crashes) {
+            printf("node crashes        %llu (keys lost %llu, commands failed %llu)\n", (unsigned long long)crashes,
+                   (unsigned long long)keys_lost, (unsigned long long)errors);
+        }
+        printf("lost leases         %llu\n", (unsigned long long)lost_leases_);
+        printf("safety violations   %llu", (unsigned long long)violations_);
+        if (violations_) {
+            printf(" (first at %.3fs on %s)", first_violation_us_ / 1e6, names_[first_violation_res_].c_str());
+        }
+        printf("\n");
+        print_latency("acquire latency", acquire_ms_);
+        print_latency("give-up latency", fail_ms_);
+        printf("simulated %llu requests, %llu events in %.2fs wall (%.0f requests/s, %.0f events/s)\n",
+               (unsigned long long)requests_, (unsigned long long)g_sched.events, wall_s,
+               wall_s > 0 ? requests_ / wall_s : 0.0, wall_s > 0 ? g_sched.events / wall_s : 0.0);
+    }
+
+private:
+    typedef RedLockCore<SimTransport, N, SimClock, SimRng, SimDrift> Core;
+
+    struct Worker : SimClient{
+        Worker(Simulation *s, uint64_t core_seed, uint64_t seed, int retry_delay_ms)
+            : sim(s), core(std::array<SimTransport, N>(), SimRng(core_seed), retry_delay_ms), rng(seed) {}
+
+        Simulation *sim;
+        Core core;
+        SimRng rng;  // 负载的随机数（资源、TTL、持锁时间、到达间隔）
+        Lock lock;
+    };
+
+    // 某个客户端认为自己持有锁的时间段的结束时间（真实时间轴）
+    struct Holder{
+        uint32_t client;
+        int64_t until_us;
+    };
+
+    static void client_main(void *arg){
+        Worker *w = static_cast<Worker *>(arg);
+        w->sim->client_loop(*w);
+    }
+
+    /*
+    功能：客户端循环（与 redlock-loadgen 相同）：按到达间隔发起请求 → lock() → 持有 → unlock()。
+    到达间隔与持锁时间按客户端的本地时钟计算，从不返回。
+    */
+    void client_loop(Worker &w){
+        int64_t next_arrival = w.local_us(g_sched.now_us) + ms_to_us(cfg_.arrival.sample(w.rng));
+        for (;;) {
+            g_sched.sleep_local(next_arrival - w.local_us(g_sched.now_us));
+            next_arrival += ms_to_us(cfg_.arrival.sample(w.rng));
+
+            int res = picker_.pick(w.rng);
+            int ttl = std::max(1, static_cast<int>(cfg_.ttl.sample(w.rng)));
+            int64_t hold_us = ms_to_us(cfg_.hold.sample(w.rng));
+            w.resource = res;
+
+            int64_t start = g_sched.now_us;
+            bool ok = w.core.lock(names_[res].data(), names_[res].size(), ttl, w.lock,
+                                  SimClock::now() + std::chrono::milliseconds(cfg_.timeout_ms));
+            requests_++;
+            double waited_ms = (g_sched.now_us - start) / 1000.0;
+            if (!ok) {
+                fail_ms_.push_back(waited_ms);
+                continue;
+            }
+            acquire_ms_.push_back(waited_ms);
+            enter(w, g_sched.now_us + static_cast<int64_t>(w.lock.valid_time_ * 1000LL / (1 + w.skew)));
+
+            // 持锁时间超过有效期视为租约丢失（客户端到期时应当停止使用资源，持有区间以有效期结束为准）
+            g_sched.sleep_local(hold_us);
+            if (hold_us > w.lock.valid_time_ * 1000LL) {
+                lost_leases_++;
+            }
+            leave(w);
+            w.core.unlock(w.lock);
+        }
+    }
+
+    // 客户端开始持有（直到 until_us）：其他客户端仍在有效期内持有同一资源即为违规
+    void enter(const Worker &w, int64_t until_us){
+        std::vector<Holder> &hs = holders_[w.resource];
+        int64_t now = g_sched.now_us;
+        hs.erase(std::remove_if(hs.begin(), hs.end(), [now](const Holder &h) { return h.until_us <= now; }), hs.end());
+        if (!hs.empty()) {
+            if (violations_ == 0) {
+                first_violation_us_ = now;
+                first_violation_res_ = w.resource;
+            }
+            violations_ += hs.size();
+        }
+        hs.push_back(Holder{w.id, until_us});
+    }
+
+    // 客户端停止使用资源（开始解锁）
+    void leave(const Worker &w){
+        std::vector<Holder> &hs = holders_[w.resource];
+        uint32_t id = w.id;
+        hs.erase(std::remove_if(hs.begin(), hs.end(), [id](const Holder &h) { return h.client == id; }), hs.end());
+    }
+
+    int64_t next_crash(SimNode &node){
+        return g_sched.now_us + ms_to_us(std::exponential_distribution<double>(1.0 / (cfg_.crash_mtbf_s * 1000))(node.rng));
+    }
+
+    const SimConfig &cfg_;
+    ResourcePicker picker_;
+    std::array<SimNode, N> nodes_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::string> names_;
+    std::vector<std::vector<Holder>> holders_;  // 每个资源当前（认为自己）持有锁的客户端
+    uint64_t requests_ = 0;
+    uint64_t lost_leases_ = 0;
+    uint64_t violations_ = 0;
+    int64_t first_violation_us_ = 0;
+    int first_violation_res_ = 0;
+    std::vector<double> acquire_ms_;  // 成功获取的耗时
+    std::vector<double> fail_ms_;     // 放弃获取的耗时
+};
+
+template <size_t N>
+static void simulate(const SimConfig &cfg){
+    using namespace std::chrono;
+    Simulation<N> sim(cfg);
+    steady_clock::time_point start = steady_clock::now();
+    sim.run();
+    sim.report(duration_cast<duration<double>>(steady_clock::now() - start).count());
+}
+
+static void usage(const char *prog){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "Runs RedLockCore, which shares RedLock's retry policies and retry/deadline logic. Differences from RedLock:\n"
+        "each round sends to all nodes at once, and the command timeout is the fixed --command-timeout cap\n"
+        "(no adaptive per-node timeouts).\n"
+        "  --nodes N          simulated Redis nodes, 1-9 (default 5)\n"
+        "  --clients N        virtual clients (default 1000)\n"
+        "  --resources K      number of contended resources (default 100)\n"
+        "  --zipf S           zipf exponent for resource choice, 0 = uniform (default 0)\n"
+        "  --duration SEC     virtual run time in seconds (default 60)\n"
+        "  --ttl DIST         lock ttl in ms (default const:1000)\n"
+        "  --hold DIST        hold time in ms (default exp:10)\n"
+        "  --arrival DIST     per-client inter-arrival time in ms (default exp:100)\n"
+        "  --timeout MS       give up acquiring after MS (default 1000)\n"
+        "  --retry-delay MS   max delay of the default retry policy, > 0 (default 200)\n"
+        "  --retry-policy P   default | uniform | exponential:BASE:CAP | decorrelated:BASE:CAP | fixed:MS,\n"
+        "                     optionally prefixed with holder+ to wait for the holder's lease first (default: default,\n"
+        "                     RedLock's policy: the holder's lease if it ends within --retry-delay, else uniform [0, retry-delay])\n"
+        "  --command-timeout MS  command timeout cap, also bounded by the validity budget and deadline;\n"
+        "                     0 = budget only (default 1000)\n"
+        "  --drift-factor F   validity is reduced by ttl * F + 2ms (default 0.01)\n"
+        "  --latency DIST     one-way client-node latency in ms (default exp:0.25)\n"
+        "  --node-latency I=DIST  latency of node I (0-based), may be repeated\n"
+        "  --clock-drift R    each node and client clock runs at rate 1+r, r uniform in [-R, R] (default 0)\n"
+        "  --crash-mtbf SEC   mean virtual time between crashes of each node, 0 = never (default 0)\n"
+        "  --downtime DIST    time a crashed node stays down in ms (default const:5000)\n"
+        "  --restart MODE     empty | persist (whether a restarted node keeps its keys, default empty)\n"
+        "  --seed S           random seed; the same options and seed give the same output (default 1)\n"
+        "DIST: const:V | uniform:LO:HI | exp:MEAN | normal:MEAN:SD | pareto:MIN:ALPHA\n",
+        prog);
+}
+
+static bool parse_node_latency(const std::string &val, SimConfig &cfg, std::string &err){
+    size_t pos = val.find('=');
+    if (pos == std::string::npos || pos == 0) {
+        err = "expected I=DIST";
+        return false;
+    }
+    char *end = nullptr;
+    long idx = strtol(val.c_str(), &end, 10);
+    if (end != val.c_str() + pos || idx < 0) {
+        err = "bad node index";
+        return false;
+    }
+    Distribution d;
+    if (!Distribution::parse(val.substr(pos + 1), d, err)) {
+        return false;
+    }
+    cfg.node_latency.push_back(std::make_pair(static_cast<int>(idx), d));
+    return true;
+}
+
+/*
+功能：解析 --retry-policy：default | uniform | exponential:BASE:CAP | decorrelated:BASE:CAP | fixed:MS，
+可加 holder+ 前缀（HolderAwarePolicy，抖动 DEFAULT_LEASE_JITTER_MS，不限制等待）。uniform 的范围为 [0, --retry-delay]，
+所以在所有选项解析完之后调用。
+*/
+static bool parse_retry_policy(SimConfig &cfg, std::string &err){
+    std::string spec = cfg.retry_policy;
+    bool holder = spec.compare(0, 7, "holder+") == 0;
+    if (holder) {
+        spec = spec.substr(7);
+    }
+    std::vector<int> args;
+    std::string name = spec.substr(0, spec.find(':'));
+    for (size_t pos = spec.find(':'); pos != std::string::npos; pos = spec.find(':', pos + 1)) {
+        args.push_back(atoi(spec.c_str() + pos + 1));
+    }
+    std::shared_ptr<const RetryPolicy> policy;
+    if (name == "default" && args.empty() && !holder) {
+        cfg.policy = nullptr;
+        return true;
+    } else if (name == "uniform" && args.empty()) {
+        policy = std::make_shared<UniformJitterPolicy>(0, cfg.retry_delay_ms);
+    } else if (name == "exponential" && args.size() == 2) {
+        policy = std::make_shared<ExponentialBackoffPolicy>(args[0], args[1]);
+    } else if (name == "decorrelated" && args.size() == 2) {
+        policy = std::make_shared<DecorrelatedJitterPolicy>(args[0], args[1]);
+    } else if (name == "fixed" && args.size() == 1) {
+        policy = std::make_shared<FixedRatePolicy>(args[0]);
+    } else {
+        err = "expected default | uniform | exponential:BASE:CAP | decorrelated:BASE:CAP | fixed:MS, optionally with holder+";
+        return false;
+    }
+    cfg.policy = holder ? std::make_shared<HolderAwarePolicy>(policy, DEFAULT_LEASE_JITTER_MS) : policy;
+    return true;
+}
+
+int main(int argc, char **argv){
+    SimConfig cfg;
+    std::string err;
+    Distribution::parse("const:1000", cfg.ttl, err);
+    Distribution::parse("exp:10", cfg.hold, err);
+    Distribution::parse("exp:100", cfg.arrival, err);
+    Distribution::parse("exp:0.25", cfg.latency, err);
+    Distribution::parse("const:5000", cfg.downtime, err);
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-h" || opt == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string val = argv[++i];
+        bool ok = true;
+        if (opt == "--nodes") ok = (cfg.nodes = atoi(val.c_str())) >= 1 && cfg.nodes <= 9;
+        else if (opt == "--clients") ok = (cfg.clients = atoi(val.c_str())) > 0;
+        else if (opt == "--resources") ok = (cfg.resources = atoi(val.c_str())) > 0;
+        else if (opt == "--zipf") ok = (cfg.zipf = atof(val.c_str())) >= 0;
+        else if (opt == "--duration") ok = (cfg.duration_s = atof(val.c_str())) > 0;
+        else if (opt == "--timeout") ok = (cfg.timeout_ms = atoi(val.c_str())) >= 0;
+        else if (opt == "--retry-delay") ok = (cfg.retry_delay_ms = atoi(val.c_str())) > 0;
+        else if (opt == "--retry-policy") cfg.retry_policy = val;
+        else if (opt == "--command-timeout") ok = (cfg.command_timeout_ms = atoi(val.c_str())) >= 0;
+        else if (opt == "--drift-factor") ok = (cfg.drift_factor = atof(val.c_str())) >= 0;
+        else if (opt == "--clock-drift") ok = (cfg.clock_drift = atof(val.c_str())) >= 0 && cfg.clock_drift < 1;
+        else if (opt == "--crash-mtbf") ok = (cfg.crash_mtbf_s = atof(val.c_str())) >= 0;
+        else if (opt == "--restart") ok = (cfg.persist = (val == "persist")) || val == "empty";
+        else if (opt == "--seed") cfg.seed = strtoull(val.c_str(), nullptr, 10);
+        else if (opt == "--ttl") ok = Distribution::parse(val, cfg.ttl, err);
+        else if (opt == "--hold") ok = Distribution::parse(val, cfg.hold, err);
+        else if (opt == "--arrival") ok = Distribution::parse(val, cfg.arrival, err);
+        else if (opt == "--latency") ok = Distribution::parse(val, cfg.latency, err);
+        else if (opt == "--node-latency") ok = parse_node_latency(val, cfg, err);
+        else if (opt == "--downtime") ok = Distribution::parse(val, cfg.downtime, err);
+        else {
+            fprintf(stderr, "unknown option %s\n", opt.c_str());
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "invalid value for %s: %s %s\n", opt.c_str(), val.c_str(), err.c_str());
+            return 1;
+        }
+    }
+    if (!parse_retry_policy(cfg, err)) {
+        fprintf(stderr, "invalid value for --retry-policy: %s %s\n", cfg.retry_policy.c_str(), err.c_str());
+        return 1;
+    }
+    for (const auto &nl : cfg.node_latency) {
+        if (nl.first >= cfg.nodes) {
+            fprintf(stderr, "--node-latency: node %d out of range (--nodes %d)\n", nl.first, cfg.nodes);
+            return 1;
+        }
+    }
+    if (static_cast<uint64_t>(cfg.clients) * cfg.nodes > MAX_EVENT_ID) {
+        fprintf(stderr, "--clients x --nodes must not exceed %u\n", MAX_EVENT_ID);
+        return 1;
+    }
+
+    switch (cfg.nodes) {
+        case 1: simulate<1>(cfg); break;
+        case 2: simulate<2>(cfg); break;
+        case 3: simulate<3>(cfg); break;
+        case 4: simulate<4>(cfg); break;
+        case 5: simulate<5>(cfg); break;
+        case 6: simulate<6>(cfg); break;
+        case 7: simulate<7>(cfg); break;
+        case 8: simulate<8>(cfg); break;
+        case 9: simulate<9>(cfg); break;
+    }
+    return 0;
+}
@@ -0,0 +1,427 @@
+// g++ -o redlockd RedLock.cc UnlockSender.cc LockBatcher.cc LockTracer.cc redlockd.cc -lhiredis -lpthread -I../include -std=c++11
+//
+// redlockd：本机锁代理。与 Redis 节点保持固定数量的长连接，通过 Unix 域套接字为本机进程提供
+// lock / try_lock / unlock / continue_lock（客户端见 RedLockClient.h，协议见 LockProtocol.h）。
+// - 短生命周期的进程不再需要在启动时逐个连接 Redis 节点，每次操作只是一次本机往返
+// - Redis 连接数 = (workers + fast_workers + 3) × 节点数（另三组为释放用实例、共享的异步解锁发送器与加锁 I/O 线程），与客户端进程数无关
+// - 实例同时进行的加锁、续锁经共享的加锁 I/O 线程按节点合并、流水线发送
+// - 所有解锁请求经同一个后台发送器按节点合并成批、流水线发送；发送器的命令超时（默认 1 秒）限定了解锁在故障节点上的等待
+// - 客户端断开（包括崩溃）时释放经该连接获取且尚未释放的锁，不必等 TTL 过期
+// - 每个连接一个线程，连接数上限由 --max-connections 决定（达到上限时暂停 accept，新连接在 listen 队列中等待）
+// - kill -USR1 把最近的锁操作（飞行记录器）写到标准错误；崩溃时也会先写出
+//
+// 用法示例：
+//   ./redlockd --listen /tmp/redlockd.sock --servers 127.0.0.1:6379,127.0.0.1:6380,127.0.0.1:6381 --workers 8
+
+#include "LockProtocol.h"
+#include "RedLock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+struct DaemonConfig{
+    std::vector<std::pair<std::string, int>> servers;  // Redis 节点
+    int groups = 1;                  // 把节点按顺序均分为几个独立的多数派组
+    std::string listen_path;         // Unix 域套接字路径
+    int workers = 8;                 // 阻塞加锁的 RedLock 实例数（同时等待的加锁请求数上限）
+    int fast_workers = 2;            // try_lock / continue_lock 的 RedLock 实例数
+    int retry_count = 3;             // RedLock 重试次数
+    int retry_delay_ms = 200;        // RedLock 重试间隔上限
+    int max_connections = 256;       // 同时服务的客户端连接数上限（每个连接一个线程）
+};
+
+/*
+功能：创建一个 RedLock 实例，连接所有节点并使用共享的异步解锁发送器。
+说明：单组时逐个添加（个别节点不可用时其余节点仍然加入）；多组时整组加入。没有可用节点时失败。
+*/
+static std::unique_ptr<RedLock> make_redlock(const DaemonConfig &cfg, const std::shared_ptr<UnlockSender> &sender,
+                                             const std::shared_ptr<LockBatcher> &batcher, std::string &err){
+    std::unique_ptr<RedLock> redlock(new RedLock());
+    redlock->set_retry_count(cfg.retry_count);
+    redlock->set_retry_delay(cfg.retry_delay_ms);
+    if (cfg.groups == 1) {
+        for (const auto &s : cfg.servers) {
+            std::string node_err;
+            if (!redlock->add_server(s.first, s.second, node_err)) {
+                err = s.first + ":" + std::to_string(s.second) + ": " + node_err;
+            }
+        }
+    } else {
+        size_t per_group = cfg.servers.size() / cfg.groups;
+        for (int g = 0; g < cfg.groups; g++) {
+            std::vector<std::pair<std::string, int>> group(cfg.servers.begin() + g * per_group,
+                                                           cfg.servers.begin() + (g + 1) * per_group);
+            if (!redlock->add_server_group(group, err)) {
+                return nullptr;
+            }
+        }
+    }
+    if (redlock->group_count() == 0) {
+        err = "no redis server reachable (" + err + ")";
+        return nullptr;
+    }
+    redlock->set_unlock_sender(sender);
+    if (batcher) {
+        redlock->set_batcher(batcher);
+    }
+    return redlock;
+}
+
+// RedLock 实例池：RedLock 不是线程安全的，每个请求在处理期间独占一个实例（及其连接）
+class RedLockPool{
+public:
+    // 独占一个实例，析构时归还；到 deadline 仍没有空闲实例时不持有实例（ok() 为 false）
+    class Lease{
+    public:
+        explicit Lease(RedLockPool &pool, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+            : pool_(pool), redlock_(pool.take(deadline)) {}
+        ~Lease() {
+            if (redlock_) {
+                pool_.give_back(redlock_);
+            }
+        }
+        bool ok() const { return redlock_ != nullptr; }
+        RedLock *operator->() const { return redlock_; }
+    private:
+        RedLockPool &pool_;
+        RedLock *redlock_;
+    };
+
+    // 创建 count 个实例（每个实例各自连接所有节点）
+    bool init(const DaemonConfig &cfg, int count, const std::shared_ptr<UnlockSender> &sender,
+              const std::shared_ptr<LockBatcher> &batcher, std::string &err){
+        for (int i = 0; i < count; i++) {
+            std::unique_ptr<RedLock> redlock = make_redlock(cfg, sender, batcher, err);
+            if (!redlock) {
+                return false;
+            }
+            free_.push_back(redlock.get());
+            all_.push_back(std::move(redlock));
+        }
+        return true;
+    }
+
+private:
+    // 等待空闲实例，到 deadline 仍没有时返回 nullptr
+    RedLock *take(std::chrono::steady_clock::time_point deadline){
+        std::unique_lock<std::mutex> guard(mu_);
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            cv_.wait(guard, [this] { return !free_.empty(); });
+        } else if (!cv_.wait_until(guard, deadline, [this] { return !free_.empty(); })) {
+            return nullptr;
+        }
+        RedLock *redlock = free_.back();
+        free_.pop_back();
+        return redlock;
+    }
+
+    void give_back(RedLock *redlock){
+        {
+            std::lock_guard<std::mutex> guard(mu_);
+            free_.push_back(redlock);
+        }
+        cv_.notify_one();
+    }
+
+    std::vector<std::unique_ptr<RedLock>> all_;
+    std::vector<RedLock *> free_;  // 空闲实例（后进先出，最近用过的连接更可能在缓存中）
+    std::mutex mu_;
+    std::condition_variable cv_;
+};
+
+// 守护进程的 RedLock 实例
+// - 阻塞加锁（可能在重试间隔中等待很久）与短操作（try_lock / continue_lock）使用两个实例池，
+//   这样即使所有阻塞加锁都在等待，持有者仍然可以续锁，也不会因为没有空闲实例而无法释放
+// - 释放不占用实例池：unlock_async 只把请求放进共享发送器的队列，可以由多个线程在同一实例上并发调用
+// - 两个实例池共用一个加锁 I/O 线程（LockBatcher）：各实例同时进行的加锁、续锁合并成每个节点一次流水线写出；
+//   带截止时间的加锁按节点限制超时，使用实例自己的连接
+struct Daemon{
+    std::shared_ptr<UnlockSender> sender;
+    std::shared_ptr<LockBatcher> batcher;
+    RedLockPool waiting;                // 阻塞加锁
+    RedLockPool fast;                   // try_lock / continue_lock
+    std::unique_ptr<RedLock> releaser;  // 只用于 unlock_async
+};
+
+static std::atomic<bool> g_stop(false);
+
+static void on_signal(int){
+    g_stop.store(true);
+}
+
+// 当前连接的文件描述符（退出时逐个 shutdown，让连接线程结束并释放各自持有的锁）
+static std::mutex g_conn_mu;
+static std::condition_variable g_conn_cv;
+static std::set<int> g_conns;
+
+/*
+功能：释放锁（异步提交，等待多数派确认）。
+*/
+static bool release(Daemon &daemon, const Lock &lock){
+    std::shared_ptr<std::promise<bool>> done = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = done->get_future();
+    if (!daemon.releaser->unlock_async(lock, [done](bool ok) { done->set_value(ok); })) {
+        return false;
+    }
+    return result.get();
+}
+
+/*
+功能：处理一个客户端连接上的请求（顺序处理、顺序回复）。
+说明：held 记录经本连接获取且尚未释放的锁；加锁/续锁成功后从实例的持有表注销（由连接登记），
+     这样同一把锁可以在任意实例上续期与释放。连接断开时异步释放 held 中剩余的锁。
+*/
+static void serve_connection(int fd, Daemon &daemon){
+    std::vector<Lock> held;
+    char resource[LOCKPROTO_MAX_RESOURCE];
+    char token[LOCKPROTO_MAX_TOKEN];
+    LockRequestHeader req;
+    while (lockproto_read(fd, &req, sizeof(req))) {
+        if (req.resource_len > LOCKPROTO_MAX_RESOURCE || !lockproto_read(fd, resource, req.resource_len) ||
+            !lockproto_read(fd, token, req.token_len)) {
+            break;
+        }
+        LockResponseHeader resp;
+        memset(&resp, 0, sizeof(resp));
+        resp.id = req.id;
+        resp.status = LOCK_STATUS_ERROR;
+        std::string name(resource, req.resource_len);
+        Lock lock;
+        lock.resource_.assign(resource, req.resource_len);
+        lock.value_.assign(token, req.token_len);
+        auto held_it = std::find_if(held.begin(), held.end(), [&lock](const Lock &l) {
+            return l.resource_ == lock.resource_ && l.value_ == lock.value_;
+        });
+
+        if (req.op == LOCK_OP_LOCK || req.op == LOCK_OP_TRY_LOCK) {
+            bool ok;
+            {
+                // 带等待时间的加锁：等待空闲实例也计入等待时间，到截止时间仍没有空闲实例时直接失败
+                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+                if (req.op == LOCK_OP_LOCK && req.wait_ms >= 0) {
+                    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(req.wait_ms);
+                }
+                RedLockPool::Lease redlock(req.op == LOCK_OP_TRY_LOCK ? daemon.fast : daemon.waiting, deadline);
+                if (!redlock.ok()) {
+                    ok = false;
+                } else if (req.op == LOCK_OP_TRY_LOCK) {
+                    ok = redlock->try_lock(name, req.ttl_ms, lock);
+                } else if (req.wait_ms < 0) {
+                    ok = redlock->lock(name, req.ttl_ms, lock);
+                } else {
+                    ok = redlock->lock(name, req.ttl_ms, lock, deadline);
+                }
+                if (ok) {
+                    redlock->disown(lock);
+                }
+            }
+            resp.status = ok ? LOCK_STATUS_OK : LOCK_STATUS_FAILED;
+            if (ok) {
+                held.push_back(lock);
+                resp.token_len = static_cast<uint8_t>(lock.value_.size());
+                resp.valid_ms = lock.valid_time_;
+            }
+        } else if (req.op == LOCK_OP_CONTINUE) {
+            bool ok;
+            {
+                RedLockPool::Lease redlock(daemon.fast);
+                ok = redlock->continue_lock(name, req.ttl_ms, lock);
+                if (ok) {
+                    redlock->disown(lock);
+                }
+            }
+            resp.status = ok ? LOCK_STATUS_OK : LOCK_STATUS_FAILED;
+            resp.valid_ms = ok ? lock.valid_time_ : 0;
+        } else if (req.op == LOCK_OP_UNLOCK) {
+            if (held_it != held.end()) {
+                held.erase(held_it);
+            }
+            resp.status = release(daemon, lock) ? LOCK_STATUS_OK : LOCK_STATUS_FAILED;
+        }
+
+        const char *out_token = resp.token_len > 0 ? lock.value_.data() : nullptr;
+        if (!lockproto_write(fd, &resp, sizeof(resp), out_token, resp.token_len, nullptr, 0)) {
+            break;
+        }
+    }
+
+    // 客户端断开：释放它没有释放的锁（不等待确认）
+    for (const Lock &lock : held) {
+        daemon.releaser->unlock_async(lock);
+    }
+    close(fd);
+    {
+        std::lock_guard<std::mutex> guard(g_conn_mu);
+        g_conns.erase(fd);
+    }
+    g_conn_cv.notify_all();
+}
+
+static int listen_on(const std::string &path, std::string &err){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        err = "socket path too long";
+        return -1;
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        err = std::string("socket: ") + strerror(errno);
+        return -1;
+    }
+    unlink(path.c_str());  // 上一次运行留下的套接字文件
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 512) != 0) {
+        err = std::string("bind/listen: ") + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr,
+        "usage: %s --listen PATH --servers host:port[,host:port...] [options]\n"
+        "  --groups G         split servers into G independent quorum groups (default 1)\n"
+        "  --workers N        RedLock instances for blocking lock requests (default 8)\n"
+        "  --fast-workers N   RedLock instances for try_lock / continue_lock (default 2)\n"
+        "  --retry-count N    RedLock retry count (default 3)\n"
+        "  --retry-delay MS   RedLock max retry delay (default 200)\n"
+        "  --max-connections N  client connections served at once, one thread each; more wait in the\n"
+        "                     listen backlog (default 256)\n",
+        prog);
+}
+
+static bool parse_servers(const std::string &list, DaemonConfig &cfg){
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t pos = item.rfind(':');
+        if (pos == std::string::npos) {
+            return false;
+        }
+        int port = atoi(item.c_str() + pos + 1);
+        if (port <= 0) {
+            return false;
+        }
+        cfg.servers.push_back(std::make_pair(item.substr(0, pos), port));
+    }
+    return !cfg.servers.empty();
+}
+
+int main(int argc, char **argv){
+    DaemonConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-h" || opt == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string val = argv[++i];
+        bool ok = true;
+        if (opt == "--listen") ok = !(cfg.listen_path = val).empty();
+        else if (opt == "--servers") ok = parse_servers(val, cfg);
+        else if (opt == "--groups") ok = (cfg.groups = atoi(val.c_str())) > 0;
+        else if (opt == "--workers") ok = (cfg.workers = atoi(val.c_str())) > 0;
+        else if (opt == "--fast-workers") ok = (cfg.fast_workers = atoi(val.c_str())) > 0;
+        else if (opt == "--retry-count") ok = (cfg.retry_count = atoi(val.c_str())) >= 0;
+        else if (opt == "--retry-delay") ok = (cfg.retry_delay_ms = atoi(val.c_str())) >= 0;
+        else if (opt == "--max-connections") ok = (cfg.max_connections = atoi(val.c_str())) > 0;
+        else {
+            fprintf(stderr, "unknown option %s\n", opt.c_str());
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "invalid value for %s: %s\n", opt.c_str(), val.c_str());
+            return 1;
+        }
+    }
+    if (cfg.servers.empty() || cfg.listen_path.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (cfg.servers.size() % cfg.groups != 0) {
+        fprintf(stderr, "--groups %d does not divide %zu servers evenly\n", cfg.groups, cfg.servers.size());
+        return 1;
+    }
+
+    std::string err;
+    Daemon daemon;
+    daemon.sender = std::make_shared<UnlockSender>();
+    daemon.batcher = std::make_shared<LockBatcher>();
+    daemon.releaser = make_redlock(cfg, daemon.sender, nullptr, err);
+    if (!daemon.releaser || !daemon.waiting.init(cfg, cfg.workers, daemon.sender, daemon.batcher, err) ||
+        !daemon.fast.init(cfg, cfg.fast_workers, daemon.sender, daemon.batcher, err)) {
+        fprintf(stderr, "redlockd: %s\n", err.c_str());
+        return 1;
+    }
+    int listen_fd = listen_on(cfg.listen_path, err);
+    if (listen_fd < 0) {
+        fprintf(stderr, "redlockd: %s: %s\n", cfg.listen_path.c_str(), err.c_str());
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    FlightRecorder::install_signal_handlers(STDERR_FILENO, SIGUSR1);
+    fprintf(stderr, "redlockd: listening on %s (%d + %d workers, %zu servers, up to %d connections)\n", cfg.listen_path.c_str(),
+            cfg.workers, cfg.fast_workers, cfg.servers.size(), cfg.max_connections);
+
+    // 每个连接一个线程：连接线程大部分时间阻塞在读请求或等待 Redis 上，Redis 操作的并发度由实例池限制；
+    // 连接数达到上限时不再 accept（新连接留在 listen 队列中），直到有连接断开
+    while (!g_stop.load()) {
+        {
+            std::unique_lock<std::mutex> guard(g_conn_mu);
+            if (!g_conn_cv.wait_for(guard, std::chrono::milliseconds(200),
+                                    [&cfg] { return g_conns.size() < static_cast<size_t>(cfg.max_connections); })) {
+                continue;  // 仍然满：检查退出标志
+            }
+        }
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;  // 超时或被信号打断：检查退出标志
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> guard(g_conn_mu);
+            g_conns.insert(fd);
+        }
+        std::thread(serve_connection, fd, std::ref(daemon)).detach();
+    }
+
+    // 退出：不再接受连接，断开现有连接（连接线程会释放各自持有的锁），等待解锁发送完
+    close(listen_fd);
+    unlink(cfg.listen_path.c_str());
+    {
+        std::unique_lock<std::mutex> guard(g_conn_mu);
+        for (int fd : g_conns) {
+            shutdown(fd, SHUT_RDWR);
+        }
+        g_conn_cv.wait(guard, [] { return g_conns.empty(); });
+    }
+    daemon.sender->flush();
+    return 0;
+}
@@ -0,0 +1,375 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// 飞行记录器：始终开启的固定大小环形缓冲，保存最近 capacity 次锁操作（资源、操作、各节点结果、时间戳、有效期），
+// 用于事后分析租约丢失与锁卡住的问题。
+// - 写入无等待：一次 fetch_add 取得序号，再按序号写入对应槽位（每个槽位带版本号，读者据此丢弃写到一半或已被覆盖的记录），
+//   不加锁、不分配内存、不读时钟（结束时刻由调用方传入，调用方本来就要读单调时钟计算耗时），耗时为几十纳秒
+// - 读取不阻塞写入：snapshot 复制当前所有完整的记录；dump 只用异步信号安全的函数格式化并 write，
+//   可以在致命信号的处理函数中调用（见 install_signal_handlers）
+// 进程内所有 RedLock / CRedLock 实例默认写入 FlightRecorder::global()。
+class FlightRecorder{
+public:
+    // 操作类型
+    enum Op : uint8_t{
+        OP_LOCK = 1,      // lock / try_lock / CRedLock::Lock
+        OP_EXTEND,        // continue_lock / CRedLock::ContinueLock
+        OP_UNLOCK,        // unlock / CRedLock::Unlock
+        OP_EXTEND_MANY,   // continue_many 中的一把锁（不记录各节点结果）
+    };
+
+    // 单个节点在最后一轮中的结果（每个节点 4 位，最多记录 MAX_NODES 个节点）
+    enum NodeResult : uint8_t{
+        NODE_NONE = 0,     // 未发送（剩余节点已不可能凑够多数派，或预算耗尽）
+        NODE_OK,           // 加锁 / 续锁 / 解锁成功
+        NODE_HELD,         // 锁被其他客户端持有
+        NODE_ERROR,        // 命令出错或超时
+        NODE_UNAVAILABLE,  // 连接不可用（等待重连）
+        NODE_REJECTED,     // 续锁 / 解锁时令牌不匹配（锁已过期或被他人持有）
+    };
+
+    enum : size_t{
+        MAX_NODES = 16,
+        RESOURCE_LEN = 64,         // 记录的资源名最大长度（更长的只保留前缀，resource_len 为原长度）
+        DEFAULT_CAPACITY = 4096,   // global() 的槽位数
+    };
+
+    // 一条记录（前 WORDS 个 8 字节按原样存入槽位）
+    struct Entry{
+        int64_t end_us = 0;         // 操作结束时刻（单调时钟微秒，见 now_us；输出时换算为系统时间，便于与 Redis 日志、其他主机对照）
+        int64_t dur_us = 0;         // 操作耗时（微秒）
+        uint64_t node_results = 0;  // 各节点结果：第 i 个节点在 (i*4) 位开始的 4 位
+        int32_t ttl_ms = 0;         // 请求的 TTL
+        int32_t valid_ms = 0;       // 成功时锁的剩余有效时间，失败为 0
+        uint32_t tid = 0;           // 线程号（gettid）
+        uint8_t op = 0;             // Op
+        uint8_t ok = 0;             // 操作是否成功
+        uint8_t attempts = 0;       // 尝试的轮数（超过 255 记为 255）
+        uint8_t nodes = 0;          // 节点数（组内节点数，最多记录 MAX_NODES 个的结果）
+        uint16_t resource_len = 0;  // 资源名原长度
+        uint16_t quorum = 0;        // 多数派节点数
+        int32_t holder_pttl_ms = -1;  // 加锁失败时多数派节点上持有者租约的剩余时间（-1 表示未知）
+        char resource[RESOURCE_LEN] = {};
+        uint64_t seq = 0;           // 序号（读取时由槽位版本号得到，不存入槽位）
+
+        void set_node(size_t i, NodeResult r){
+            if (i < MAX_NODES) {
+                node_results = (node_results & ~(0xfULL << (i * 4))) | (static_cast<uint64_t>(r) << (i * 4));
+            }
+        }
+        NodeResult node(size_t i) const{
+            return i < MAX_NODES ? static_cast<NodeResult>((node_results >> (i * 4)) & 0xf) : NODE_NONE;
+        }
+        // 按 8 字节整块写入（record 随后按 8 字节读出，逐字节写入会让每次读取都等待存储转发）
+        void set_resource(const char *s, size_t len){
+            resource_len = static_cast<uint16_t>(len > UINT16_MAX ? UINT16_MAX : len);
+            size_t n = len < RESOURCE_LEN ? len : static_cast<size_t>(RESOURCE_LEN);
+            size_t off = 0;
+            for (; off + 8 <= n; off += 8) {
+                uint64_t w;
+                memcpy(&w, s + off, 8);
+                memcpy(resource + off, &w, 8);
+            }
+            if (off < n) {  // 不足 8 字节的尾部在寄存器中拼好（小端序）
+                uint64_t w = 0;
+                for (size_t i = off; i < n; i++) {
+                    w |= static_cast<uint64_t>(static_cast<unsigned char>(s[i])) << ((i - off) * 8);
+                }
+                memcpy(resource + off, &w, 8);
+            }
+        }
+    };
+
+    // capacity 向上取整为 2 的幂
+    explicit FlightRecorder(size_t capacity = DEFAULT_CAPACITY){
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        wall_offset_us_ = static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000 - now_us();
+        capacity_ = 1;
+        while (capacity_ < capacity) {
+            capacity_ <<= 1;
+        }
+        slots_.reset(new Slot[capacity_]);
+    }
+
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+    // 进程级的记录器（首次调用时创建，之后不会销毁，信号处理函数中也可以访问）
+    static FlightRecorder &global(){
+        static FlightRecorder *recorder = new FlightRecorder(DEFAULT_CAPACITY);
+        return *recorder;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // 写入一条记录（无等待），覆盖最旧的记录。调用方填写 end_us 等字段，tid 由这里填写
+    void record(Entry &e){
+        e.tid = thread_id();
+        uint64_t words[WORDS];
+        memcpy(words, &e, sizeof(words));
+        uint64_t seq = next_.fetch_add(1, std::memory_order_relaxed);
+        Slot &slot = slots_[seq & (capacity_ - 1)];
+        // 版本号为奇数表示正在写入；写入完成后为 2*seq+2
+        slot.version.store(2 * seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.version.store(2 * seq + 2, std::memory_order_release);
+    }
+
+    // 已写入的记录总数（包括已被覆盖的）
+    uint64_t recorded() const { return next_.load(std::memory_order_relaxed); }
+
+    // 复制当前保留的完整记录（从旧到新）
+    std::vector<Entry> snapshot() const{
+        std::vector<Entry> out;
+        uint64_t end = next_.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+        out.reserve(end - begin);
+        for (uint64_t seq = begin; seq < end; seq++) {
+            Entry e;
+            if (read(seq, e)) {
+                out.push_back(e);
+            }
+        }
+        return out;
+    }
+
+    // 以文本格式（每条记录一行，从旧到新）写到 fd。只使用异步信号安全的函数，可在信号处理函数中调用
+    void dump(int fd) const{
+        uint64_t end = next_.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+        Writer w(fd);
+        w.str("redlock flight recorder: ").num(end - begin).str(" of ").num(end).str(" operations\n");
+        w.flush();
+        for (uint64_t seq = begin; seq < end; seq++) {
+            Entry e;
+            if (read(seq, e)) {
+                format(w, e, wall_offset_us_);
+                w.flush();
+            }
+        }
+    }
+
+    // 安装信号处理：SIGSEGV / SIGBUS / SIGFPE / SIGILL / SIGABRT 时把 global() 写到 fd 后按默认动作结束进程；
+    // dump_signal 非 0 时（如 SIGUSR1），收到该信号把 global() 写到 fd 后继续运行
+    static bool install_signal_handlers(int fd = STDERR_FILENO, int dump_signal = 0){
+        global();
+        dump_fd() = fd;
+        static const int fatal[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sigemptyset(&sa.sa_mask);
+        sa.sa_handler = on_fatal_signal;
+        sa.sa_flags = SA_RESETHAND;  // 处理一次后恢复默认动作，重新发出信号即可按原样结束进程（core dump 不受影响）
+        for (int sig : fatal) {
+            if (sigaction(sig, &sa, nullptr) != 0) {
+                return false;
+            }
+        }
+        if (dump_signal != 0) {
+            sa.sa_handler = on_dump_signal;
+            sa.sa_flags = SA_RESTART;
+            if (sigaction(dump_signal, &sa, nullptr) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static const char *op_name(uint8_t op){
+        switch (op) {
+        case OP_LOCK: return "lock";
+        case OP_EXTEND: return "extend";
+        case OP_UNLOCK: return "unlock";
+        case OP_EXTEND_MANY: return "extend_many";
+        default: return "?";
+        }
+    }
+
+    static const char *node_result_name(NodeResult r){
+        switch (r) {
+        case NODE_NONE: return "-";
+        case NODE_OK: return "ok";
+        case NODE_HELD: return "held";
+        case NODE_ERROR: return "error";
+        case NODE_UNAVAILABLE: return "down";
+        case NODE_REJECTED: return "rejected";
+        default: return "?";
+        }
+    }
+
+    // 把单调时钟读数换算为系统时间（微秒，按创建记录器时两个时钟的差值换算，之后的系统时间调整不计入）
+    int64_t to_wall_us(int64_t mono_us) const { return mono_us + wall_offset_us_; }
+
+    // 单调时钟（微秒，与 std::chrono::steady_clock 同源），供调用方填写 end_us、计算 dur_us
+    static int64_t now_us(){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+private:
+    enum : size_t{ WORDS = 14 };  // Entry 中存入槽位的 8 字节数（seq 之前的部分）
+    static_assert(offsetof(Entry, seq) == WORDS * sizeof(uint64_t), "Entry layout");
+
+    // 一个槽位：版本号 + 记录内容，共 128 字节
+    struct Slot{
+        std::atomic<uint64_t> version{0};
+        std::atomic<uint64_t> words[WORDS];
+        uint64_t pad = 0;
+    };
+
+    // 按序号读取槽位：版本号前后一致且等于 2*seq+2 时记录完整
+    bool read(uint64_t seq, Entry &e) const{
+        const Slot &slot = slots_[seq & (capacity_ - 1)];
+        uint64_t v1 = slot.version.load(std::memory_order_acquire);
+        if (v1 != 2 * seq + 2) {
+            return false;
+        }
+        uint64_t words[WORDS];
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) != v1) {
+            return false;
+        }
+        memcpy(static_cast<void *>(&e), words, sizeof(words));
+        e.seq = seq;
+        return true;
+    }
+
+    // 固定缓冲区的文本输出（不分配内存、不使用 stdio）
+    class Writer{
+    public:
+        explicit Writer(int fd) : fd_(fd) {}
+        Writer &str(const char *s){
+            return bytes(s, strlen(s));
+        }
+        Writer &bytes(const char *s, size_t len){
+            for (size_t i = 0; i < len; i++) {
+                if (len_ == sizeof(buf_)) {
+                    flush();
+                }
+                buf_[len_++] = s[i];
+            }
+            return *this;
+        }
+        Writer &num(int64_t v){
+            char tmp[24];
+            size_t n = 0;
+            uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+            do {
+                tmp[n++] = static_cast<char>('0' + u % 10);
+                u /= 10;
+            } while (u);
+            if (v < 0) {
+                tmp[n++] = '-';
+            }
+            while (n) {
+                bytes(&tmp[--n], 1);
+            }
+            return *this;
+        }
+        // 不可打印字符写成 \xHH
+        Writer &escaped(const char *s, size_t len){
+            static const char hex[] = "0123456789abcdef";
+            for (size_t i = 0; i < len; i++) {
+                unsigned char c = static_cast<unsigned char>(s[i]);
+                if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+                    char esc[4] = {'\\', 'x', hex[c >> 4], hex[c & 0xf]};
+                    bytes(esc, 4);
+                } else {
+                    bytes(s + i, 1);
+                }
+            }
+            return *this;
+        }
+        void flush(){
+            size_t off = 0;
+            while (off < len_) {
+                ssize_t n = ::write(fd_, buf_ + off, len_ - off);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    break;
+                }
+                off += static_cast<size_t>(n);
+            }
+            len_ = 0;
+        }
+    private:
+        int fd_;
+        char buf_[512];
+        size_t len_ = 0;
+    };
+
+    // 一条记录一行：#序号 秒.微秒 tid=… 操作 结果 dur_us=… attempts=… ttl_ms=… valid_ms=… nodes=ok,held,… quorum=…
+    // [holder_pttl_ms=…] resource="…"
+    static void format(Writer &w, const Entry &e, int64_t wall_offset_us){
+        int64_t wall_us = e.end_us + wall_offset_us;
+        int64_t frac = wall_us % 1000000;
+        char digits[7];
+        for (int i = 5; i >= 0; i--, frac /= 10) {
+            digits[i] = static_cast<char>('0' + frac % 10);
+        }
+        w.str("#").num(static_cast<int64_t>(e.seq)).str(" ").num(wall_us / 1000000).str(".").bytes(digits, 6);
+        w.str(" tid=").num(e.tid).str(" ").str(op_name(e.op)).str(e.ok ? " ok" : " FAILED");
+        w.str(" dur_us=").num(e.dur_us).str(" attempts=").num(e.attempts);
+        w.str(" ttl_ms=").num(e.ttl_ms).str(" valid_ms=").num(e.valid_ms).str(" nodes=");
+        size_t nodes = e.nodes < MAX_NODES ? e.nodes : static_cast<size_t>(MAX_NODES);
+        for (size_t i = 0; i < nodes; i++) {
+            w.str(i ? "," : "").str(node_result_name(e.node(i)));
+        }
+        if (nodes == 0) {
+            w.str("-");
+        }
+        w.str(" quorum=").num(e.quorum);
+        if (e.holder_pttl_ms >= 0) {
+            w.str(" holder_pttl_ms=").num(e.holder_pttl_ms);
+        }
+        size_t len = e.resource_len < RESOURCE_LEN ? e.resource_len : static_cast<size_t>(RESOURCE_LEN);
+        w.str(" resource=\"").escaped(e.resource, len).str(e.resource_len > RESOURCE_LEN ? "...\"\n" : "\"\n");
+    }
+
+    // 线程号（每个线程只调用一次 gettid）
+    static uint32_t thread_id(){
+        static thread_local uint32_t tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+        return tid;
+    }
+
+    static int &dump_fd(){
+        static int fd = STDERR_FILENO;
+        return fd;
+    }
+
+    static void on_fatal_signal(int sig){
+        global().dump(dump_fd());
+        raise(sig);  // SA_RESETHAND 已恢复默认动作
+    }
+
+    static void on_dump_signal(int){
+        int saved = errno;
+        global().dump(dump_fd());
+        errno = saved;
+    }
+
+    size_t capacity_;
+    int64_t wall_offset_us_;  // 系统时间 - 单调时钟（微秒）
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> next_{0};  // 下一条记录的序号
+};
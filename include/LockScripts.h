@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+
+// 锁操作使用的 Lua 脚本（EVAL 在 Redis 上原子执行），RedLock、UnlockSender、HiredisTransport、CRedLock 与微基准共用这一份，
+// 避免各处的副本悄悄不一致
+
+// 加锁脚本（KEYS[1] = resource，ARGV[1] = token，ARGV[2] = ttl 毫秒）：SET NX PX 成功时返回 OK；
+// 失败时返回当前持有者的剩余有效时间（PTTL，-1 表示没有过期时间）
+inline const std::string &acquire_script(){
+    static const std::string s =
+        "local ok = redis.call('set', KEYS[1], ARGV[1], 'NX', 'PX', ARGV[2]) "
+        "if ok then return ok end "
+        "return redis.call('pttl', KEYS[1])";
+    return s;
+}
+
+// 解锁脚本（KEYS[1] = resource，ARGV[1] = token）：仅当锁的持有者标识匹配时才删除锁（防止误删其他客户端的锁），返回 1/0
+inline const std::string &unlock_script(){
+    static const std::string s =
+        "if redis.call('get', KEYS[1]) == ARGV[1] then "  // 检查当前锁的值是否等于客户端的唯一标识
+        "return redis.call('del', KEYS[1]) "              // 匹配则删除锁
+        "else "                                            // 不匹配
+        "return 0 "                                        // 返回0（表示未删除）
+        "end";
+    return s;
+}
+
+// 续锁脚本（KEYS[1] = resource，ARGV[1] = token，ARGV[2] = ttl 毫秒）：仅当锁的持有者标识匹配时，延长锁的有效时间
+inline const std::string &extend_script(){
+    static const std::string s =
+        "if redis.call('get', KEYS[1]) == ARGV[1] then "  // 检查锁的值是否匹配
+        "return redis.call('pexpire', KEYS[1], ARGV[2]) "  // 匹配则设置新的有效时间（毫秒）
+        "end";  // 不匹配则无操作（返回nil）
+    return s;
+}
+
+// 批量续锁脚本：KEYS[i] 的持有者标识为 ARGV[i + 1] 时把过期时间设为 ARGV[1] 毫秒，按 key 顺序返回 1/0
+inline const std::string &extend_many_script(){
+    static const std::string s =
+        "local r = {} "
+        "for i, key in ipairs(KEYS) do "
+        "if redis.call('get', key) == ARGV[i + 1] then "
+        "r[i] = redis.call('pexpire', key, ARGV[1]) "
+        "else "
+        "r[i] = 0 "
+        "end "
+        "end "
+        "return r";
+    return s;
+}
+
+// 批量解锁脚本：KEYS[i] 的持有者标识为 ARGV[i] 时删除，按 key 顺序返回 1/0（UnlockSender 按 key 统计多数派）
+inline const std::string &unlock_many_script(){
+    static const std::string s =
+        "local r = {} "
+        "for i, key in ipairs(KEYS) do "
+        "if redis.call('get', key) == ARGV[i] then "
+        "r[i] = redis.call('del', key) "
+        "else "
+        "r[i] = 0 "
+        "end "
+        "end "
+        "return r";
+    return s;
+}
+
+// 批量解锁脚本：KEYS[i] 的持有者标识为 ARGV[i] 时删除，只返回删除的数量（release_all 不需要逐个结果）
+inline const std::string &unlock_count_script(){
+    static const std::string s =
+        "local n = 0 "
+        "for i, key in ipairs(KEYS) do "
+        "if redis.call('get', key) == ARGV[i] then "
+        "n = n + redis.call('del', key) "
+        "end "
+        "end "
+        "return n";
+    return s;
+}
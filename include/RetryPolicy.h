@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+// 一轮获取失败后，决定下一轮之前等待多久的上下文
+struct RetryContext{
+    int attempt = 0;          // 已失败的轮次数（从1开始）
+    int prev_delay_ms = 0;    // 上一次等待的时间（首次为0）
+    int round_ms = 0;         // 刚结束的这一轮耗时
+    int64_t elapsed_ms = 0;   // 本次获取从开始到现在的总耗时
+    int64_t holder_pttl_ms = -1;  // 多数派节点上当前持有者租约到期的预计剩余时间（-1 表示未知）
+};
+
+// 重试/退避策略接口：只负责计算等待时间，总时长由调用方的截止时间约束
+// 策略对象无状态、只读，可以在多个 RedLock 实例/线程之间共享
+class RetryPolicy{
+public:
+    virtual ~RetryPolicy() {}
+    // 返回下一轮之前应等待的毫秒数（≥0）
+    virtual int next_delay_ms(const RetryContext &ctx, std::mt19937 &rng) const = 0;
+
+protected:
+    static int uniform(std::mt19937 &rng, int lo, int hi){
+        if (hi <= lo) {
+            return lo;
+        }
+        return std::uniform_int_distribution<int>(lo, hi)(rng);
+    }
+};
+
+// 均匀抖动：[min_ms, max_ms] 内随机（RedLock 原有行为为 [0, retry_delay]）
+class UniformJitterPolicy : public RetryPolicy{
+public:
+    UniformJitterPolicy(int min_ms, int max_ms) : min_ms_(min_ms), max_ms_(max_ms) {}
+    int next_delay_ms(const RetryContext &, std::mt19937 &rng) const override{
+        return uniform(rng, min_ms_, max_ms_);
+    }
+private:
+    int min_ms_;
+    int max_ms_;
+};
+
+// 指数退避（全抖动）：[0, min(cap, base * 2^(attempt-1))] 内随机
+// 竞争激烈时等待时间迅速拉长，显著减少无效的 SET NX
+class ExponentialBackoffPolicy : public RetryPolicy{
+public:
+    ExponentialBackoffPolicy(int base_ms, int cap_ms) : base_ms_(base_ms), cap_ms_(cap_ms) {}
+    int next_delay_ms(const RetryContext &ctx, std::mt19937 &rng) const override{
+        int shift = std::min(std::max(ctx.attempt - 1, 0), 30);
+        int64_t ceiling = std::min<int64_t>(cap_ms_, static_cast<int64_t>(base_ms_) << shift);
+        return uniform(rng, 0, static_cast<int>(ceiling));
+    }
+private:
+    int base_ms_;
+    int cap_ms_;
+};
+
+// 去相关抖动：min(cap, random(base, prev * 3))
+// 与指数退避相比等待时间分布更分散，多个客户端不容易再次同时醒来
+class DecorrelatedJitterPolicy : public RetryPolicy{
+public:
+    DecorrelatedJitterPolicy(int base_ms, int cap_ms) : base_ms_(base_ms), cap_ms_(cap_ms) {}
+    int next_delay_ms(const RetryContext &ctx, std::mt19937 &rng) const override{
+        int prev = std::max(ctx.prev_delay_ms, base_ms_);
+        int hi = static_cast<int>(std::min<int64_t>(cap_ms_, static_cast<int64_t>(prev) * 3));
+        return std::min(cap_ms_, uniform(rng, base_ms_, hi));
+    }
+private:
+    int base_ms_;
+    int cap_ms_;
+};
+
+// 固定频率：每 interval_ms 发起一轮（扣除本轮自身耗时），适合需要稳定探测间隔的场景
+class FixedRatePolicy : public RetryPolicy{
+public:
+    explicit FixedRatePolicy(int interval_ms) : interval_ms_(interval_ms) {}
+    int next_delay_ms(const RetryContext &ctx, std::mt19937 &) const override{
+        return std::max(0, interval_ms_ - ctx.round_ms);
+    }
+private:
+    int interval_ms_;
+};
+
+// 按持有者租约调度：加锁失败时已知多数派节点上持有者租约的剩余时间，则在租约到期后
+// （再加 [0, jitter_ms] 的随机抖动，避免所有等待者同时醒来）发起下一轮；
+// 长时间持有时不再白白轮询，短时间持有时几乎立刻就能拿到锁。
+// 剩余时间未知（节点不可达、key 没有过期时间等），或租约在 max_wait_ms 之后才到期时，交给 fallback 策略
+// （持有者通常会提前释放锁，不宜一直等到租约结束）。
+class HolderAwarePolicy : public RetryPolicy{
+public:
+    HolderAwarePolicy(std::shared_ptr<const RetryPolicy> fallback, int jitter_ms, int max_wait_ms = INT_MAX)
+        : fallback_(std::move(fallback)), jitter_ms_(jitter_ms), max_wait_ms_(max_wait_ms) {}
+    int next_delay_ms(const RetryContext &ctx, std::mt19937 &rng) const override{
+        if (ctx.holder_pttl_ms < 0) {
+            return fallback_->next_delay_ms(ctx, rng);
+        }
+        int64_t delay = ctx.holder_pttl_ms + uniform(rng, 0, jitter_ms_);
+        if (delay > max_wait_ms_) {
+            return fallback_->next_delay_ms(ctx, rng);
+        }
+        return static_cast<int>(delay);
+    }
+private:
+    std::shared_ptr<const RetryPolicy> fallback_;
+    int jitter_ms_;
+    int max_wait_ms_;
+};
+
+// 加锁一轮后各节点的结果（lease_ms[i]）：0 加锁成功，>0 持有者租约的剩余时间（确定被拒绝），
+// LEASE_UNKNOWN 已发出但结果未知（超时、I/O 错误、无过期时间），LEASE_NOT_SENT 命令未发出（节点不可用或被跳过）
+static constexpr int64_t LEASE_UNKNOWN = -1;
+static constexpr int64_t LEASE_NOT_SENT = -2;
+
+// 加锁失败后是否需要在该节点上释放：加锁成功或结果未知的节点上都可能留下了本客户端的锁
+inline bool lease_needs_release(int64_t lease_ms){
+    return lease_ms == 0 || lease_ms == LEASE_UNKNOWN;
+}
+
+// 多数派租约到期时间：lease_ms[i] 为第 i 个节点上的锁还要多久才可获取
+// （本轮已拿到并释放的节点为 0，未知为 -1），返回第 quorum 个节点空出的时间，未知时返回 -1。
+// 会重排 lease_ms 的内容
+inline int64_t quorum_lease_ms(int64_t *lease_ms, size_t n, size_t quorum){
+    if (quorum == 0 || quorum > n) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (lease_ms[i] < 0) {
+            lease_ms[i] = INT64_MAX;  // 未知的节点排在最后
+        }
+    }
+    std::nth_element(lease_ms, lease_ms + quorum - 1, lease_ms + n);
+    int64_t v = lease_ms[quorum - 1];
+    return v == INT64_MAX ? -1 : v;
+}
+
+// 按持有者租约调度时叠加的随机抖动上限（毫秒）
+static constexpr int DEFAULT_LEASE_JITTER_MS = 10;
+
+// RedLock 与 RedLockCore 的默认重试策略：加锁失败时若知道多数派节点上持有者租约的剩余时间，且租约在 delay_ms 内到期，
+// 则在到期时再试；否则（以及续锁时）等待 [0, delay_ms] 内的随机值。
+// 持有者通常会在租约到期前主动释放锁，因此等待时间不超过 delay_ms，避免长租约把等待者拖到租约结束。
+inline std::shared_ptr<const RetryPolicy> default_retry_policy(int delay_ms){
+    return std::make_shared<HolderAwarePolicy>(std::make_shared<UniformJitterPolicy>(0, delay_ms), DEFAULT_LEASE_JITTER_MS, delay_ms);
+}
+
+// 一轮加锁失败后更新重试上下文（RedLock、CRedLock 与 RedLockCore 共用）：
+// lease_ms 为本轮各节点的结果（见 LEASE_*，会被重排），round_ms 为本轮耗时（含失败后的清理），elapsed_ms 为从开始到现在的总耗时。
+// 多数派租约扣除本轮已过去的时间（回复在本轮中途到达，估计偏保守）
+inline void retry_after_round(RetryContext &ctx, int64_t *lease_ms, size_t n, size_t quorum, int64_t round_ms, int64_t elapsed_ms){
+    int64_t lease = quorum_lease_ms(lease_ms, n, quorum);
+    ctx.holder_pttl_ms = lease < 0 ? -1 : std::max<int64_t>(0, lease - round_ms);
+    ctx.attempt++;
+    ctx.round_ms = static_cast<int>(round_ms);
+    ctx.elapsed_ms = elapsed_ms;
+}
+
+// 按策略计算下一轮之前的等待时间（毫秒）；等待之后再进行一轮（耗时按刚结束的一轮估计）会用完
+// remaining_ms（距截止时间的剩余时间，没有截止时间时传 INT64_MAX）时返回 -1，表示应放弃而不是为了最后一轮越过截止时间
+inline int retry_delay_ms(const RetryPolicy &policy, const RetryContext &ctx, std::mt19937 &rng, int64_t remaining_ms){
+    int delay = std::max(0, policy.next_delay_ms(ctx, rng));
+    if (remaining_ms != INT64_MAX && delay + static_cast<int64_t>(ctx.round_ms) >= remaining_ms) {
+        return -1;
+    }
+    return delay;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <hiredis/hiredis.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// 单个 Redis 节点的连接选项（RedLock::add_server / CRedLock::AddServerUrl 共用）
+struct ServerOptions{
+    std::string unix_path;          // 非空时通过 Unix 域套接字连接（忽略 host/port），同机部署时单条命令延迟更低
+    int connect_timeout_ms = 1500;  // 连接超时（毫秒）
+    int command_timeout_ms = 0;     // 命令读写超时（毫秒），0 表示不限制（阻塞直到收到回复）
+    bool tcp_nodelay = true;        // TCP_NODELAY（hiredis 默认开启；关闭后小包可能被 Nagle 算法合并延迟）
+    int keepalive_s = 0;            // 大于 0 时开启 TCP keepalive，空闲时间与探测间隔（秒）
+    int rcvbuf_bytes = 0;           // SO_RCVBUF（字节），0 表示系统默认
+    int sndbuf_bytes = 0;           // SO_SNDBUF（字节），0 表示系统默认
+};
+
+// 自适应命令超时（RedLock::set_command_timeouts，所有节点共用；每个节点按自己的延迟分布计算）
+// 命令超时 = 该节点最近命令往返延迟的 quantile 分位数 × multiplier，限制在 [min_timeout_ms, max_timeout_ms] 内；
+// 节点的 command_timeout_ms 大于 0 时以它为上限。加锁/续锁时还不超过本轮剩余的有效期预算，预算耗尽的节点不再发送。
+// 超时的连接（可能还有未读取的回复）会被关闭，之后按退避间隔重连。
+struct CommandTimeoutOptions{
+    bool adaptive = true;            // 为 false 时只使用 command_timeout_ms（0 表示不限制）与有效期预算
+    double quantile = 0.99;          // 按延迟的哪个分位数估计
+    double multiplier = 4.0;         // 超时 = 分位数 × multiplier
+    int min_timeout_ms = 5;          // 超时下限（毫秒）：避免调度抖动被当成节点故障
+    int max_timeout_ms = 1000;       // 超时上限（毫秒），所有节点的样本都不足时使用
+    int min_samples = 32;            // 节点样本少于该值时改用所有节点的分布
+    int reconnect_delay_ms = 200;    // 超时/断开后到第一次重连的间隔（毫秒），连续失败时加倍
+    int max_reconnect_delay_ms = 5000;  // 重连间隔上限（毫秒）
+};
+
+inline struct timeval ms_to_timeval(int ms){
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return tv;
+}
+
+inline struct timeval us_to_timeval(int64_t us){
+    struct timeval tv;
+    tv.tv_sec = static_cast<time_t>(us / 1000000);
+    tv.tv_usec = static_cast<suseconds_t>(us % 1000000);
+    return tv;
+}
+
+// 设置一个整数类型的套接字选项，失败时把错误写入连接对象
+inline bool set_socket_option(redisContext *c, int level, int name, int value, const char *what){
+    if (setsockopt(c->fd, level, name, &value, sizeof(value)) == 0) {
+        return true;
+    }
+    c->err = REDIS_ERR_IO;
+    snprintf(c->errstr, sizeof(c->errstr), "setsockopt(%s): %s", what, strerror(errno));
+    return false;
+}
+
+// 按选项连接一个 Redis 节点
+// 返回值与 redisConnectWithTimeout 相同：可能为 nullptr（内存不足），也可能带有错误（c->err 非 0），由调用方处理；
+// 只有连接成功时才设置套接字选项，任一选项设置失败时同样通过 c->err / c->errstr 报告
+inline redisContext *connect_redis(const std::string &host, int port, const ServerOptions &options){
+    struct timeval connect_timeout = ms_to_timeval(options.connect_timeout_ms);
+    bool unix_socket = !options.unix_path.empty();
+    redisContext *c = unix_socket ? redisConnectUnixWithTimeout(options.unix_path.c_str(), connect_timeout)
+                                  : redisConnectWithTimeout(host.c_str(), port, connect_timeout);
+    if (c == nullptr || c->err) {
+        return c;
+    }
+
+    if (options.command_timeout_ms > 0 && redisSetTimeout(c, ms_to_timeval(options.command_timeout_ms)) != REDIS_OK) {
+        return c;  // hiredis 已设置 c->err
+    }
+    if (!unix_socket) {
+        if (!set_socket_option(c, IPPROTO_TCP, TCP_NODELAY, options.tcp_nodelay ? 1 : 0, "TCP_NODELAY")) {
+            return c;
+        }
+        if (options.keepalive_s > 0) {
+            if (!set_socket_option(c, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE")) {
+                return c;
+            }
+#ifdef TCP_KEEPIDLE
+            if (!set_socket_option(c, IPPROTO_TCP, TCP_KEEPIDLE, options.keepalive_s, "TCP_KEEPIDLE") ||
+                !set_socket_option(c, IPPROTO_TCP, TCP_KEEPINTVL, options.keepalive_s, "TCP_KEEPINTVL")) {
+                return c;
+            }
+#endif
+        }
+    }
+    if (options.rcvbuf_bytes > 0 && !set_socket_option(c, SOL_SOCKET, SO_RCVBUF, options.rcvbuf_bytes, "SO_RCVBUF")) {
+        return c;
+    }
+    if (options.sndbuf_bytes > 0 && !set_socket_option(c, SOL_SOCKET, SO_SNDBUF, options.sndbuf_bytes, "SO_SNDBUF")) {
+        return c;
+    }
+    return c;
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 锁令牌（持有者标识）生成器
+// - 每个线程一个 ChaCha20 密码学安全伪随机数生成器，种子来自 getrandom()，线程之间无共享状态、无锁
+// - 按批生成密钥流（一次 16 个块 = 1024 字节），每批的前 32 字节作为下一批的密钥（快速密钥擦除）
+// - fork 之后子进程会自动重新播种，避免父子进程生成相同的令牌
+// - 十六进制编码在支持 SSE2 的平台上使用向量化实现
+
+static constexpr size_t TOKEN_RAW_LEN = 20;                 // 令牌的随机字节数（160位）
+static constexpr size_t TOKEN_HEX_LEN = TOKEN_RAW_LEN * 2;  // 十六进制令牌长度
+
+// 令牌格式
+enum class TokenFormat{
+    Hex,     // 40个十六进制字符（默认，便于日志/redis-cli查看）
+    Binary,  // 20个原始字节（更短的key值，Redis侧比较与传输更省）
+};
+
+// 把 n 字节编码为 2n 个小写十六进制字符（不写结尾的'\0'）
+inline void hex_encode(const uint8_t *in, size_t n, char *out){
+    static const char digits[] = "0123456789abcdef";
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero_ch = _mm_set1_epi8('0');
+    const __m128i alpha_gap = _mm_set1_epi8('a' - '0' - 10);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        // nibble > 9 时额外加上 'a'-'0'-10
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero_ch), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha_gap));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero_ch), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha_gap));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for (; i < n; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 0x0f];
+    }
+}
+
+class TokenGenerator{
+public:
+    // 当前线程的生成器（首次使用时播种）
+    static TokenGenerator &local(){
+        static thread_local TokenGenerator gen;
+        return gen;
+    }
+
+    // 生成 TOKEN_RAW_LEN 个随机字节
+    void next_raw(uint8_t *out){
+        if (pos_ + TOKEN_RAW_LEN > sizeof(buf_) || generation_ != fork_generation().load(std::memory_order_relaxed)) {
+            refill();
+        }
+        memcpy(out, buf_ + pos_, TOKEN_RAW_LEN);
+        memset(buf_ + pos_, 0, TOKEN_RAW_LEN);  // 用过的随机数立即擦除
+        pos_ += TOKEN_RAW_LEN;
+    }
+
+    // 生成40位十六进制令牌（不写结尾的'\0'）
+    void next_hex(char *out){
+        uint8_t raw[TOKEN_RAW_LEN];
+        next_raw(raw);
+        hex_encode(raw, TOKEN_RAW_LEN, out);
+    }
+
+    // 按格式生成令牌，返回写入的字节数（out 至少 TOKEN_HEX_LEN 字节）
+    size_t next(TokenFormat format, char *out){
+        if (format == TokenFormat::Binary) {
+            next_raw(reinterpret_cast<uint8_t *>(out));
+            return TOKEN_RAW_LEN;
+        }
+        next_hex(out);
+        return TOKEN_HEX_LEN;
+    }
+
+    // 生成一个64位随机数（用于为其他非密码学随机数生成器播种）
+    uint64_t next_u64(){
+        uint8_t raw[TOKEN_RAW_LEN];
+        next_raw(raw);
+        uint64_t v;
+        memcpy(&v, raw, sizeof(v));
+        return v;
+    }
+
+private:
+    static constexpr size_t KEY_LEN = 32;
+    static constexpr size_t BLOCKS_PER_BATCH = 16;
+
+    TokenGenerator() : pos_(sizeof(buf_)), generation_(0) {
+        register_fork_handler();
+        os_random(key_, sizeof(key_));
+    }
+
+    TokenGenerator(const TokenGenerator &) = delete;
+    TokenGenerator &operator=(const TokenGenerator &) = delete;
+
+    ~TokenGenerator(){
+        memset(key_, 0, sizeof(key_));
+        memset(buf_, 0, sizeof(buf_));
+    }
+
+    // fork 计数：子进程中递增，各线程发现变化后重新从操作系统取种子
+    static std::atomic<uint32_t> &fork_generation(){
+        static std::atomic<uint32_t> generation(0);
+        return generation;
+    }
+
+    static void on_fork_child(){
+        fork_generation().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void register_fork_handler(){
+        static std::once_flag once;
+        std::call_once(once, []() { pthread_atfork(nullptr, nullptr, &TokenGenerator::on_fork_child); });
+    }
+
+    // 从操作系统读取真随机数：优先 getrandom()，不可用时退回 /dev/urandom
+    static void os_random(uint8_t *out, size_t len){
+        size_t got = 0;
+#ifdef SYS_getrandom
+        while (got < len) {
+            long n = syscall(SYS_getrandom, out + got, len - got, 0);
+            if (n > 0) {
+                got += static_cast<size_t>(n);
+            } else if (errno != EINTR) {
+                break;
+            }
+        }
+#endif
+        if (got < len) {
+            int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+            while (fd >= 0 && got < len) {
+                ssize_t n = read(fd, out + got, len - got);
+                if (n > 0) {
+                    got += static_cast<size_t>(n);
+                } else if (n < 0 && errno != EINTR) {
+                    break;
+                }
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        if (got < len) {
+            abort();  // 没有可用的熵源时继续运行会产生可预测的令牌
+        }
+    }
+
+    static inline uint32_t rotl(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
+
+    static inline uint32_t load32(const uint8_t *p){
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    static inline void store32(uint8_t *p, uint32_t v){
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+        p[2] = static_cast<uint8_t>(v >> 16);
+        p[3] = static_cast<uint8_t>(v >> 24);
+    }
+
+    // ChaCha20 块函数（RFC 8439），nonce 固定为0：每个密钥只使用一批即被替换
+    static void chacha20_block(const uint8_t *key, uint32_t counter, uint8_t *out){
+        uint32_t in[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+        for (int i = 0; i < 8; i++) {
+            in[4 + i] = load32(key + 4 * i);
+        }
+        in[12] = counter;
+        in[13] = in[14] = in[15] = 0;
+
+        uint32_t x[16];
+        memcpy(x, in, sizeof(x));
+#define CHACHA_QR(a, b, c, d) \
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16); \
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12); \
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);  \
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+        for (int round = 0; round < 10; round++) {
+            CHACHA_QR(0, 4, 8, 12) CHACHA_QR(1, 5, 9, 13) CHACHA_QR(2, 6, 10, 14) CHACHA_QR(3, 7, 11, 15)
+            CHACHA_QR(0, 5, 10, 15) CHACHA_QR(1, 6, 11, 12) CHACHA_QR(2, 7, 8, 13) CHACHA_QR(3, 4, 9, 14)
+        }
+#undef CHACHA_QR
+        for (int i = 0; i < 16; i++) {
+            store32(out + 4 * i, x[i] + in[i]);
+        }
+    }
+
+    // 生成下一批密钥流：前32字节成为新密钥，其余字节用于令牌
+    void refill(){
+        uint32_t generation = fork_generation().load(std::memory_order_relaxed);
+        if (generation != generation_) {
+            os_random(key_, sizeof(key_));  // fork 后重新播种
+            generation_ = generation;
+        }
+        uint8_t stream[BLOCKS_PER_BATCH * 64];
+        for (uint32_t i = 0; i < BLOCKS_PER_BATCH; i++) {
+            chacha20_block(key_, i, stream + 64 * i);
+        }
+        memcpy(key_, stream, KEY_LEN);
+        memcpy(buf_, stream + KEY_LEN, sizeof(buf_));
+        memset(stream, 0, sizeof(stream));
+        pos_ = 0;
+    }
+
+    uint8_t key_[KEY_LEN];                              // 当前 ChaCha20 密钥
+    uint8_t buf_[BLOCKS_PER_BATCH * 64 - KEY_LEN];      // 待取用的随机字节（一批约49个令牌）
+    size_t pos_;                                        // buf_ 中下一个可用位置
+    uint32_t generation_;                               // 播种时的 fork 计数
+};
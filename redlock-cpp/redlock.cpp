@@ -6,42 +6,178 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <math.h>
+#include <time.h>
+#include <limits.h>
 #include "redlock.h"
+#include "TokenGenerator.h"
+#include "LockScripts.h"
+
+// 把一次调用写入进程级的飞行记录器（各实例的结果由调用方填写）
+static void FlightRecord(FlightRecorder::Entry &e, FlightRecorder::Op op, const CLock &lock, size_t nodes, int quorum, bool ok,
+                         int attempts, int ttl, int validityTime, int64_t startUs) {
+    e.op = op;
+    e.ok = ok;
+    e.nodes = (uint8_t)(nodes > 255 ? 255 : nodes);
+    e.quorum = (uint16_t)quorum;
+    e.attempts = (uint8_t)(attempts > 255 ? 255 : attempts);
+    e.ttl_ms = ttl;
+    e.valid_ms = ok ? validityTime : 0;
+    e.end_us = FlightRecorder::now_us();
+    e.dur_us = e.end_us - startUs;
+    e.set_resource(lock.m_resource, strlen(lock.m_resource));
+    FlightRecorder::global().record(e);
+}
 
 /*
-功能：将 C 风格的字符串数组（char**）转换为 Redis 专用的 sds 字符串数组。
-参数：
-count：输入字符串的数量。
-args：C 风格字符串数组（以 char* 表示每个字符串）。
+功能：RESP 编码辅助函数，把命令直接写入可复用的 sds 缓冲区。
+说明：sdscatlen 只有在剩余空间不足时才会扩容，缓冲区预热后编码过程不再分配内存；
+整数（参数个数、参数长度、ttl）都在栈上就地格式化。
 */
-static char **convertToSds(int count,char **args){
-    int j;
-    // 分配一个 char** 数组，用于存储转换后的 sds 字符串指针
-    char **sds = (char **)malloc(sizeof(char*)*count);
-    for(j = 0;j < count;j++){
-        // 逐个将 C 风格字符串转换为 sds 字符串（sdsnew 会分配内存并复制内容）
-        sds[j] = sdsnew(args[j]);
+static size_t respFormatInt(char *out, long long v) {
+    char tmp[24];
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    size_t n = 0, len = 0;
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) {
+        out[len++] = '-';
     }
-    return sds;
+    while (n) {
+        out[len++] = tmp[--n];
+    }
+    return len;
+}
+
+// 写入数组头：*<argc>\r\n
+static sds respBegin(sds buf, int argc) {
+    char num[24];
+    sdsclear(buf);
+    buf = sdscatlen(buf, "*", 1);
+    buf = sdscatlen(buf, num, respFormatInt(num, argc));
+    return sdscatlen(buf, "\r\n", 2);
+}
+
+// 写入一个二进制安全的参数：$<len>\r\n<data>\r\n
+static sds respArg(sds buf, const char *s, size_t len) {
+    char num[24];
+    buf = sdscatlen(buf, "$", 1);
+    buf = sdscatlen(buf, num, respFormatInt(num, (long long)len));
+    buf = sdscatlen(buf, "\r\n", 2);
+    buf = sdscatlen(buf, s, len);
+    return sdscatlen(buf, "\r\n", 2);
+}
+
+// 写入一个 C 字符串参数
+static sds respArgStr(sds buf, const char *s) {
+    return respArg(buf, s, strlen(s));
+}
+
+// 写入一个整数参数
+static sds respArgInt(sds buf, long long v) {
+    char num[24];
+    return respArg(buf, num, respFormatInt(num, v));
+}
+
+/*
+功能：获取单调时钟的毫秒数，用于计算重试截止时间（不受系统时间调整影响）。
+*/
+static long long MonotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+功能：默认退避策略。加锁失败时若知道多数派实例上持有者租约的剩余时间，且租约在 delay 毫秒内到期，
+则在租约到期后（加 0~10ms 抖动）再试；否则（持有者通常会提前释放锁，不等到租约结束）
+在 [delay/2, delay/2 + delay) 内均匀随机（与原先的 rand() % delay + delay/2 一致）。
+*/
+static std::shared_ptr<const RetryPolicy> DefaultRetryPolicy(int delay) {
+    return std::make_shared<HolderAwarePolicy>(
+        std::make_shared<UniformJitterPolicy>(delay / 2, delay / 2 + delay - 1), 10, delay);
 }
 
 /*
 功能：初始化 CLock 对象的成员变量。
 初始化列表：
 m_validityTime：锁的有效时间，初始化为 0（单位：毫秒）。
-m_resource：要锁定的资源名称，初始化为 NULL（sds 类型）。
-m_val：锁的唯一标识（如进程随机名），初始化为 NULL（sds 类型）。
+m_resource：要锁定的资源名称，初始指向内联缓冲区（空字符串）。
+m_val：锁的唯一标识（如进程随机名），初始化为空字符串。
 */
-CLock::CLock() : m_validityTime(0), m_resource(NULL), m_val(NULL) {
-
+CLock::CLock() : m_validityTime(0), m_resource(m_resourceBuf), m_resourceCap(CLOCK_RESOURCE_INLINE) {
+    m_resourceBuf[0] = '\0';
+    m_val[0] = '\0';
 }
 
 /*
-功能：释放 CLock 对象中 sds 类型成员的内存，避免内存泄漏。
+功能：释放 CLock 对象中资源名占用的堆内存（仅当资源名超过内联容量时存在）。
 */
 CLock::~CLock() {
-    sdsfree(m_resource); // 释放资源名称的 sds 内存
-    sdsfree(m_val);      // 释放锁标识的 sds 内存
+    if (m_resource != m_resourceBuf) {
+        free(m_resource);
+    }
+}
+
+/*
+功能：移动构造，资源名在堆上时直接接管指针，否则拷贝内联内容；被移动对象恢复为空锁。
+*/
+CLock::CLock(CLock &&other) : CLock() {
+    *this = std::move(other);
+}
+
+/*
+功能：移动赋值，语义同移动构造；自身已有的堆缓冲区在对方为内联存储时会被保留复用。
+*/
+CLock &CLock::operator=(CLock &&other) {
+    if (this == &other) {
+        return *this;
+    }
+    m_validityTime = other.m_validityTime;
+    memcpy(m_val, other.m_val, sizeof(m_val));
+    if (other.m_resource != other.m_resourceBuf) {
+        // 对方资源名在堆上：释放自己的堆缓冲区，接管对方的指针
+        if (m_resource != m_resourceBuf) {
+            free(m_resource);
+        }
+        m_resource = other.m_resource;
+        m_resourceCap = other.m_resourceCap;
+        other.m_resource = other.m_resourceBuf;
+        other.m_resourceCap = CLOCK_RESOURCE_INLINE;
+    } else {
+        SetResource(other.m_resource);
+    }
+    other.m_validityTime = 0;
+    other.m_resource[0] = '\0';
+    other.m_val[0] = '\0';
+    return *this;
+}
+
+/*
+功能：设置资源名称。长度不超过当前容量时直接覆盖（内联缓冲区或已有的堆缓冲区），否则才重新分配。
+*/
+void CLock::SetResource(const char *resource) {
+    size_t len = strlen(resource);
+    if (len > m_resourceCap) {
+        char *buf = (char *)malloc(len + 1);
+        if (m_resource != m_resourceBuf) {
+            free(m_resource);
+        }
+        m_resource = buf;
+        m_resourceCap = len;
+    }
+    memmove(m_resource, resource, len + 1);
+}
+
+/*
+功能：设置锁 ID（最多 LOCK_ID_LEN 个字符）。
+*/
+void CLock::SetVal(const char *val) {
+    if (val != m_val) {
+        strncpy(m_val, val, LOCK_ID_LEN);
+        m_val[LOCK_ID_LEN] = '\0';
+    }
 }
 
 /*
@@ -61,24 +197,24 @@ CRedLock::CRedLock() {
 }
 
 /*
-功能：释放 CRedLock 对象占用的所有资源，包括脚本、文件描述符和 Redis 连接。
+功能：释放 CRedLock 对象占用的所有资源，包括脚本、命令缓冲区和 Redis 连接。
 关键点：
 sdsfree：释放 Lua 脚本的内存（脚本在初始化时用 sdsnew 创建）。
-close(m_fd)：关闭用于生成随机数的 /dev/urandom 文件。
 redisFree：释放 hiredis 库创建的 Redis 连接上下文，避免资源泄漏。
 */
 CRedLock::~CRedLock() {
     sdsfree(m_continueLockScript); // 释放续锁脚本的 sds 内存
     sdsfree(m_unlockScript);       // 释放解锁脚本的 sds 内存
-    close(m_fd);                   // 关闭随机文件描述符（/dev/urandom）
+    sdsfree(m_acquireScript);      // 释放加锁脚本的 sds 内存
     /* Disconnects and frees the context */
     for (int i = 0; i < (int)m_redisServer.size(); i++) {
         redisFree(m_redisServer[i]); // 释放 Redis 连接上下文
+        sdsfree(m_cmdBuf[i]);        // 释放该连接的命令编码缓冲区
     }
 }
 
 /*
-功能：初始化 Redlock 的核心资源，包括 Lua 脚本、重试策略和随机数文件。
+功能：初始化 Redlock 的核心资源，包括 Lua 脚本和重试策略。
 关键参数 / 逻辑：
 续锁脚本（m_continueLockScript）：
 逻辑：检查锁是否属于当前客户端（get KEYS[1] == ARGV[1]），若是则删除旧锁，再用新参数加锁（set ... nx 确保原子性）。
@@ -86,29 +222,32 @@ CRedLock::~CRedLock() {
 解锁脚本（m_unlockScript）：
 逻辑：仅当锁属于当前客户端时删除锁（避免误删其他客户端的锁），返回删除结果。
 作用：保证解锁的安全性，通过 Lua 脚本原子性验证锁的归属。
-随机数文件（/dev/urandom）：
-用于生成唯一的锁 ID（如 GetUniqueLockId 函数），确保分布式环境下锁的唯一性。
+加锁脚本（m_acquireScript）：
+逻辑：SET NX PX 成功时返回 OK，失败时返回当前持有者的剩余有效时间（PTTL）。
+作用：加锁失败的同一次往返中得知锁何时可能空出，用于安排下一次重试。
+唯一锁 ID 由每线程的 TokenGenerator 生成（种子来自 getrandom），不再需要持有 /dev/urandom 的文件描述符。
 */
 bool CRedLock::Initialize(){
     //初始化续锁脚本（lua脚本，保证原子性操作）
     m_continueLockScript = sdsnew("if redis.call('get', KEYS[1]) == ARGV[1] then redis.call('del', KEYS[1]) end return redis.call('set', KEYS[1], ARGV[2], 'px', ARGV[3], 'nx')");
-    // 初始化解锁脚本（Lua 脚本，保证原子性验证和删除）
-    m_unlockScript       = sdsnew("if redis.call('get', KEYS[1]) == ARGV[1] then return redis.call('del', KEYS[1]) else return 0 end");
+    // 初始化解锁脚本（Lua 脚本，保证原子性验证和删除；与 code/RedLock 共用 include/LockScripts.h）
+    m_unlockScript       = sdsnewlen(unlock_script().data(), unlock_script().size());
+    // 初始化加锁脚本（SET NX PX，失败时返回持有者的 PTTL）
+    m_acquireScript      = sdsnewlen(acquire_script().data(), acquire_script().size());
 
     //设置默认重试策略
     m_retryCount = m_defaultRetryCount;
     //重试延迟
     m_retryDelay = m_defaultRetryDelay;
+    // 默认退避策略（见 DefaultRetryPolicy）
+    m_retryPolicy = DefaultRetryPolicy(m_retryDelay);
+    m_customRetryPolicy = false;
+    // 不限制总等待时间（按次数重试）
+    m_retryTimeout = 0;
+    // 退避随机数生成器
+    m_rng.seed((std::mt19937::result_type)TokenGenerator::local().next_u64());
     // 多数派数量初始化为 0（后续根据服务器数量计算）
     m_quoRum = 0;
-
-    //打开随机数文件，用于生成唯一锁ID
-    m_fd = open("/dev/urandom",O_RDONLY);
-    if (m_fd == -1) {
-        // 错误处理：打开文件失败时输出日志并退出（实际项目中应更优雅处理）
-        printf("Can't open file /dev/urandom\n");
-        return false; // 代码逻辑上无法执行到这里
-    }
     return true; // 初始化成功
 }
 
@@ -119,15 +258,26 @@ ip：Redis 服务器的 IP 地址（字符串）。
 port：Redis 服务器的端口号（整数）。
 */
 bool CRedLock::AddServerUrl(const char *ip,const int port){
+    // 默认选项：连接超时 1.5 秒，TCP_NODELAY，不设置命令超时
+    return AddServerUrl(ip, port, ServerOptions());
+}
+
+/*
+功能：按连接选项添加 Redis 服务器。
+参数：
+options：连接选项（见 include/ServerOptions.h）。unix_path 非空时通过 Unix 域套接字连接，此时忽略 ip 和 port；
+         另可设置连接/命令超时、TCP_NODELAY、keepalive、SO_RCVBUF/SO_SNDBUF。
+*/
+bool CRedLock::AddServerUrl(const char *ip, const int port, const ServerOptions &options){
     redisContext *c = NULL;
-    // 设置连接超时时间：1.5 秒（1 秒 + 500000 微秒）
-    struct timeval timeout = {1,500000};
-    //连接到redis服务器，带超时设置
-    c = redisConnectWithTimeout(ip,port,timeout);
+    //按选项连接到redis服务器
+    c = connect_redis(ip ? ip : "", port, options);
     if(c){
         //连接成功
         //将连接上下文添加到服务器列表
         m_redisServer.push_back(c);
+        // 为该连接分配命令编码缓冲区（预留足够放下续锁脚本命令的空间）
+        m_cmdBuf.push_back(sdsMakeRoomFor(sdsempty(), 512));
     }else{
         return false;
     }
@@ -141,10 +291,55 @@ bool CRedLock::AddServerUrl(const char *ip,const int port){
 参数：
 count：重试次数（如 3 次）。
 delay：每次重试的间隔时间（单位：毫秒，如 200ms）。
+已通过 SetRetryPolicy 设置自定义策略时，delay 只在之后恢复默认策略时生效，不会替换自定义策略。
 */
 void CRedLock::SetRetry(const int count, const int delay) {
     m_retryCount = count; // 设置重试次数
     m_retryDelay = delay; // 设置重试延迟（毫秒）
+    if (!m_customRetryPolicy) {
+        m_retryPolicy = DefaultRetryPolicy(delay);
+    }
+}
+
+/*
+功能：设置重试/退避策略（指数退避、去相关抖动、固定频率等，见 include/RetryPolicy.h）。
+参数：
+policy：退避策略，为空时恢复默认策略。
+*/
+void CRedLock::SetRetryPolicy(std::shared_ptr<const RetryPolicy> policy) {
+    if (policy) {
+        m_retryPolicy = policy;
+    } else {
+        m_retryPolicy = DefaultRetryPolicy(m_retryDelay);
+    }
+    m_customRetryPolicy = policy != NULL;
+}
+
+/*
+功能：设置加锁/续锁的总等待时间。
+参数：
+timeout：毫秒，大于 0 时以截止时间代替重试次数作为上限；0 表示按重试次数。
+*/
+void CRedLock::SetRetryTimeout(const int timeout) {
+    m_retryTimeout = timeout > 0 ? timeout : 0;
+}
+
+/*
+功能：按退避策略计算等待时间并睡眠。
+参数：
+ctx：重试上下文（轮次、上一次等待时间、本轮耗时等）。
+deadline：截止时间（MonotonicMs 毫秒）。
+返回值：等待之后再进行一轮（耗时按刚结束的一轮 ctx.round_ms 估计）会越过截止时间则不睡眠并返回 false，
+与 RedLock::wait_before_retry 相同，不会为了最后一轮而越过截止时间。
+*/
+bool CRedLock::WaitBeforeRetry(RetryContext &ctx, long long deadline) {
+    int delay = retry_delay_ms(*m_retryPolicy, ctx, m_rng, deadline == LLONG_MAX ? INT64_MAX : deadline - MonotonicMs());
+    if (delay < 0) {
+        return false;
+    }
+    usleep(delay * 1000);
+    ctx.prev_delay_ms = delay;
+    return true;
 }
 
 /*
@@ -155,60 +350,73 @@ ttl：锁的过期时间（毫秒）。
 lock：用于存储锁信息的对象。
 */
 bool CRedLock::Lock(const char *resource,const int ttl,CLock &lock){
-    //生成唯一的锁id
-    sds val = GetUniqueLockId();
+    //生成唯一的锁id，直接写入锁对象的内联缓冲区
     // 如果生成失败，返回 false
-    if (!val) {
+    if (!GetUniqueLockId(lock.m_val)) {
         return false;
     }
+    const char *val = lock.m_val;
 
-    // 复制资源名称到锁对象中
-    lock.m_resource = sdsnew(resource);
-    // 将唯一锁 ID 赋值给锁对象
-    lock.m_val = val;
-    // 打印生成的唯一锁 ID
-    printf("Get the unique id is %s\n", val);
+    // 复制资源名称到锁对象中（复用锁对象已有的存储）
+    lock.SetResource(resource);
     // 获取重试次数
     int retryCount = m_retryCount;
+    // 重试截止时间（设置了总等待时间时以截止时间为界，否则按次数）
+    long long beginTime = MonotonicMs();
+    long long deadline = m_retryTimeout > 0 ? beginTime + m_retryTimeout : LLONG_MAX;
+    RetryContext retry;
+    // 飞行记录（各实例为最后一轮的结果）
+    int64_t startUs = FlightRecorder::now_us();
+    FlightRecorder::Entry flight;
     do{
+        long long roundStart = MonotonicMs();
         //记录成功加锁的redis实例的数量
         int n = 0;
         // 记录开始加锁的时间（毫秒）
         int startTime = (int)time(NULL) * 1000;
         //获取redis服务器列表的长度
         int slen = (int)m_redisServer.size();
+        //各实例上持有者租约的剩余时间（复用容量）
+        m_leaseMs.resize(slen);
         //遍历所有redis服务器示例
+        flight.node_results = 0;
         for(int i = 0;i < slen;i++){
-            //尝试在当前redis示例上加锁
-            if(LockInstance(m_redisServer[i],resource,val,ttl)){
+            //尝试在当前redis示例上加锁，失败时带回持有者租约的剩余时间
+            if(LockInstance(i,resource,val,ttl,m_leaseMs[i])){
                 //加锁成功
                 n++;
             }
+            flight.set_node(i, m_leaseMs[i] == 0 ? FlightRecorder::NODE_OK
+                               : (m_leaseMs[i] > 0 ? FlightRecorder::NODE_HELD
+                               : (m_leaseMs[i] == LEASE_NOT_SENT ? FlightRecorder::NODE_UNAVAILABLE : FlightRecorder::NODE_ERROR)));
         }
         // 计算时钟漂移，考虑 Redis 过期精度和小 TTL 时的最小漂移
         int drift = (ttl * m_clockDriftFactor) + 2;
         // 计算锁的有效时间
         int validityTime = ttl - ((int)time(NULL) * 1000 - startTime) - drift;
-        // 打印锁的有效时间、成功加锁的实例数量和多数派数量
-        printf("The resource validty time is %d, n is %d, quo is %d\n",
-               validityTime, n, m_quoRum);
         // 如果成功加锁的实例数量达到多数派且锁的有效时间大于 0
         if (n >= m_quoRum && validityTime > 0) {
             // 设置锁对象的有效时间
             lock.m_validityTime = validityTime;
+            FlightRecord(flight, FlightRecorder::OP_LOCK, lock, slen, m_quoRum, true, retry.attempt + 1, ttl, validityTime, startUs);
             // 加锁成功，返回 true
             return true;
-        } else {
-            // 加锁失败，解锁所有已加锁的实例
-            Unlock(lock);
+        } else if (std::any_of(m_leaseMs.begin(), m_leaseMs.end(), lease_needs_release)) {
+            // 加锁失败，解锁本轮加锁成功及结果未知（超时、I/O 错误）的实例（流水线发送）
+            UnlockInstances(lock, m_leaseMs.data());
         }
-        // 计算重试前的随机延迟时间
-        int delay = rand() % m_retryDelay + floor(m_retryDelay / 2);
-        // 线程休眠指定的延迟时间
-        usleep(delay * 1000);
         // 重试次数减 1
         retryCount--;
-    }while(retryCount > 0);
+        // 多数派实例上的持有者租约何时到期（本轮已加锁并释放的实例为 0，扣除本轮已过去的时间）
+        // 按退避策略等待：次数用完（未设置总等待时间时）或等待再加一轮（按本轮耗时估计）会越过截止时间则放弃
+        long long now = MonotonicMs();
+        retry_after_round(retry, m_leaseMs.data(), m_leaseMs.size(), m_quoRum, now - roundStart, now - beginTime);
+        if ((m_retryTimeout == 0 && retryCount <= 0) || !WaitBeforeRetry(retry, deadline)) {
+            break;
+        }
+    }while(true);
+    flight.holder_pttl_ms = (int32_t)retry.holder_pttl_ms;
+    FlightRecord(flight, FlightRecorder::OP_LOCK, lock, m_redisServer.size(), m_quoRum, false, retry.attempt, ttl, 0, startUs);
     // 重试次数用完仍未成功加锁，返回 false
     return false;
 }
@@ -221,28 +429,32 @@ ttl：续锁后的过期时间（毫秒）。
 lock：用于存储锁信息的对象。
 */
 bool CRedLock::ContinueLock(const char *resource, const int ttl, CLock &lock) {
-    // 生成一个唯一的锁 ID
-    sds val = GetUniqueLockId();
+    // 生成一个唯一的锁 ID，直接写入锁对象
     // 如果生成失败，返回 false
-    if (!val) {
+    if (!GetUniqueLockId(lock.m_val)) {
         return false;
     }
-    // 复制资源名称到锁对象中
-    lock.m_resource = sdsnew(resource);
-    // 将唯一锁 ID 赋值给锁对象
-    lock.m_val = val;
+    const char *val = lock.m_val;
+    // 复制资源名称到锁对象中（复用锁对象已有的存储）
+    lock.SetResource(resource);
     // 如果续锁对象的资源名称为空
-    if (m_continueLock.m_resource == NULL) {
+    if (m_continueLock.m_resource[0] == '\0') {
         // 复制资源名称到续锁对象中
-        m_continueLock.m_resource = sdsnew(resource);
+        m_continueLock.SetResource(resource);
         // 复制唯一锁 ID 到续锁对象中
-        m_continueLock.m_val = sdsnew(val);
+        m_continueLock.SetVal(val);
     }
-    // 打印生成的唯一锁 ID
-    printf("Get the unique id is %s\n", val);
     // 获取重试次数
     int retryCount = m_retryCount;
+    // 重试截止时间（同 Lock）
+    long long beginTime = MonotonicMs();
+    long long deadline = m_retryTimeout > 0 ? beginTime + m_retryTimeout : LLONG_MAX;
+    RetryContext retry;
+    // 飞行记录（同 Lock）
+    int64_t startUs = FlightRecorder::now_us();
+    FlightRecorder::Entry flight;
     do {
+        long long roundStart = MonotonicMs();
         // 记录成功续锁的 Redis 实例数量
         int n = 0;
         // 记录开始续锁的时间（毫秒）
@@ -250,83 +462,102 @@ bool CRedLock::ContinueLock(const char *resource, const int ttl, CLock &lock) {
         // 获取 Redis 服务器列表的长度
         int slen = (int)m_redisServer.size();
         // 遍历所有 Redis 服务器实例
+        flight.node_results = 0;
         for (int i = 0; i < slen; i++) {
             // 尝试在当前 Redis 实例上续锁
-            if (ContinueLockInstance(m_redisServer[i], resource, val, ttl)) {
+            bool ok = ContinueLockInstance(i, resource, val, ttl);
+            if (ok) {
                 // 续锁成功，计数器加 1
                 n++;
             }
+            flight.set_node(i, ok ? FlightRecorder::NODE_OK
+                                  : (m_redisServer[i]->err ? FlightRecorder::NODE_ERROR : FlightRecorder::NODE_REJECTED));
         }
-        // 释放续锁对象的旧唯一锁 ID
-        sdsfree(m_continueLock.m_val);
-        // 更新续锁对象的唯一锁 ID
-        m_continueLock.m_val = sdsnew(val);
+        // 更新续锁对象的唯一锁 ID（原地覆盖旧 ID）
+        m_continueLock.SetVal(val);
         // 计算时钟漂移，考虑 Redis 过期精度和小 TTL 时的最小漂移
         int drift = (ttl * m_clockDriftFactor) + 2;
         // 计算锁的有效时间
         int validityTime = ttl - ((int)time(NULL) * 1000 - startTime) - drift;
-        // 打印锁的有效时间、成功续锁的实例数量和多数派数量
-        printf("The resource validty time is %d, n is %d, quo is %d\n",
-               validityTime, n, m_quoRum);
         // 如果成功续锁的实例数量达到多数派且锁的有效时间大于 0
         if (n >= m_quoRum && validityTime > 0) {
             // 设置锁对象的有效时间
             lock.m_validityTime = validityTime;
+            FlightRecord(flight, FlightRecorder::OP_EXTEND, lock, slen, m_quoRum, true, retry.attempt + 1, ttl, validityTime, startUs);
             // 续锁成功，返回 true
             return true;
         } else {
             // 续锁失败，解锁所有已加锁的实例
             Unlock(lock);
         }
-        // 计算重试前的随机延迟时间
-        int delay = rand() % m_retryDelay + floor(m_retryDelay / 2);
-        // 线程休眠指定的延迟时间
-        usleep(delay * 1000);
         // 重试次数减 1
         retryCount--;
-    } while (retryCount > 0);
+        // 按退避策略等待：次数用完（未设置总等待时间时）或等待再加一轮（按本轮耗时估计）会越过截止时间则放弃
+        retry.attempt++;
+        retry.round_ms = (int)(MonotonicMs() - roundStart);
+        retry.elapsed_ms = MonotonicMs() - beginTime;
+        if ((m_retryTimeout == 0 && retryCount <= 0) || !WaitBeforeRetry(retry, deadline)) {
+            break;
+        }
+    } while (true);
+    FlightRecord(flight, FlightRecorder::OP_EXTEND, lock, m_redisServer.size(), m_quoRum, false, retry.attempt, ttl, 0, startUs);
     // 重试次数用完仍未成功续锁，返回 false
     return false;
 }
 
 /*
-功能：对指定的锁对象进行解锁操作，遍历所有 Redis 实例，在每个实例上执行解锁操作。
+功能：对指定的锁对象进行解锁操作，在所有 Redis 实例上执行解锁操作（解锁命令流水线发送）。
 参数：
 lock：要解锁的锁对象。
 */
 bool CRedLock::Unlock(const CLock &lock){
-    int slen = (int)m_redisServer.size();
-    for(int i =0;i < slen;i++){
-        // 在当前 Redis 实例上解锁
-        UnlockInstance(m_redisServer[i],lock.m_resource,lock.m_val);
-    }
+    int64_t startUs = FlightRecorder::now_us();
+    FlightRecorder::Entry flight;
+    int released = UnlockInstances(lock, NULL, &flight);
+    FlightRecord(flight, FlightRecorder::OP_UNLOCK, lock, m_redisServer.size(), m_quoRum, released >= m_quoRum, 1, 0, 0, startUs);
     return true;
 }
 
 /*
-功能：在单个 Redis 实例上尝试对指定资源加锁，使用 SET 命令并设置过期时间和 NX 选项，只有当返回结果为 "OK" 时，才认为加锁成功。
+功能：在单个 Redis 实例上尝试对指定资源加锁，通过加锁脚本执行 SET NX PX，只有当返回结果为 "OK" 时，才认为加锁成功；
+加锁失败时脚本返回持有者的 PTTL。
 参数：
-c：Redis 上下文对象，用于与 Redis 服务器通信。
+i：Redis 实例下标（对应的连接和命令缓冲区）。
 resource：要加锁的资源名称。
 val：唯一的锁 ID。
 ttl：锁的过期时间（毫秒）。
+leaseMs：输出参数，加锁成功时为 0，失败时为持有者租约的剩余时间，无法得知时为 -1。
 */
-bool CRedLock::LockInstance(redisContext *c,const char *resource,const char *val,const int ttl){
+bool CRedLock::LockInstance(int i,const char *resource,const char *val,const int ttl,int64_t &leaseMs){
     //定义redis响应对象指针
     redisReply *reply;
-    //向redis服务器发送SET命令，尝试加锁
-    reply = (redisReply *)redisCommand(c,"set %s %s px %d nx",resource, val, ttl);
-    //如果有响应
-    if(reply){
-        // 打印 SET 命令的返回结果
-        printf("Set return: %s [null == fail, OK == success]\n", reply->str);
-    }   
-    //如果响应不为空，且返回的结果为ok
-    if(reply && reply->str && strcmp(reply->str,"ok") == 0){
+    if (m_redisServer[i]->err) {
+        // 连接已失效：命令不会发出
+        leaseMs = LEASE_NOT_SENT;
+        return false;
+    }
+    leaseMs = LEASE_UNKNOWN;
+    //编码 EVAL 加锁脚本 1 resource val ttl 命令，并发送给redis服务器，尝试加锁
+    sds buf = respBegin(m_cmdBuf[i], 6);
+    buf = respArgStr(buf, "EVAL");
+    buf = respArg(buf, m_acquireScript, sdslen(m_acquireScript));
+    buf = respArgStr(buf, "1");
+    buf = respArgStr(buf, resource);
+    buf = respArgStr(buf, val);
+    buf = respArgInt(buf, ttl);
+    m_cmdBuf[i] = buf;
+    reply = RedisCommandFormatted(i);
+    //如果响应不为空，且返回的结果为OK
+    if(reply && reply->str && strcmp(reply->str,"OK") == 0){
         //释放redis对象
         freeReplyObject(reply);
+        leaseMs = 0;
         return true;
     }
+    //锁已被占用：记录持有者的 PTTL（-1 表示没有过期时间，视为未知）
+    if(reply && reply->type == REDIS_REPLY_INTEGER && reply->integer >= 0){
+        leaseMs = reply->integer;
+    }
     if(reply){
         // 释放 Redis 响应对象
         freeReplyObject(reply);
@@ -343,33 +574,21 @@ resource：要续锁的资源名称。
 val：新生成的唯一锁 ID（用于标识当前客户端的新锁）。
 ttl：续锁后的过期时间（毫秒）。
 */
-bool CRedLock::ContinueLockInstance(redisContext *c,const char *resource,const char *val,const int ttl){
+bool CRedLock::ContinueLockInstance(int i,const char *resource,const char *val,const int ttl){
     // 参数数量：7 个（EVAL 命令固定格式：脚本、key 数量、key、参数...）
-    int argc = 7;
-    sds sdsTTL = sdsempty();
-    // 将 ttl 格式化为字符串并拼接到 sdsTTL 中（例如 "1000"）
-    sdsTTL = sdscatprintf(sdsTTL,"%d",ttl);
-    //构造lua脚本执行所需要的参数数组
-    char *continueLockScriptArgv[] = {
-        (char *)"EVAL",   //redis命令：执行lua脚本
-        m_continueLockScript,    //续锁脚本的内容，lua代码
-        (char *)"1",      //key数量：1个，资源名
-        (char *)resource,   //第一个key的资源名称
-        m_continueLock.m_val,  //脚本参数1：旧锁唯一ID
-        (char *)val,  //新锁的唯一ID
-        sdsTTL    //新锁的过期时间
-    };
-    
-    // 调用 RedisCommandArgv 执行 Lua 脚本
-    redisReply *reply = RedisCommandArgv(c,argc,continueLockScriptArgv);
-    //释放sdsTTL
-    sdsfree(sdsTTL);
+    sds buf = respBegin(m_cmdBuf[i], 7);
+    buf = respArgStr(buf, "EVAL");                                       //redis命令：执行lua脚本
+    buf = respArg(buf, m_continueLockScript, sdslen(m_continueLockScript)); //续锁脚本的内容，lua代码
+    buf = respArgStr(buf, "1");                                          //key数量：1个，资源名
+    buf = respArgStr(buf, resource);                                     //第一个key的资源名称
+    buf = respArgStr(buf, m_continueLock.m_val);                         //脚本参数1：旧锁唯一ID
+    buf = respArgStr(buf, val);                                          //新锁的唯一ID
+    buf = respArgInt(buf, ttl);                                          //新锁的过期时间（就地格式化）
+    m_cmdBuf[i] = buf;
+
+    // 发送已编码的命令，执行 Lua 脚本
+    redisReply *reply = RedisCommandFormatted(i);
 
-    // 打印 Redis 响应（调试用）
-    if (reply) {
-        printf("Set return: %s [null == fail, OK == success]\n", reply->str);
-    }
-    
     // 判断响应是否为 "OK"（续锁成功）
     if (reply && reply->str && strcmp(reply->str, "OK") == 0) {
         freeReplyObject(reply);  // 释放响应对象内存
@@ -385,80 +604,92 @@ bool CRedLock::ContinueLockInstance(redisContext *c,const char *resource,const c
 
 /*
 功能
-在单个 Redis 实例上执行解锁操作，通过 Lua 脚本原子性地验证锁的归属并删除锁，避免误删其他客户端的锁。
+在多个 Redis 实例上执行解锁操作，通过 Lua 脚本原子性地验证锁的归属并删除锁，避免误删其他客户端的锁。
+先把所有实例的解锁命令追加到各自的输出缓冲并统一写出，再逐个读取响应，总耗时约为一次往返。
 参数
-c：Redis 连接上下文。
-resource：要解锁的资源名称。
-val：锁的唯一 ID（用于验证当前客户端是否为锁的持有者）。
+lock：要解锁的锁对象（资源名称 + 锁的唯一 ID）。
+leaseMs：为 NULL 时在所有实例上解锁；否则只在 lease_needs_release(leaseMs[i])（本轮加锁成功或结果未知）的实例上解锁，
+确定拒绝（返回持有者租约）和命令未发出的实例跳过。
 */
-void CRedLock::UnlockInstance(redisContext *c,const char *resource,const char *val){
-    // 参数数量：5 个（EVAL 命令固定格式：脚本、key 数量、key、参数）
-    int argc = 5;
-    // 构造解锁脚本执行所需的参数数组
-    char *unlockScriptArgv[] = {
-        (char*)"EVAL",         // Redis 命令：执行 Lua 脚本
-        m_unlockScript,        // 解锁脚本内容（Lua 代码）
-        (char*)"1",            // key 数量：1 个（资源名）
-        (char*)resource,       // 第一个 key：资源名称
-        (char*)val             // 脚本参数：锁的唯一 ID（验证是否为锁的持有者）
-    };
-    
-    // 调用 RedisCommandArgv 执行解锁脚本
-    redisReply *reply = RedisCommandArgv(c, argc, unlockScriptArgv);
-    // 释放响应对象内存（无论成功与否）
-    if (reply) {
-        freeReplyObject(reply);
+int CRedLock::UnlockInstances(const CLock &lock, const int64_t *leaseMs, FlightRecorder::Entry *flight){
+    int slen = (int)m_redisServer.size();
+    // 各实例是否有待读取的响应（复用容量）
+    m_pending.assign(slen, 0);
+    for (int i = 0; i < slen; i++) {
+        redisContext *c = m_redisServer[i];
+        if ((leaseMs && !lease_needs_release(leaseMs[i])) || c->err) {
+            if (flight && !leaseMs) {
+                flight->set_node(i, FlightRecorder::NODE_UNAVAILABLE);
+            }
+            continue;
+        }
+        // 参数数量：5 个（EVAL 命令固定格式：脚本、key 数量、key、参数）
+        sds buf = respBegin(m_cmdBuf[i], 5);
+        buf = respArgStr(buf, "EVAL");                         // Redis 命令：执行 Lua 脚本
+        buf = respArg(buf, m_unlockScript, sdslen(m_unlockScript)); // 解锁脚本内容（Lua 代码）
+        buf = respArgStr(buf, "1");                            // key 数量：1 个（资源名）
+        buf = respArgStr(buf, lock.m_resource);                // 第一个 key：资源名称
+        buf = respArgStr(buf, lock.m_val);                     // 脚本参数：锁的唯一 ID（验证是否为锁的持有者）
+        m_cmdBuf[i] = buf;
+        // 只追加到输出缓冲，暂不等待响应
+        m_pending[i] = redisAppendFormattedCommand(c, m_cmdBuf[i], sdslen(m_cmdBuf[i])) == REDIS_OK;
+    }
+    // 写出所有实例的输出缓冲（各实例并行执行脚本）
+    for (int i = 0; i < slen; i++) {
+        int done = 0;
+        while (m_pending[i] && !done) {
+            if (redisBufferWrite(m_redisServer[i], &done) != REDIS_OK) {
+                m_pending[i] = 0;
+            }
+        }
     }
+    // 逐个读取并释放响应对象（无论成功与否），返回值为 1 表示成功删除锁
+    int released = 0;
+    for (int i = 0; i < slen; i++) {
+        void *reply = NULL;
+        if (!m_pending[i]) {
+            continue;
+        }
+        bool ok = false;
+        if (redisGetReply(m_redisServer[i], &reply) == REDIS_OK && reply) {
+            ok = ((redisReply *)reply)->type == REDIS_REPLY_INTEGER && ((redisReply *)reply)->integer == 1;
+            freeReplyObject(reply);
+            if (flight) {
+                flight->set_node(i, ok ? FlightRecorder::NODE_OK : FlightRecorder::NODE_REJECTED);
+            }
+        } else if (flight) {
+            flight->set_node(i, FlightRecorder::NODE_ERROR);
+        }
+        released += ok;
+    }
+    return released;
 }
 
 /*
-封装 hiredis 的 redisCommandArgv 接口，支持二进制安全的参数传递，用于执行带多个参数的 Redis 命令（如 EVAL 脚本）。
+把第 i 个连接命令缓冲区中已编码好的 RESP 命令交给 hiredis（redisAppendFormattedCommand），并同步读取响应。
+与 redisCommandArgv 相比，省去了参数的 sds 拷贝、参数长度数组以及 hiredis 的二次格式化。
 参数
-c：Redis 连接上下文。
-argc：参数数量。
-inargv：参数数组（char* 类型，需转换为 sds 以支持二进制安全）。
+i：Redis 实例下标。
 */
-redisReply *CRedLock::RedisCommandArgv(redisContext *c,int argc,char **inargv){
-    // 将输入的 char** 转换为 sds 数组（Redis 要求参数为二进制安全的字符串）
-    char **argv = convertToSds(argc,inargv);
-    //分配参数长度数组（存储每个参数的字节长度）
-    size_t *argvlen = (size_t *)malloc(argc * sizeof(size_t));
-    // 填充参数长度（sdslen 获取 sds 字符串的实际长度，支持二进制数据）
-    for(int j = 0;j < argc;j++){
-        argvlen[j] = sdslen(argv[j]);
+redisReply *CRedLock::RedisCommandFormatted(int i){
+    redisContext *c = m_redisServer[i];
+    if (redisAppendFormattedCommand(c, m_cmdBuf[i], sdslen(m_cmdBuf[i])) != REDIS_OK) {
+        return NULL;
     }
-
-    //调用hiredis的redisCommandArgv执行命令（带参数长度，支持二进制安全）
-    redisReply *reply = (redisReply *)redisCommandArgv(c,argc,(const char **)argv,argvlen);
-    // 打印响应（调试用，仅针对整数类型响应，实际需根据命令类型处理）
-    if (reply) {
-        printf("RedisCommandArgv return: %lld\n", reply->integer);
+    void *reply = NULL;
+    if (redisGetReply(c, &reply) != REDIS_OK) {
+        return NULL;
     }
-    
-    // 释放内存：先释放参数长度数组，再释放 sds 数组
-    free(argvlen);
-    sdsfreesplitres(argv, argc);  // sdsfreesplitres 释放 sds 数组及每个 sds 字符串
-    
-    return reply;  // 返回 Redis 响应
+    return (redisReply *)reply;  // 返回 Redis 响应
 }
 
 /*
 功能
 生成一个全局唯一的锁 ID，用于标识加锁的客户端，确保不同客户端的锁相互隔离。
+160 位随机数来自当前线程的 ChaCha20 生成器（批量生成，无系统调用），再向量化编码为 40 位十六进制字符串。
 */
-sds CRedLock::GetUniqueLockId(){
-    unsigned char buffer[20];   // 20 字节的随机数据缓冲区（160 位，足够唯一）
-    //从/dev/urandom读取20字节随机数据
-    if(read(m_fd,buffer,sizeof(buffer)) == sizeof(buffer)){
-        sds s = sdsempty();
-        // 将每个字节转换为 16 进制字符串（如 0x12 转为 "12"），拼接成 40 位的唯一 ID
-        for (int i = 0; i < 20; i++) {
-            s = sdscatprintf(s, "%02X", buffer[i]);
-        }
-        return s;  // 返回生成的唯一锁 ID（如 "5A3D2B7F1E4C89012D3E4F5A6B7C8D9E"）
-    }else {
-        // 读取失败时打印错误信息（实际项目中需处理错误，如重试或抛出异常）
-        printf("Error: GetUniqueLockId %d\n", __LINE__);
-    }
-    return NULL;
-}
\ No newline at end of file
+bool CRedLock::GetUniqueLockId(char *out){
+    TokenGenerator::local().next_hex(out);
+    out[LOCK_ID_LEN] = '\0';
+    return true;  // 生成的唯一锁 ID 形如 "5a3d2b7f1e4c89012d3e4f5a6b7c8d9e..."
+}
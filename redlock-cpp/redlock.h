@@ -2,6 +2,8 @@
 #define __redlock__
 
 #include<iostream>
+#include<memory>
+#include<random>
 #include<vector>
 #include<hiredis/hiredis.h>
 
@@ -9,21 +11,44 @@
 extern "C"{
 #include "sds.h" 
 }
+#include "FlightRecorder.h"
+#include "RetryPolicy.h"
+#include "ServerOptions.h"
 
 using namespace std;
 
+// 锁 ID 的长度：20 字节随机数的十六进制表示
+#define LOCK_ID_LEN             40
+// 资源名的内联存储长度，超过该长度时才使用堆内存
+#define CLOCK_RESOURCE_INLINE   64
+
 //定义一个CLock类，用于表示一个锁对象
+//锁 ID 和较短的资源名都存放在对象内部的定长缓冲区中，反复加锁不会产生堆分配；对象可移动，不可拷贝
 class CLock{
 public:
     CLock();
     ~CLock();
+    CLock(CLock &&other);
+    CLock &operator=(CLock &&other);
+    CLock(const CLock &) = delete;
+    CLock &operator=(const CLock &) = delete;
+public:
+    //设置资源名称（长度不超过内联容量时不分配内存，已有的堆缓冲区会被复用）
+    void SetResource(const char *resource);
+    //设置锁 ID
+    void SetVal(const char *val);
 public:
     //当前锁可以存活的时间，单位为ms
     int m_validityTime;
-    //要锁住的资源名称，使用sds类型（简单动态字符串)
-    sds m_resource;
-    //锁住资源的进程的随机名字，使用sds类型
-    sds m_val;
+    //要锁住的资源名称，指向 m_resourceBuf 或者堆内存，始终以 '\0' 结尾
+    char *m_resource;
+    //锁住资源的进程的随机名字（定长内联存储）
+    char m_val[LOCK_ID_LEN + 1];
+private:
+    //资源名当前可用的容量（不含结尾的 '\0'）
+    size_t m_resourceCap;
+    //资源名的内联存储
+    char m_resourceBuf[CLOCK_RESOURCE_INLINE + 1];
 };
 
 //定义一个CRedLock类，用于实现RedLock算法
@@ -38,8 +63,14 @@ public:
     bool Initialize();
     // 向 CRedLock 类中添加 Redis 服务器的 IP 地址和端口号，返回添加是否成功
     bool AddServerUrl(const char *ip,const int port);
-    //设置重试次数和重试延迟时延
+    // 按连接选项添加 Redis 服务器（Unix 域套接字、连接/命令超时、TCP_NODELAY、keepalive、收发缓冲区）
+    bool AddServerUrl(const char *ip, const int port, const ServerOptions &options);
+    //设置重试次数和重试延迟时延（已设置自定义退避策略时延迟不替换该策略）
     void SetRetry(const int count,const int delay);
+    //设置重试/退避策略（为空时恢复 SetRetry 对应的均匀抖动）
+    void SetRetryPolicy(std::shared_ptr<const RetryPolicy> policy);
+    //设置加锁/续锁的总等待时间（毫秒），大于 0 时以截止时间代替重试次数作为上限
+    void SetRetryTimeout(const int timeout);
     //尝试对指定资源加锁,ttl 为锁的过期时间，lock 为锁对象，返回加锁是否成功
     bool Lock(const char *resource,const int ttl,CLock &lock);
     // 尝试对指定资源进行续锁，ttl 为续锁后的过期时间，lock 为锁对象，返回续锁是否成功
@@ -47,19 +78,22 @@ public:
     // 对指定的锁对象进行解锁操作，返回解锁是否成功
     bool Unlock(const CLock &lock);
 private:
-    // 对单个 Redis 实例进行加锁操作，c 为 Redis 上下文，resource 为资源名称，val 为锁的值，ttl 为锁的过期时间，返回加锁是否成功
-    bool LockInstance(redisContext *c, const char *resource,
-        const char *val, const int ttl);
-     // 对单个 Redis 实例进行续锁操作，c 为 Redis 上下文，resource 为资源名称，val 为锁的值，ttl 为续锁后的过期时间，返回续锁是否成功
-    bool ContinueLockInstance(redisContext *c, const char *resource,
+    // 对单个 Redis 实例进行加锁操作，i 为 Redis 实例下标，resource 为资源名称，val 为锁的值，ttl 为锁的过期时间，返回加锁是否成功
+    // 失败时 leaseMs 为该实例上持有者租约的剩余时间（毫秒，-1 表示未知）
+    bool LockInstance(int i, const char *resource,
+        const char *val, const int ttl, int64_t &leaseMs);
+     // 对单个 Redis 实例进行续锁操作，i 为 Redis 实例下标，resource 为资源名称，val 为锁的值，ttl 为续锁后的过期时间，返回续锁是否成功
+    bool ContinueLockInstance(int i, const char *resource,
                                                  const char *val, const int ttl);
-    // 对单个 Redis 实例进行解锁操作，c 为 Redis 上下文，resource 为资源名称，val 为锁的值
-    void UnlockInstance(redisContext *c, const char *resource,
-        const char *val);
-    // 生成一个唯一的锁 ID，返回该 ID 的 sds 类型字符串
-    sds GetUniqueLockId();
-    // 向 Redis 服务器发送带有多个参数的命令，c 为 Redis 上下文，argc 为参数数量，inargv 为参数数组，返回 Redis 服务器的响应
-    redisReply *RedisCommandArgv(redisContext *c, int argc, char **inargv);                                        
+    // 在多个 Redis 实例上流水线解锁，leaseMs 为 NULL 时解锁所有实例，否则只解锁本轮加锁成功或结果未知的实例；
+    // 返回确认删除的实例数，flight 非空时填写各实例的结果
+    int UnlockInstances(const CLock &lock, const int64_t *leaseMs, FlightRecorder::Entry *flight = NULL);
+    // 按退避策略等待，等待会越过截止时间 deadline（单调时钟毫秒）时返回 false
+    bool WaitBeforeRetry(RetryContext &ctx, long long deadline);
+    // 生成一个唯一的锁 ID，写入 out（至少 LOCK_ID_LEN + 1 字节），返回是否成功
+    bool GetUniqueLockId(char *out);
+    // 发送第 i 个 Redis 实例命令缓冲区中已编码好的 RESP 命令，返回 Redis 服务器的响应
+    redisReply *RedisCommandFormatted(int i);
 private:
     // 静态成员变量，默认的重试次数，初始值为 3
     static int              m_defaultRetryCount;    
@@ -70,16 +104,30 @@ private:
 private:
     // 解锁脚本的 sds 类型字符串
     sds                     m_unlockScript;         
+    // 加锁脚本的 sds 类型字符串（失败时返回持有者的 PTTL）
+    sds                     m_acquireScript;        
     // 实际的重试次数
     int                     m_retryCount;           
     // 实际的重试延迟时间
     int                     m_retryDelay;           
+    // 总等待时间（毫秒，0 表示按重试次数）
+    int                     m_retryTimeout;         
+    // 退避策略
+    std::shared_ptr<const RetryPolicy> m_retryPolicy;
+    // m_retryPolicy 是否由 SetRetryPolicy 设置（此时 SetRetry 不替换它）
+    bool                    m_customRetryPolicy;
+    // 退避用的随机数生成器
+    std::mt19937            m_rng;                  
     // 多数派数量，用于判断加锁是否成功
     int                     m_quoRum;               
-    // 随机文件的文件描述符
-    int                     m_fd;                   
     // 存储多个 Redis 服务器上下文的向量
     vector<redisContext *>  m_redisServer;          
+    // 每个 Redis 连接专用的命令编码缓冲区（与 m_redisServer 下标一一对应，容量复用）
+    vector<sds>             m_cmdBuf;               
+    // 加锁失败时各实例上持有者租约的剩余时间（与 m_redisServer 下标一一对应，容量复用）
+    vector<int64_t>         m_leaseMs;              
+    // 流水线解锁时各实例是否有待读取的响应（与 m_redisServer 下标一一对应，容量复用）
+    vector<char>            m_pending;              
     // 续锁对象
     CLock                   m_continueLock;         
     // 续锁脚本的 sds 类型字符串